@@ -77,6 +77,35 @@ void mapper_signal_update_double(mapper_signal sig, double value);
  *                      signal, or 0 if the signal has no value. */
 const void *mapper_signal_value(mapper_signal sig, mapper_timetag_t *tt);
 
+/*! Set how a signal's value is interpolated between received samples, for
+ *  example to generate smooth control at a higher rate than the source
+ *  updates.  While enabled, the most recent samples of each instance are kept
+ *  along with their timetags, converted to local time using the clock offset
+ *  estimated for the link with the sending device.
+ *  \param sig          The signal to operate on.
+ *  \param type         The interpolation to perform, or MAPPER_INTERP_NONE to
+ *                      stop keeping sample history. */
+void mapper_signal_set_interpolation(mapper_signal sig,
+                                     mapper_interpolation_type type);
+
+/*! Get the interpolation used for a signal's value.
+ *  \param sig          The signal to operate on.
+ *  \return             The interpolation type of the provided signal. */
+mapper_interpolation_type mapper_signal_interpolation(mapper_signal sig);
+
+/*! Get a signal's value interpolated at a given time.  Times before or after
+ *  the stored samples return the oldest or newest sample respectively, so to
+ *  follow a slower source smoothly request a time at least one source update
+ *  period in the past.
+ *  \param sig          The signal to operate on.
+ *  \param tt           The local time at which to interpolate, or MAPPER_NOW.
+ *  \param value        An array of the signal's type and length to receive
+ *                      the interpolated value.
+ *  \return             Non-zero if a value was written, or zero if the signal
+ *                      has no value. */
+int mapper_signal_interpolate(mapper_signal sig, mapper_timetag_t tt,
+                              void *value);
+
 /*! Query the values of any signals connected via mapping connections.
  *  \param sig          A local output signal. We will be querying the remote
  *                      ends of this signal's mapping connections.
@@ -119,7 +148,11 @@ void mapper_signal_set_group(mapper_signal sig, mapper_signal_group group);
  *  \return             A pointer associated with this signal. */
 void *mapper_signal_user_data(mapper_signal sig);
 
-/*! A signal handler function can be called whenever a signal value changes. */
+/*! A signal handler function can be called whenever a signal value changes.
+ *  The value pointer is only valid for the duration of the call: it may point
+ *  directly into the received message, so copy the value if it is needed
+ *  later.  It holds count consecutive samples of the signal's length and type,
+ *  or is NULL if the instance has been released. */
 typedef void mapper_signal_update_handler(mapper_signal sig, mapper_id instance,
                                           const void *value, int count,
                                           mapper_timetag_t *tt);
@@ -131,6 +164,52 @@ typedef void mapper_signal_update_handler(mapper_signal sig, mapper_id instance,
 void mapper_signal_set_callback(mapper_signal sig,
                                 mapper_signal_update_handler *handler);
 
+/*! Hold incoming updates for an input signal in a jitter buffer and deliver
+ *  them at their source timetag plus a fixed latency, rather than as soon as
+ *  they arrive.  Source timetags are converted to local time using the clock
+ *  offset estimated for the link with the sending device.  Updates arriving
+ *  after their release time are delivered immediately and counted as late;
+ *  updates arriving while the buffer is full are dropped.  Held updates are
+ *  delivered from mapper_device_poll().
+ *  \param sig          The signal to operate on.
+ *  \param latency      The delay in seconds added to each update's timetag,
+ *                      or 0 to disable the buffer and deliver any held
+ *                      updates immediately.
+ *  \param size         The maximum number of updates held at once.
+ *  \return             Zero if successful, non-zero otherwise. */
+int mapper_signal_set_jitter_buffer(mapper_signal sig, double latency,
+                                    int size);
+
+/*! Retrieve statistics for a signal's jitter buffer.
+ *  \param sig          The signal to operate on.
+ *  \param late         Location to store the number of updates received after
+ *                      their release time, or NULL.
+ *  \param dropped      Location to store the number of updates dropped because
+ *                      the buffer was full, or NULL.
+ *  \return             The number of updates currently held. */
+int mapper_signal_jitter_buffer_stats(mapper_signal sig, unsigned int *late,
+                                      unsigned int *dropped);
+
+/*! Choose whether incoming messages that are older than the last update
+ *  applied to the same signal instance should be discarded, for example when
+ *  packets are reordered on a wireless network.  Messages are compared by
+ *  timetag; for convergent maps each source is compared with its own previous
+ *  message.  Messages sent without a timetag are always applied.
+ *  \param sig          The signal to operate on.
+ *  \param discard      Non-zero to discard out-of-order messages, zero to
+ *                      apply them (the default). */
+void mapper_signal_set_discard_out_of_order(mapper_signal sig, int discard);
+
+/*! Check whether out-of-order messages are discarded for a signal.
+ *  \param sig          The signal to operate on.
+ *  \return             Non-zero if out-of-order messages are discarded. */
+int mapper_signal_discard_out_of_order(mapper_signal sig);
+
+/*! Get the number of out-of-order messages discarded for a signal.
+ *  \param sig          The signal to operate on.
+ *  \return             The number of messages discarded. */
+unsigned int mapper_signal_num_discarded(mapper_signal sig);
+
 /**** Signal Instances ****/
 
 /*! Add new instances to the reserve list. Note that if instance ids are
@@ -164,6 +243,24 @@ void mapper_signal_instance_update(mapper_signal sig, mapper_id instance,
                                    const void *value, int count,
                                    mapper_timetag_t tt);
 
+/*! Update the values of several instances of a signal at once.  All updates
+ *  share one timetag, and the resulting messages are bundled so that each
+ *  link receives a single bundle, unless a queue for this timetag has already
+ *  been started with mapper_device_start_queue(), in which case the updates
+ *  are added to it.
+ *  \param sig          The signal to operate on.
+ *  \param num          The number of instances to update.
+ *  \param instances    Array of num instance identifiers.
+ *  \param values       Array of num consecutive values, each as long as the
+ *                      signal's length property and of the signal's type, or
+ *                      NULL to release all of the listed instances.
+ *  \param tt           The time at which the value updates were aquired. If
+ *                      MAPPER_NOW, libmapper will tag the updates with the
+ *                      current time. */
+void mapper_signal_update_instances(mapper_signal sig, int num,
+                                    const mapper_id *instances,
+                                    const void *values, mapper_timetag_t tt);
+
 /*! Release a specific instance of a signal by removing it from the list of
  *  active instances and adding it to the reserve list.
  *  \param sig          The signal to operate on.
@@ -211,6 +308,18 @@ mapper_id mapper_signal_newest_active_instance(mapper_signal sig);
 const void *mapper_signal_instance_value(mapper_signal sig, mapper_id instance,
                                          mapper_timetag_t *tt);
 
+/*! Get a signal instance's value interpolated at a given time.  See
+ *  mapper_signal_interpolate() for details.
+ *  \param sig          The signal to operate on.
+ *  \param instance     The identifier of the instance to operate on.
+ *  \param tt           The local time at which to interpolate, or MAPPER_NOW.
+ *  \param value        An array of the signal's type and length to receive
+ *                      the interpolated value.
+ *  \return             Non-zero if a value was written, or zero if the signal
+ *                      instance has no value. */
+int mapper_signal_instance_interpolate(mapper_signal sig, mapper_id instance,
+                                       mapper_timetag_t tt, void *value);
+
 /*! Return the number of active instances owned by a signal.
  *  \param  sig         The signal to query.
  *  \return             The number of active instances. */
@@ -824,6 +933,98 @@ int mapper_device_remove_property(mapper_device dev, const char *name);
  *                      nothing to do. */
 int mapper_device_poll(mapper_device dev, int block_ms);
 
+/*! Set how long mapper_device_poll() may spend handling messages that are
+ *  still waiting once it has finished blocking.  Within this time, the number
+ *  of messages handled adapts to the recent number of messages per poll, and
+ *  grows while messages are left waiting.  The default is 1000 microseconds.
+ *  \param dev          The device to operate on.
+ *  \param usec         The time budget in microseconds, or 0 for no limit.
+ *  \return             Zero on success, or -1 if the device is not local or
+ *                      the budget is negative. */
+int mapper_device_set_poll_budget(mapper_device dev, int usec);
+
+/*! Get the time budget for handling waiting messages in mapper_device_poll().
+ *  \param dev          The device to query.
+ *  \return             The time budget in microseconds, or 0 for no limit. */
+int mapper_device_poll_budget(mapper_device dev);
+
+/*! Get statistics about recent calls to mapper_device_poll().  The averages
+ *  are weighted towards the most recent polls.  Any of the pointers may be
+ *  NULL.
+ *  \param dev          The device to query.
+ *  \param msgs_per_poll Set to the average number of messages handled.
+ *  \param usec_per_poll Set to the average time in microseconds spent handling
+ *                      waiting messages at the end of a poll.
+ *  \param backlog      Set to the estimated number of messages left waiting
+ *                      after the last poll, or zero if it handled all of them.
+ *  \return             Zero on success, or -1 if the device is not local. */
+int mapper_device_poll_stats(mapper_device dev, double *msgs_per_poll,
+                             double *usec_per_poll, int *backlog);
+
+/*! Enable or disable the update queue for a device.  While the queue is
+ *  enabled, calls to mapper_signal_update() and related functions on the
+ *  device's signals do not process or send anything themselves: the update is
+ *  copied into a preallocated lock-free ring and handled by the next call to
+ *  mapper_device_poll().  Queuing an update does not allocate memory, take
+ *  locks or make system calls, so signals may be updated from one or more
+ *  real-time threads while another thread polls the device.  Updates
+ *  timestamped with MAPPER_NOW are timestamped when they are dequeued.  This
+ *  function itself must not be called while other threads are updating
+ *  signals of this device; any updates still queued are processed first.
+ *  \param dev          The device to operate on.
+ *  \param size         The number of updates the queue can hold; rounded up to
+ *                      a power of two.  Use 0 to disable the queue.
+ *  \param policy       What to do when the queue is full; see
+ *                      mapper_overflow_policy.
+ *  \return             Zero on success, or -1 if the queue could not be
+ *                      allocated. */
+int mapper_device_set_update_queue(mapper_device dev, int size,
+                                   mapper_overflow_policy policy);
+
+/*! Return the number of updates discarded because the update queue of a
+ *  device was full, or carried more samples than a queue entry can hold.
+ *  \param dev          The device to query.
+ *  \return             The number of discarded updates since the queue was
+ *                      enabled. */
+unsigned int mapper_device_update_queue_overflows(mapper_device dev);
+
+/*! Start a background thread that services this device, so that incoming
+ *  messages are handled as soon as they arrive instead of waiting for the
+ *  next call to mapper_device_poll().  While the thread runs,
+ *  mapper_device_poll() only sleeps for the requested time and signal
+ *  handlers and callbacks are called on the I/O thread.
+ *
+ *  Locking model: the I/O thread holds a recursive lock, shared by all
+ *  devices and databases on the same mapper_network, whenever it touches
+ *  libmapper state.  Any other thread must hold the same lock, using
+ *  mapper_device_lock() and mapper_device_unlock(), around every call that
+ *  reads or modifies devices, signals, links, maps, their properties or the
+ *  network database.  Handlers and callbacks already hold the lock.  Signal
+ *  updates are the exception when the device has an update queue (see
+ *  mapper_device_set_update_queue()): they may be made from any thread
+ *  without the lock and are sent by the I/O thread within a millisecond.
+ *  \param dev          The device to service.
+ *  \return             Zero on success, or -1 if the thread could not be
+ *                      started or threads are not supported. */
+int mapper_device_start_thread(mapper_device dev);
+
+/*! Stop the background thread started by mapper_device_start_thread() and
+ *  return to servicing the device with mapper_device_poll().  This function
+ *  waits for the thread to exit, so it must not be called while holding the
+ *  device lock or from a handler.  It is called by mapper_device_free().
+ *  \param dev          The device to operate on. */
+void mapper_device_stop_thread(mapper_device dev);
+
+/*! Acquire the lock protecting a device, its network and database from the
+ *  background I/O thread; see mapper_device_start_thread().  The lock is
+ *  recursive.
+ *  \param dev          The device to lock. */
+void mapper_device_lock(mapper_device dev);
+
+/*! Release the lock acquired by mapper_device_lock().
+ *  \param dev          The device to unlock. */
+void mapper_device_unlock(mapper_device dev);
+
 /*! Return the number of file descriptors needed for this device.  This can be
  *  used to allocated an appropriately-sized list for called to
  *  mapper_device_fds.  Note that the number of descriptors needed can change
@@ -849,6 +1050,28 @@ int mapper_device_fds(mapper_device dev, int *fds, int num);
  *  \param fd       	The file descriptor that needs servicing. */
 void mapper_device_service_fd(mapper_device dev, int fd);
 
+/*! Get a single file descriptor that becomes readable whenever any of the
+ *  device's servers or incoming TCP connections has messages waiting, or
+ *  another thread has queued an update, for integration with an external
+ *  event loop.  When it is readable, or when the timeout returned by
+ *  mapper_device_next_timeout() expires, call mapper_device_poll() with a
+ *  block time of zero.  The descriptor is owned by the device and closed by
+ *  mapper_device_free().  Currently only available on Linux, using epoll.
+ *  \param dev          The device to get an event descriptor for.
+ *  \return             The event descriptor, or -1 if unavailable. */
+int mapper_device_event_fd(mapper_device dev);
+
+/*! Get the time until the device next needs to be polled for housekeeping
+ *  such as clock synchronisation, link expiry, name allocation, outgoing
+ *  administrative messages and the release of held updates.  This can be used
+ *  as the timeout when waiting on the descriptor from mapper_device_event_fd()
+ *  or mapper_device_fds(), so that an application sleeps exactly until the
+ *  next event.
+ *  \param dev          The device to check.
+ *  \return             The timeout in milliseconds, or zero if the device
+ *                      should be polled immediately. */
+int mapper_device_next_timeout(mapper_device dev);
+
 /*! Detect whether a device is completely initialized.
  *  \param dev          The device to query.
  *  \return             Non-zero if device is completely initialized, i.e., has
@@ -904,6 +1127,38 @@ unsigned int mapper_device_port(mapper_device dev);
  *  \return             A positive ordinal unique to this device (per name). */
 unsigned int mapper_device_ordinal(mapper_device dev);
 
+/*! Enable or disable fast allocation of this device's ordinal.  By default a
+ *  new device waits two seconds after probing its name on the bus, or five if
+ *  the bus is silent, before registering.  With fast allocation the device
+ *  skips ordinals that peers it already knows have registered, waits only
+ *  a fraction of a second on a quiet bus, and settles collisions with other
+ *  devices starting at the same time by ranking their random allocation ids
+ *  instead of backing off at random.  Since the probe window is short, this
+ *  mode suits a local network with low latency.  It must be enabled before
+ *  the device is registered, i.e. soon after mapper_device_new().
+ *  \param dev          The device to operate on.
+ *  \param enable       Non-zero to enable fast allocation, zero to disable it.
+ *  \return             Zero on success, or -1 if the device is not local or
+ *                      is already registered. */
+int mapper_device_set_fast_allocation(mapper_device dev, int enable);
+
+/*! Indicate whether a device allocates its ordinal in fast mode.
+ *  \param dev          The device to query.
+ *  \return             Non-zero if fast allocation is enabled. */
+int mapper_device_fast_allocation(mapper_device dev);
+
+/*! Request a specific ordinal for a device that is not yet registered.  The
+ *  ordinal is probed straight away with fast allocation enabled (see
+ *  mapper_device_set_fast_allocation()); if a peer already holds it or is
+ *  probing it with a lower allocation id, the device falls back to the next
+ *  free ordinal.  Use mapper_device_ordinal() once the device is ready to
+ *  find out which one was allocated.
+ *  \param dev          The device to operate on.
+ *  \param ordinal      The requested ordinal, which must be positive.
+ *  \return             Zero on success, or -1 if the device is not local, is
+ *                      already registered, or the ordinal is zero. */
+int mapper_device_set_ordinal(mapper_device dev, unsigned int ordinal);
+
 /*! Start a time-tagged mapper queue.
  *  \param dev          The device to use.
  *  \param tt           A timetag to use for the updates bundled by this queue. */
@@ -1780,6 +2035,57 @@ mapper_network mapper_database_network(mapper_database db);
  *  \param quiet        1 to disable callbacks during flush, 0 otherwise. */
 void mapper_database_flush(mapper_database db, int timeout, int quiet);
 
+/*! Set whether record callbacks should be called in batches.  While batched,
+ *  changes to device, signal, link and map records are collected and
+ *  coalesced per record, and delivered together by mapper_database_poll(),
+ *  mapper_database_flush() or mapper_database_deliver_notifications().  A
+ *  record added and modified before delivery is reported once as
+ *  MAPPER_ADDED, a record added and removed is not reported at all, and
+ *  removed records remain readable until their removal has been delivered.
+ *  Disabling batching delivers any pending changes.
+ *  \param db           The database to use.
+ *  \param batch        1 to batch record callbacks, 0 to call them as soon as
+ *                      records change. */
+void mapper_database_set_batch_notifications(mapper_database db, int batch);
+
+/*! Get whether record callbacks are called in batches.
+ *  \param db           The database to use.
+ *  \return             1 if record callbacks are batched, 0 otherwise. */
+int mapper_database_batch_notifications(mapper_database db);
+
+/*! Deliver the record changes collected since the last batch.
+ *  \param db           The database to use.
+ *  \return             The number of coalesced record changes delivered. */
+int mapper_database_deliver_notifications(mapper_database db);
+
+/*! Get the sequence number of the last record change in a database.  The
+ *  sequence number grows by one for every device, signal, link or map record
+ *  that is added, modified, removed or expires.
+ *  \param db           The database to use.
+ *  \return             The current sequence number, or 0 if nothing has
+ *                      changed yet. */
+uint32_t mapper_database_sequence(mapper_database db);
+
+/*! Read the record changes made after a given sequence number from the
+ *  database journal, oldest first.  The journal only holds the most recent
+ *  changes, so a caller that has fallen too far behind must query the
+ *  database again, and can then continue from mapper_database_sequence().
+ *  \param db           The database to use.
+ *  \param sequence     The sequence number of the last change already seen.
+ *  \param changes      An array to receive the changes.
+ *  \param max_changes  The size of the changes array.
+ *  \return             The number of changes read, or -1 if some of the
+ *                      changes after sequence are no longer available. */
+int mapper_database_changes_since(mapper_database db, uint32_t sequence,
+                                  mapper_database_change_t *changes,
+                                  int max_changes);
+
+/*! Get the bit used for a property in the properties field of journaled
+ *  record changes.  Properties not known to libmapper share one bit.
+ *  \param property     The name of the property.
+ *  \return             The property bit, or 0 if property is NULL. */
+uint64_t mapper_database_property_mask(const char *property);
+
 /*! Send a request to the network for all active devices to report in.
  *  \param db           The database to use. */
 void mapper_database_request_devices(mapper_database db);
@@ -2081,6 +2387,122 @@ mapper_map *mapper_database_maps_by_slot_property(mapper_database db,
                                                   char type, const void *value,
                                                   mapper_op op);
 
+/*! Set whether a database publishes read-only snapshots of its records for
+ *  use by other threads.  Snapshots are published by the thread that updates
+ *  the database, after each call to mapper_database_poll() or
+ *  mapper_database_flush() that changed its records.  Snapshots that are
+ *  still in use remain valid after snapshots are disabled or the database
+ *  is freed, but no thread may call mapper_database_snapshot() by then.
+ *  Disabling snapshots waits for any thread still inside
+ *  mapper_database_snapshot() to take its reference.
+ *  \param db           The database to use.
+ *  \param enable       1 to publish snapshots, 0 to stop. */
+void mapper_database_set_snapshots(mapper_database db, int enable);
+
+/*! Publish a new snapshot if the records of a database have changed since
+ *  the last one.  Only needed by programs that update the database without
+ *  calling mapper_database_poll() or mapper_database_flush(), and must be
+ *  called from the thread updating the database.  Only records that have
+ *  changed are copied again.
+ *  \param db           The database to use. */
+void mapper_database_publish_snapshot(mapper_database db);
+
+/*! Get the most recently published snapshot of a database.  This may be
+ *  called from any thread, and never waits for the thread updating the
+ *  database.  The snapshot does not change, and must be released with
+ *  mapper_snapshot_release() once it is no longer needed.
+ *  \param db           The database to use.
+ *  \return             The snapshot, or zero if none has been published. */
+mapper_snapshot mapper_database_snapshot(mapper_database db);
+
+/*! Release a snapshot retrieved using mapper_database_snapshot().
+ *  \param snap         The snapshot to release. */
+void mapper_snapshot_release(mapper_snapshot snap);
+
+/*! Get the database sequence number at which a snapshot was taken.
+ *  \param snap         The snapshot to use.
+ *  \return             The sequence number, see mapper_database_sequence(). */
+uint32_t mapper_snapshot_sequence(mapper_snapshot snap);
+
+/*! Get the number of records of a given type held by a snapshot.
+ *  \param snap         The snapshot to use.
+ *  \param type         MAPPER_OBJ_DEVICES, MAPPER_OBJ_SIGNALS,
+ *                      MAPPER_OBJ_LINKS or MAPPER_OBJ_MAPS.
+ *  \return             The number of records. */
+int mapper_snapshot_num_records(mapper_snapshot snap, mapper_object_type type);
+
+/*! Get a record held by a snapshot.  Records of each type are ordered by id.
+ *  \param snap         The snapshot to use.
+ *  \param type         The type of record.
+ *  \param index        The index of the record.
+ *  \return             The record, or zero if not found. */
+mapper_snapshot_record mapper_snapshot_record_by_index(mapper_snapshot snap,
+                                                       mapper_object_type type,
+                                                       int index);
+
+/*! Find a record held by a snapshot by its unique id.
+ *  \param snap         The snapshot to use.
+ *  \param type         The type of record.
+ *  \param id           The unique id of the record.
+ *  \return             The record, or zero if not found. */
+mapper_snapshot_record mapper_snapshot_record_by_id(mapper_snapshot snap,
+                                                    mapper_object_type type,
+                                                    mapper_id id);
+
+/*! Get the unique id of a snapshot record.
+ *  \param rec          The record to use.
+ *  \return             The unique id. */
+mapper_id mapper_snapshot_record_id(mapper_snapshot_record rec);
+
+/*! Get the number of records related to a snapshot record: the device of a
+ *  signal, the two devices of a link, or the destination signal followed by
+ *  the source signals of a map.
+ *  \param rec          The record to use.
+ *  \return             The number of related records. */
+int mapper_snapshot_record_num_refs(mapper_snapshot_record rec);
+
+/*! Get the id of a record related to a snapshot record.
+ *  \param rec          The record to use.
+ *  \param index        The index of the related record.
+ *  \return             The id of the related record, or zero if not found. */
+mapper_id mapper_snapshot_record_ref(mapper_snapshot_record rec, int index);
+
+/*! Get the number of properties of a snapshot record.
+ *  \param rec          The record to use.
+ *  \return             The number of properties. */
+int mapper_snapshot_record_num_properties(mapper_snapshot_record rec);
+
+/*! Look up a property of a snapshot record by name.
+ *  \param rec          The record to use.
+ *  \param name         The name of the property to retrieve.
+ *  \param length       A pointer to a location to receive the vector length of
+ *                      the property value. (Required.)
+ *  \param type         A pointer to a location to receive the type of the
+ *                      property value. (Required.)
+ *  \param value        A pointer to a location to receive the address of the
+ *                      property's value. (Required.)
+ *  \return             Zero if found, otherwise non-zero. */
+int mapper_snapshot_record_property(mapper_snapshot_record rec,
+                                    const char *name, int *length, char *type,
+                                    const void **value);
+
+/*! Look up a property of a snapshot record by index.
+ *  \param rec          The record to use.
+ *  \param index        Numerical index of a record property.
+ *  \param name         Address of a string pointer to receive the name of
+ *                      indexed property.  May be zero.
+ *  \param length       A pointer to a location to receive the vector length of
+ *                      the property value. (Required.)
+ *  \param type         A pointer to a location to receive the type of the
+ *                      property value. (Required.)
+ *  \param value        A pointer to a location to receive the address of the
+ *                      property's value. (Required.)
+ *  \return             Zero if found, otherwise non-zero. */
+int mapper_snapshot_record_property_index(mapper_snapshot_record rec,
+                                          unsigned int index,
+                                          const char **name, int *length,
+                                          char *type, const void **value);
+
 /* @} */
 
 /***** Time *****/
@@ -124,6 +124,24 @@ typedef enum {
     MAPPER_STEAL_NEWEST,    //!< Steal the newest instance.
 } mapper_instance_stealing_type;
 
+/*! Describes what happens when a device update queue is full.
+ *  @ingroup device */
+typedef enum {
+    MAPPER_OVERFLOW_DROP_NEWEST,    //!< Discard the update being queued.
+    MAPPER_OVERFLOW_DROP_OLDEST,    /*!< Discard the oldest queued update to
+                                     *   make room. */
+} mapper_overflow_policy;
+
+/*! Describes how signal instance values are interpolated between the times
+ *  of received samples.
+ *  @ingroup signals */
+typedef enum {
+    MAPPER_INTERP_NONE,     //!< No sample history is kept.
+    MAPPER_INTERP_HOLD,     //!< Hold the most recent sample.
+    MAPPER_INTERP_LINEAR,   //!< Linear interpolation between samples.
+    MAPPER_INTERP_CUBIC,    //!< Cubic Hermite interpolation between samples.
+} mapper_interpolation_type;
+
 /*! The set of possible events for a database record, used to inform callbacks
  *  of what is happening to a record.
  *  @ingroup database */
@@ -135,6 +153,19 @@ typedef enum {
                              *   entity. */
 } mapper_record_event;
 
+/*! A record change stored in the database journal.
+ *  @ingroup database */
+typedef struct {
+    uint32_t sequence;          //!< Database sequence number of the change.
+    mapper_object_type type;    /*!< MAPPER_OBJ_DEVICES, MAPPER_OBJ_SIGNALS,
+                                 *   MAPPER_OBJ_LINKS or MAPPER_OBJ_MAPS. */
+    mapper_record_event event;  //!< What happened to the record.
+    mapper_id id;               //!< Unique id of the record.
+    uint64_t properties;        /*!< Properties changed since the previous
+                                 *   entry for the record, as a combination of
+                                 *   mapper_database_property_mask(). */
+} mapper_database_change_t;
+
 #ifdef __cplusplus
 }
 #endif
@@ -1525,10 +1525,61 @@ namespace mapper {
             return update(&value[0],
                           (int)value.size() / mapper_signal_length(_sig), *tt);
         }
+
+        /* Bulk instance update functions */
+        Signal& update_instances(int num, const mapper_id *ids,
+                                 const void *values, Timetag tt)
+        {
+            mapper_signal_update_instances(_sig, num, ids, values, *tt);
+            return (*this);
+        }
+        Signal& update_instances(int num, const mapper_id *ids,
+                                 const int *values, Timetag tt)
+        {
+            if (mapper_signal_type(_sig) == 'i')
+                mapper_signal_update_instances(_sig, num, ids, values, *tt);
+            return (*this);
+        }
+        Signal& update_instances(int num, const mapper_id *ids,
+                                 const float *values, Timetag tt)
+        {
+            if (mapper_signal_type(_sig) == 'f')
+                mapper_signal_update_instances(_sig, num, ids, values, *tt);
+            return (*this);
+        }
+        Signal& update_instances(int num, const mapper_id *ids,
+                                 const double *values, Timetag tt)
+        {
+            if (mapper_signal_type(_sig) == 'd')
+                mapper_signal_update_instances(_sig, num, ids, values, *tt);
+            return (*this);
+        }
+        template <typename T>
+        Signal& update_instances(const std::vector<mapper_id>& ids,
+                                 const std::vector<T>& values, Timetag tt=0)
+        {
+            if (ids.empty() || values.size() < ids.size() * length())
+                return (*this);
+            return update_instances((int)ids.size(), &ids[0], &values[0], tt);
+        }
+        Signal& release_instances(const std::vector<mapper_id>& ids,
+                                  Timetag tt=0)
+        {
+            if (!ids.empty())
+                mapper_signal_update_instances(_sig, (int)ids.size(), &ids[0],
+                                               0, *tt);
+            return (*this);
+        }
         const void *value() const
             { return mapper_signal_value(_sig, 0); }
         const void *value(Timetag tt) const
             { return mapper_signal_value(_sig, (mapper_timetag_t*)tt); }
+        Signal& set_interpolation(mapper_interpolation_type type)
+            { mapper_signal_set_interpolation(_sig, type); return (*this); }
+        mapper_interpolation_type interpolation() const
+            { return mapper_signal_interpolation(_sig); }
+        int interpolate(void *value, Timetag tt) const
+            { return mapper_signal_interpolate(_sig, *tt, value); }
         int query_remotes() const
             { return mapper_signal_query_remotes(_sig, MAPPER_NOW); }
         int query_remotes(Timetag tt) const
@@ -1539,6 +1590,23 @@ namespace mapper {
             { return mapper_signal_user_data(_sig); }
         Signal& set_callback(mapper_signal_update_handler *h)
             { mapper_signal_set_callback(_sig, h); return (*this); }
+        Signal& set_jitter_buffer(double latency, int size)
+        {
+            mapper_signal_set_jitter_buffer(_sig, latency, size);
+            return (*this);
+        }
+        int jitter_buffer_stats(unsigned int *late=0,
+                                unsigned int *dropped=0) const
+            { return mapper_signal_jitter_buffer_stats(_sig, late, dropped); }
+        Signal& set_discard_out_of_order(bool discard)
+        {
+            mapper_signal_set_discard_out_of_order(_sig, discard);
+            return (*this);
+        }
+        bool discard_out_of_order() const
+            { return mapper_signal_discard_out_of_order(_sig); }
+        unsigned int num_discarded() const
+            { return mapper_signal_num_discarded(_sig); }
         int num_maps(mapper_direction dir=MAPPER_DIR_ANY) const
             { return mapper_signal_num_maps(_sig, dir); }
         Property minimum() const
@@ -1644,6 +1712,9 @@ namespace mapper {
                 mapper_timetag_t *_tt = tt;
                 return mapper_signal_instance_value(_sig, _id, _tt);
             }
+            int interpolate(void *value, Timetag tt) const
+                { return mapper_signal_instance_interpolate(_sig, _id, *tt,
+                                                            value); }
         protected:
             friend class Signal;
         private:
@@ -1865,12 +1936,45 @@ namespace mapper {
 
         int poll(int block_ms=0) const
             { return mapper_device_poll(_dev, block_ms); }
+        Device& set_poll_budget(int usec)
+        {
+            mapper_device_set_poll_budget(_dev, usec);
+            return (*this);
+        }
+        int poll_budget() const
+            { return mapper_device_poll_budget(_dev); }
+        int poll_stats(double *msgs_per_poll=0, double *usec_per_poll=0,
+                       int *backlog=0) const
+        {
+            return mapper_device_poll_stats(_dev, msgs_per_poll, usec_per_poll,
+                                            backlog);
+        }
+        Device& set_update_queue(int size, mapper_overflow_policy policy
+                                 =MAPPER_OVERFLOW_DROP_NEWEST)
+        {
+            mapper_device_set_update_queue(_dev, size, policy);
+            return (*this);
+        }
+        unsigned int update_queue_overflows() const
+            { return mapper_device_update_queue_overflows(_dev); }
+        Device& start_thread()
+            { mapper_device_start_thread(_dev); return (*this); }
+        Device& stop_thread()
+            { mapper_device_stop_thread(_dev); return (*this); }
+        const Device& lock() const
+            { mapper_device_lock(_dev); return (*this); }
+        const Device& unlock() const
+            { mapper_device_unlock(_dev); return (*this); }
         int num_fds() const
             { return mapper_device_num_fds(_dev); }
         int fds(int *fds, int num) const
             { return mapper_device_fds(_dev, fds, num); }
         Device& service_fd(int fd)
             { mapper_device_service_fd(_dev, fd); return (*this); }
+        int event_fd() const
+            { return mapper_device_event_fd(_dev); }
+        int next_timeout() const
+            { return mapper_device_next_timeout(_dev); }
         bool ready() const
             { return mapper_device_ready(_dev); }
         std::string name() const
@@ -1885,6 +1989,15 @@ namespace mapper {
             { return mapper_device_port(_dev); }
         int ordinal() const
             { return mapper_device_ordinal(_dev); }
+        Device& set_fast_allocation(bool enable=true)
+        {
+            mapper_device_set_fast_allocation(_dev, enable);
+            return (*this);
+        }
+        bool fast_allocation() const
+            { return mapper_device_fast_allocation(_dev); }
+        Device& set_ordinal(unsigned int ordinal)
+            { mapper_device_set_ordinal(_dev, ordinal); return (*this); }
         Device& start_queue(Timetag tt)
             { mapper_device_start_queue(_dev, *tt); return (*this); }
         Device& send_queue(Timetag tt)
@@ -2069,6 +2182,44 @@ namespace mapper {
         Database& set_timeout(int timeout)
             { mapper_database_set_timeout(_db, timeout); return (*this); }
 
+        /*! Retrieve whether record callbacks are called in batches.
+         *  \return         True if record callbacks are batched. */
+        bool batch_notifications() const
+            { return mapper_database_batch_notifications(_db); }
+
+        /*! Set whether record callbacks are collected, coalesced per record
+         *  and delivered in batches by poll() and flush().
+         *  \param batch    True to batch record callbacks.
+         *  \return         Self. */
+        Database& set_batch_notifications(bool batch)
+        {
+            mapper_database_set_batch_notifications(_db, batch);
+            return (*this);
+        }
+
+        /*! Deliver the record changes collected since the last batch.
+         *  \return         The number of record changes delivered. */
+        int deliver_notifications() const
+            { return mapper_database_deliver_notifications(_db); }
+
+        /*! Retrieve the sequence number of the last record change.
+         *  \return         The current sequence number. */
+        uint32_t sequence() const
+            { return mapper_database_sequence(_db); }
+
+        /*! Read the record changes made after a given sequence number.
+         *  \param sequence     The sequence number of the last change seen.
+         *  \param changes      An array to receive the changes.
+         *  \param max_changes  The size of the changes array.
+         *  \return             The number of changes read, or -1 if some of
+         *                      the changes are no longer available. */
+        int changes_since(uint32_t sequence, mapper_database_change_t *changes,
+                          int max_changes) const
+        {
+            return mapper_database_changes_since(_db, sequence, changes,
+                                                 max_changes);
+        }
+
         // database_devices
         DATABASE_METHODS(Device, device, Device::Query);
 
@@ -29,6 +29,12 @@ typedef void *mapper_network;
 //! This can be retrieved by calling mapper_network_db() or mapper_device_db().
 typedef void *mapper_database;
 
+//! A read-only copy of the records of a database.
+typedef void *mapper_snapshot;
+
+//! A device, signal, link or map record held by a snapshot.
+typedef void *mapper_snapshot_record;
+
 //! An internal data structure defining a mapper queue
 //! Used to handle a queue of mapper signals
 typedef void *mapper_queue;
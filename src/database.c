@@ -12,6 +12,7 @@ extern const char* network_message_strings[NUM_MSG_STRINGS];
 
 static void unsubscribe_internal(mapper_database db, mapper_device dev,
                                  int send_message);
+static int release_changes(mapper_database db, int deliver);
 
 #ifdef DEBUG
 static void print_subscription_flags(int flags)
@@ -81,6 +82,10 @@ void mapper_database_free(mapper_database db)
 
     // remove callbacks now so they won't be called when removing devices
     mapper_database_remove_all_callbacks(db);
+    release_changes(db, 0);
+    db->batch_notifications = 0;
+    mapper_database_free_snapshots(db);
+    db->snapshots_enabled = 0;
 
     mapper_network_remove_database(db->network);
 
@@ -133,6 +138,41 @@ void mapper_database_free(mapper_database db)
         mapper_network_free(db->network);
 }
 
+void mapper_database_free_indexes(mapper_database db)
+{
+    int i;
+    release_changes(db, 0);
+    mapper_database_free_snapshots(db);
+    if (db->journal) {
+        free(db->journal);
+        db->journal = 0;
+    }
+    mapper_hash_index_free(&db->devices_by_id);
+    mapper_hash_index_free(&db->devices_by_name);
+    mapper_hash_index_free(&db->signals_by_id);
+    mapper_hash_index_free(&db->links_by_id);
+    mapper_hash_index_free(&db->maps_by_id);
+    mapper_timer_heap_free(&db->device_expiries);
+    mapper_timer_heap_free(&db->renewals);
+
+    for (i = 0; i < PROPERTY_INDEX_CACHE_SIZE; i++) {
+        mapper_property_index_t *index = &db->property_indexes[i];
+        if (index->name)
+            free(index->name);
+        if (index->entries)
+            free(index->entries);
+        memset(index, 0, sizeof(mapper_property_index_t));
+    }
+    for (i = 0; i < QUERY_MEMO_CACHE_SIZE; i++) {
+        mapper_query_memo_t *memo = &db->query_memos[i];
+        if (memo->key)
+            free(memo->key);
+        if (memo->items)
+            free(memo->items);
+        memset(memo, 0, sizeof(mapper_query_memo_t));
+    }
+}
+
 mapper_network mapper_database_network(mapper_database db)
 {
     return db->network;
@@ -143,6 +183,13 @@ void mapper_database_set_timeout(mapper_database db, int timeout_sec)
     if (timeout_sec < 0)
         timeout_sec = TIMEOUT_SEC;
     db->timeout_sec = timeout_sec;
+
+    // move the sync deadlines of known devices
+    mapper_device dev = db->devices;
+    while (dev) {
+        mapper_database_device_synced(db, dev);
+        dev = mapper_list_next(dev);
+    }
 }
 
 int mapper_database_timeout(mapper_database db)
@@ -163,6 +210,8 @@ void mapper_database_flush(mapper_database db, int timeout_sec, int quiet)
         unsubscribe_internal(db, dev, 1);
         mapper_database_remove_device(db, dev, MAPPER_EXPIRED, quiet);
     }
+    release_changes(db, 1);
+    mapper_database_publish_snapshot(db);
 }
 
 static void add_callback(fptr_list *head, const void *f, const void *user)
@@ -195,6 +244,309 @@ static void remove_callback(fptr_list *head, const void *f, const void *user)
     free(cb);
 }
 
+static void call_handlers(mapper_database db, int type, void *record,
+                          mapper_record_event event)
+{
+    // TODO: Should we really allow callbacks to free themselves?
+    fptr_list cb, temp;
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:
+            cb = db->device_callbacks;
+            break;
+        case MAPPER_OBJ_SIGNALS:
+            cb = db->signal_callbacks;
+            break;
+        case MAPPER_OBJ_LINKS:
+            cb = db->link_callbacks;
+            break;
+        case MAPPER_OBJ_MAPS:
+            cb = db->map_callbacks;
+            break;
+        default:
+            return;
+    }
+    while (cb) {
+        temp = cb->next;
+        switch (type) {
+            case MAPPER_OBJ_DEVICES: {
+                mapper_database_device_handler *h = cb->f;
+                h(db, (mapper_device)record, event, cb->context);
+                break;
+            }
+            case MAPPER_OBJ_SIGNALS: {
+                mapper_database_signal_handler *h = cb->f;
+                h(db, (mapper_signal)record, event, cb->context);
+                break;
+            }
+            case MAPPER_OBJ_LINKS: {
+                mapper_database_link_handler *h = cb->f;
+                h(db, (mapper_link)record, event, cb->context);
+                break;
+            }
+            case MAPPER_OBJ_MAPS: {
+                mapper_database_map_handler *h = cb->f;
+                h(db, (mapper_map)record, event, cb->context);
+                break;
+            }
+        }
+        cb = temp;
+    }
+}
+
+static mapper_change add_change(mapper_database db, mapper_change *head,
+                                mapper_change *tail, int type, void *record,
+                                int event)
+{
+    mapper_change change = mapper_pool_alloc(&db->pool,
+                                             sizeof(mapper_change_t));
+    change->record = record;
+    change->type = type;
+    change->event = event;
+    if (*tail)
+        (*tail)->next = change;
+    else
+        *head = change;
+    *tail = change;
+    return change;
+}
+
+/* Collect and clear the mask of properties changed on a record. */
+static uint64_t take_changed_properties(int type, void *record,
+                                        mapper_id *id)
+{
+    uint64_t changed = 0;
+    mapper_table tab = 0;
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:
+            *id = ((mapper_device)record)->id;
+            tab = ((mapper_device)record)->props;
+            break;
+        case MAPPER_OBJ_SIGNALS:
+            *id = ((mapper_signal)record)->id;
+            tab = ((mapper_signal)record)->props;
+            break;
+        case MAPPER_OBJ_LINKS:
+            *id = ((mapper_link)record)->id;
+            tab = ((mapper_link)record)->props;
+            break;
+        case MAPPER_OBJ_MAPS: {
+            mapper_map map = (mapper_map)record;
+            int i;
+            *id = map->id;
+            tab = map->props;
+            for (i = 0; i < map->num_sources; i++) {
+                if (map->sources[i]->props) {
+                    changed |= map->sources[i]->props->changed;
+                    map->sources[i]->props->changed = 0;
+                }
+            }
+            if (map->destination.props) {
+                changed |= map->destination.props->changed;
+                map->destination.props->changed = 0;
+            }
+            break;
+        }
+    }
+    if (tab) {
+        changed |= tab->changed;
+        tab->changed = 0;
+    }
+    return changed;
+}
+
+/* Add a record change to the journal, overwriting the oldest entry once the
+ * ring is full.  A device that stays unresponsive is only journaled as
+ * expired once per sync. */
+static void journal_change(mapper_database db, int type, void *record,
+                           mapper_record_event event)
+{
+    if (event == MAPPER_EXPIRED && type == MAPPER_OBJ_DEVICES) {
+        mapper_device dev = (mapper_device)record;
+        if (dev->expiry_journaled == dev->synced.sec)
+            return;
+        dev->expiry_journaled = dev->synced.sec;
+    }
+    if (!db->journal) {
+        db->journal = malloc(sizeof(mapper_database_change_t) * JOURNAL_SIZE);
+        if (!db->journal)
+            return;
+    }
+    mapper_database_change_t *change;
+    change = &db->journal[++db->sequence % JOURNAL_SIZE];
+    change->sequence = db->sequence;
+    change->type = type;
+    change->event = event;
+    change->properties = take_changed_properties(type, record, &change->id);
+}
+
+uint32_t mapper_database_sequence(mapper_database db)
+{
+    return db->sequence;
+}
+
+int mapper_database_changes_since(mapper_database db, uint32_t sequence,
+                                  mapper_database_change_t *changes,
+                                  int max_changes)
+{
+    // sequence numbers wrap, so compare them by their difference
+    uint32_t behind = db->sequence - sequence;
+    int i;
+    if ((int32_t)behind < 0 || behind > JOURNAL_SIZE)
+        return -1;
+    if (!db->journal || !behind || !changes || max_changes < 1)
+        return 0;
+    if (behind < max_changes)
+        max_changes = behind;
+    for (i = 0; i < max_changes; i++)
+        changes[i] = db->journal[(sequence + 1 + i) % JOURNAL_SIZE];
+    return max_changes;
+}
+
+uint64_t mapper_database_property_mask(const char *property)
+{
+    if (!property)
+        return 0;
+    if (property[0] == '@')
+        ++property;
+    mapper_property_t prop = mapper_property_from_string(property);
+    return 1ULL << (prop < AT_EXTRA ? prop : AT_EXTRA);
+}
+
+/* Notify the record callbacks of a change, or add it to the pending batch.
+ * While batched, a record that was added keeps its ADDED event through later
+ * modifications, and other events are replaced by the latest one. */
+static void notify_change(mapper_database db, int type, void *record,
+                          mapper_record_event event)
+{
+    journal_change(db, type, record, event);
+    if (!db->batch_notifications) {
+        call_handlers(db, type, record, event);
+        return;
+    }
+
+    uint64_t key = (uint64_t)(uintptr_t)record;
+    mapper_change change = mapper_hash_index_find(&db->changes_by_record, key,
+                                                  0);
+    if (!change) {
+        change = add_change(db, &db->changes, &db->last_change, type, record,
+                            event);
+        mapper_hash_index_add(&db->changes_by_record, key, change);
+    }
+    else if (change->event != MAPPER_ADDED)
+        change->event = event;
+}
+
+/* Notify the record callbacks that a record has been unlinked from the
+ * database.  Returns 1 if freeing the record must wait for the batch to be
+ * delivered, since pending changes may still refer to it.  A record added and
+ * removed within the same batch is not reported at all. */
+static int notify_removal(mapper_database db, int type, void *record,
+                          mapper_record_event event, int quiet)
+{
+    journal_change(db, type, record, event);
+    if (!db->batch_notifications) {
+        if (!quiet)
+            call_handlers(db, type, record, event);
+        return 0;
+    }
+
+    uint64_t key = (uint64_t)(uintptr_t)record;
+    mapper_change change = mapper_hash_index_find(&db->changes_by_record, key,
+                                                  0);
+    if (change) {
+        if (quiet || change->event == MAPPER_ADDED)
+            change->event = -1;
+        else
+            change->event = event;
+    }
+    else if (!quiet) {
+        change = add_change(db, &db->changes, &db->last_change, type, record,
+                            event);
+        mapper_hash_index_add(&db->changes_by_record, key, change);
+    }
+    add_change(db, &db->removed, &db->last_removed, type, record, event);
+    return 1;
+}
+
+static void free_device_record(mapper_device dev)
+{
+    if (dev->props)
+        mapper_table_free(dev->props);
+    if (dev->staged_props)
+        mapper_table_free(dev->staged_props);
+    if (dev->name)
+        free(dev->name);
+    mapper_device_free_signal_index(dev);
+    mapper_list_free_item(dev);
+}
+
+static void free_record(int type, void *record)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:
+            free_device_record((mapper_device)record);
+            break;
+        case MAPPER_OBJ_SIGNALS:
+            mapper_signal_free((mapper_signal)record);
+            mapper_list_free_item(record);
+            break;
+        case MAPPER_OBJ_LINKS:
+            mapper_link_free((mapper_link)record);
+            mapper_list_free_item(record);
+            break;
+        case MAPPER_OBJ_MAPS:
+            mapper_map_free((mapper_map)record);
+            mapper_list_free_item(record);
+            break;
+    }
+}
+
+/* Detach the pending batch, optionally deliver it, and free the records that
+ * were removed in it, in the order of their removal. */
+static int release_changes(mapper_database db, int deliver)
+{
+    mapper_change change = db->changes, removed = db->removed, next;
+    int count = 0;
+
+    // handlers may cause further changes, which will start a new batch
+    db->changes = db->last_change = db->removed = db->last_removed = 0;
+    mapper_hash_index_free(&db->changes_by_record);
+
+    while (change) {
+        next = change->next;
+        if (deliver && change->event >= 0) {
+            call_handlers(db, change->type, change->record, change->event);
+            ++count;
+        }
+        mapper_pool_release(change);
+        change = next;
+    }
+    while (removed) {
+        next = removed->next;
+        free_record(removed->type, removed->record);
+        mapper_pool_release(removed);
+        removed = next;
+    }
+    return count;
+}
+
+void mapper_database_set_batch_notifications(mapper_database db, int batch)
+{
+    if (!batch)
+        release_changes(db, 1);
+    db->batch_notifications = batch ? 1 : 0;
+}
+
+int mapper_database_batch_notifications(mapper_database db)
+{
+    return db->batch_notifications;
+}
+
+int mapper_database_deliver_notifications(mapper_database db)
+{
+    return release_changes(db, 1);
+}
+
 /**** Device records ****/
 
 mapper_device mapper_database_add_or_update_device(mapper_database db,
@@ -208,11 +560,15 @@ mapper_device mapper_database_add_or_update_device(mapper_database db,
     if (!dev) {
         trace_db("adding device '%s'.\n", name);
         dev = (mapper_device)mapper_list_add_item((void**)&db->devices,
-                                                  sizeof(*dev));
+                                                  sizeof(*dev), &db->pool);
         dev->name = strdup(no_slash);
         dev->id = crc32(0L, (const Bytef *)no_slash, strlen(no_slash));
         dev->id <<= 32;
         dev->database = db;
+        mapper_hash_index_add(&db->devices_by_id, dev->id, dev);
+        mapper_hash_index_add(&db->devices_by_name,
+                              mapper_string_hash(dev->name), dev);
+        ++db->devices_version;
         init_device_prop_table(dev);
         rc = 1;
     }
@@ -223,15 +579,11 @@ mapper_device mapper_database_add_or_update_device(mapper_database db,
             trace_db("updated %d properties for device '%s'.\n", updated,
                   name);
         mapper_timetag_now(&dev->synced);
+        mapper_database_device_synced(db, dev);
 
-        if (rc || updated) {
-            fptr_list cb = db->device_callbacks;
-            while (cb) {
-                mapper_database_device_handler *h = cb->f;
-                h(db, dev, rc ? MAPPER_ADDED : MAPPER_MODIFIED, cb->context);
-                cb = cb->next;
-            }
-        }
+        if (rc || updated)
+            notify_change(db, MAPPER_OBJ_DEVICES, dev,
+                          rc ? MAPPER_ADDED : MAPPER_MODIFIED);
     }
     return dev;
 }
@@ -263,23 +615,15 @@ void mapper_database_remove_device(mapper_database db, mapper_device dev,
                                             event);
 
     mapper_list_remove_item((void**)&db->devices, dev);
-
-    if (!quiet) {
-        fptr_list cb = db->device_callbacks;
-        while (cb) {
-            mapper_database_device_handler *h = cb->f;
-            h(db, dev, event, cb->context);
-            cb = cb->next;
-        }
-    }
-
-    if (dev->props)
-        mapper_table_free(dev->props);
-    if (dev->staged_props)
-        mapper_table_free(dev->staged_props);
+    mapper_hash_index_remove(&db->devices_by_id, dev->id, dev);
+    mapper_timer_heap_remove(&db->device_expiries, &dev->expiry);
     if (dev->name)
-        free(dev->name);
-    mapper_list_free_item(dev);
+        mapper_hash_index_remove(&db->devices_by_name,
+                                 mapper_string_hash(dev->name), dev);
+    ++db->devices_version;
+
+    if (!notify_removal(db, MAPPER_OBJ_DEVICES, dev, event, quiet))
+        free_device_record(dev);
 }
 
 int mapper_database_num_devices(mapper_database db)
@@ -302,67 +646,91 @@ mapper_device mapper_database_device_by_name(mapper_database db,
                                              const char *name)
 {
     const char *no_slash = skip_slash(name);
-    mapper_device dev = db->devices;
-    while (dev) {
-        if (strcmp(dev->name, no_slash)==0)
+    unsigned int key = mapper_string_hash(no_slash);
+    mapper_device dev = 0;
+    while ((dev = mapper_hash_index_find(&db->devices_by_name, key, dev))) {
+        if (dev->name && strcmp(dev->name, no_slash)==0)
             return dev;
-        dev = mapper_list_next(dev);
     }
     return 0;
 }
 
 mapper_device mapper_database_device_by_id(mapper_database db, mapper_id id)
 {
-    mapper_device dev = db->devices;
-    while (dev) {
+    mapper_device dev = 0;
+    while ((dev = mapper_hash_index_find(&db->devices_by_id, id, dev))) {
         if (id == dev->id)
             return dev;
-        dev = mapper_list_next(dev);
     }
     return 0;
 }
 
-static int match_pattern(const char* string, const char* pattern)
+/*! A name pattern prepared for matching against many names.  '*' matches any
+ *  sequence of characters; a pattern without one must match the whole name,
+ *  otherwise its literal segments must appear in order anywhere in it. */
+typedef struct {
+    const char *pattern;
+    int exact;          //!< Set if the pattern has no '*'.
+    int ends_wild;      //!< Set if the pattern ends with '*'.
+} name_pattern_t;
+
+static void compile_pattern(name_pattern_t *p, const char *pattern)
 {
-    if (!string || !pattern)
-        return 0;
+    int length = strlen(pattern);
+    p->pattern = pattern;
+    p->exact = !strchr(pattern, '*');
+    p->ends_wild = length && pattern[length - 1] == '*';
+}
 
-    if (!strchr(pattern, '*'))
-        return strcmp(string, pattern)==0;
-
-    // 1) tokenize pattern using strtok() with delimiter character '*'
-    // 2) use strstr() to check if token exists in offset string
-    char *str = (char*)string, *tok;
-    char dup[strlen(pattern)+1], *pat = dup;
-    strcpy(pat, pattern);
-    int ends_wild = pattern[strlen(pattern)-1]  == '*';
-    while (str && *str) {
-        tok = strtok(pat, "*");
-        if (!tok)
-            return ends_wild;
-        str = strstr(str, tok);
-        if (str && *str)
-            str += strlen(tok);
-        else
+static int match_pattern(const name_pattern_t *p, const char *string)
+{
+    if (!string)
+        return 0;
+    if (p->exact)
+        return strcmp(string, p->pattern) == 0;
+
+    // find each segment between '*' in the rest of the string in turn
+    const char *seg = p->pattern, *str = string;
+    int seg_len;
+    while (*str) {
+        while (*seg == '*')
+            ++seg;
+        if (!*seg)
+            return p->ends_wild;
+        seg_len = strcspn(seg, "*");
+        while (*str && strncmp(str, seg, seg_len))
+            ++str;
+        if (!*str)
             return 0;
-        // subsequent calls to strtok() need first argument to be NULL
-        pat = NULL;
+        str += seg_len;
+        seg += seg_len;
     }
     return 1;
 }
 
+static int name_query_items(mapper_database db, char record_type,
+                            const name_pattern_t *pattern, void ***items);
+
 static int cmp_query_devices_by_name(const void *context_data, mapper_device dev)
 {
-    const char *name = (const char*)context_data;
-    return match_pattern(dev->name, name);
+    name_pattern_t p;
+    compile_pattern(&p, (const char*)context_data);
+    return match_pattern(&p, dev->name);
 }
 
 mapper_device *mapper_database_devices_by_name(mapper_database db,
                                                const char *name)
 {
+    void **items;
+    name_pattern_t p;
+    if (!db->devices || !name)
+        return 0;
+    compile_pattern(&p, name);
+    int num_items = name_query_items(db, 'd', &p, &items);
     return ((mapper_device *)
-            mapper_list_new_query(db->devices, cmp_query_devices_by_name,
-                                  "s", name));
+            mapper_list_new_array_query(db->devices, items, num_items,
+                                        cmp_query_devices_by_name, "s",
+                                        name));
 }
 
 static inline int check_type(char type)
@@ -443,19 +811,31 @@ static int compare_value(mapper_op op, int length, char type, const void *val1,
     }
 }
 
-static int cmp_query_devices_by_property(const void *context_data,
-                                         mapper_device dev)
+/**** Query indexes and memoized results ****/
+
+/* Queries on device and signal properties are answered from sorted property
+ * indexes where possible, and their results are memoized.  Both are keyed to
+ * a version counter per record type which is bumped whenever a record is
+ * added or removed, or its property table changes. */
+
+static int record_property(char record_type, void *item, const char *name,
+                           int *length, char *type, const void **value)
+{
+    if (record_type == 'd')
+        return mapper_device_property((mapper_device)item, name, length, type,
+                                      value);
+    return mapper_signal_property((mapper_signal)item, name, length, type,
+                                  value);
+}
+
+static int match_property(char record_type, void *item, const char *name,
+                          int length, char type, const void *value,
+                          mapper_op op)
 {
-    int op = *(int*)context_data;
-    int length = *(int*)(context_data + sizeof(int));
-    char type = *(char*)(context_data + sizeof(int) * 2);
-    void *value = *(void**)(context_data + sizeof(int) * 3);
-    const char *name = (const char*)(context_data + sizeof(int) * 3
-                                     + sizeof(void*));
     int _length;
     char _type;
     const void *_value;
-    if (mapper_device_property(dev, name, &_length, &_type, &_value))
+    if (record_property(record_type, item, name, &_length, &_type, &_value))
         return (op == MAPPER_OP_DOES_NOT_EXIST);
     if (op == MAPPER_OP_EXISTS)
         return 1;
@@ -466,6 +846,364 @@ static int cmp_query_devices_by_property(const void *context_data,
     return compare_value(op, length, type, _value, value);
 }
 
+static int match_name(char record_type, void *item,
+                      const name_pattern_t *pattern)
+{
+    if (record_type == 'd')
+        return match_pattern(pattern, ((mapper_device)item)->name);
+    mapper_signal sig = (mapper_signal)item;
+    return (MAPPER_DIR_ANY & sig->direction) && match_pattern(pattern,
+                                                              sig->name);
+}
+
+static void *record_list(mapper_database db, char record_type)
+{
+    return record_type == 'd' ? (void*)db->devices : (void*)db->signals;
+}
+
+static unsigned int record_version(mapper_database db, char record_type)
+{
+    return record_type == 'd' ? db->devices_version : db->signals_version;
+}
+
+/*! Properties linked to fields that are written directly rather than through
+ *  the property table cannot be tracked, so queries on them are not cached. */
+static int indexable_property(const char *name)
+{
+    return !mapper_property_written_directly(mapper_property_from_string(name));
+}
+
+#define COMPARE_SCALAR(T) ((*(T*)val1 > *(T*)val2) - (*(T*)val1 < *(T*)val2))
+
+static int compare_scalar(char type, const void *val1, const void *val2)
+{
+    switch (type) {
+        case 's':   return strcmp((const char*)val1, (const char*)val2);
+        case 'i':   return COMPARE_SCALAR(int);
+        case 'f':   return COMPARE_SCALAR(float);
+        case 'd':   return COMPARE_SCALAR(double);
+        case 'c':   return COMPARE_SCALAR(char);
+        case 'h':
+        case 't':   return COMPARE_SCALAR(uint64_t);
+        default:    return 0;
+    }
+}
+
+static int compare_index_entries(const void *l, const void *r)
+{
+    const mapper_property_index_entry_t *a = l, *b = r;
+    return compare_scalar(a->type, a->value, b->value);
+}
+
+static int compare_index_strings(const void *l, const void *r)
+{
+    const mapper_property_index_entry_t *a = l, *b = r;
+    return strcmp((const char*)a->value, (const char*)b->value);
+}
+
+/*! Get the index of records holding a scalar property of the given type,
+ *  creating or rebuilding it if necessary.  Building an index costs a few
+ *  scans of the records, so it is only done once the property has been
+ *  queried twice since the records last changed; until then zero is returned
+ *  and the caller must scan. */
+static mapper_property_index_t *property_index(mapper_database db,
+                                               char record_type,
+                                               const char *name, char type)
+{
+    int i, length;
+    char _type;
+    const void *value;
+    unsigned int version = record_version(db, record_type);
+    mapper_property_index_t *index = 0;
+
+    for (i = 0; i < PROPERTY_INDEX_CACHE_SIZE; i++) {
+        index = &db->property_indexes[i];
+        if (index->name && index->record_type == record_type
+            && index->type == type && strcmp(index->name, name) == 0)
+            break;
+    }
+    if (i < PROPERTY_INDEX_CACHE_SIZE) {
+        if (index->built && index->version == version)
+            return index;
+        if (index->requested != version) {
+            index->requested = version;
+            return 0;
+        }
+    }
+    else {
+        // replace the least recently created index
+        index = &db->property_indexes[db->next_property_index];
+        db->next_property_index = ((db->next_property_index + 1)
+                                   % PROPERTY_INDEX_CACHE_SIZE);
+        if (index->name)
+            free(index->name);
+        index->name = strdup(name);
+        index->record_type = record_type;
+        index->type = type;
+        index->built = 0;
+        index->requested = version;
+        return 0;
+    }
+
+    void *item = record_list(db, record_type);
+    for (i = 0; item; item = mapper_list_next(item))
+        ++i;
+    index->entries = realloc(index->entries, sizeof(*index->entries)
+                             * (i ? i : 1));
+    index->count = 0;
+    for (item = record_list(db, record_type); item;
+         item = mapper_list_next(item)) {
+        if (record_property(record_type, item, name, &length, &_type, &value)
+            || length != 1 || _type != type || !value)
+            continue;
+        index->entries[index->count].item = item;
+        index->entries[index->count].value = value;
+        index->entries[index->count].type = type;
+        ++index->count;
+    }
+    qsort(index->entries, index->count, sizeof(*index->entries),
+          type == 's' ? compare_index_strings : compare_index_entries);
+    index->built = 1;
+    index->version = version;
+    return index;
+}
+
+/*! Find the first entry of a sorted index with a value not less than the
+ *  given one, or greater than it if upper is set. */
+static int index_bound(mapper_property_index_t *index, const void *value,
+                       int upper)
+{
+    int lo = 0, hi = index->count, mid, cmp;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        cmp = compare_scalar(index->type, index->entries[mid].value, value);
+        if (cmp < 0 || (upper && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int add_index_range(mapper_property_index_t *index, int start,
+                           int end, void **items, int num_items)
+{
+    for (; start < end; start++)
+        items[num_items++] = index->entries[start].item;
+    return num_items;
+}
+
+/*! Serialize the parameters of a query for use as a memo key. */
+static char *query_key(char kind, const char *name, int length, char type,
+                       const void *value, mapper_op op, int *key_len)
+{
+    int i, size = 0, header[3] = {kind, op, length << 8 | type};
+    if (value && op != MAPPER_OP_EXISTS && op != MAPPER_OP_DOES_NOT_EXIST) {
+        if (type != 's')
+            size = mapper_type_size(type) * length;
+        else if (length == 1)
+            size = strlen((const char*)value) + 1;
+        else {
+            for (i = 0; i < length; i++)
+                size += strlen(((const char**)value)[i]) + 1;
+        }
+    }
+    *key_len = sizeof(header) + strlen(name) + 1 + size;
+    char *key = malloc(*key_len), *pos = key;
+    memcpy(pos, header, sizeof(header));
+    pos += sizeof(header);
+    strcpy(pos, name);
+    pos += strlen(name) + 1;
+    if (!size)
+        return key;
+    if (type != 's')
+        memcpy(pos, value, size);
+    else if (length == 1)
+        strcpy(pos, (const char*)value);
+    else {
+        for (i = 0; i < length; i++) {
+            strcpy(pos, ((const char**)value)[i]);
+            pos += strlen(pos) + 1;
+        }
+    }
+    return key;
+}
+
+static mapper_query_memo_t *find_query_memo(mapper_database db,
+                                            const char *key, int key_len,
+                                            unsigned int version)
+{
+    int i;
+    for (i = 0; i < QUERY_MEMO_CACHE_SIZE; i++) {
+        mapper_query_memo_t *memo = &db->query_memos[i];
+        if (memo->key && memo->version == version && memo->key_len == key_len
+            && memcmp(memo->key, key, key_len) == 0)
+            return memo;
+    }
+    return 0;
+}
+
+/*! Store a query result, taking ownership of the key and items. */
+static mapper_query_memo_t *add_query_memo(mapper_database db, char *key,
+                                           int key_len, unsigned int version,
+                                           void **items, int num_items)
+{
+    int i;
+    mapper_query_memo_t *memo = 0;
+    for (i = 0; i < QUERY_MEMO_CACHE_SIZE; i++) {
+        // reuse a stale entry for the same query if there is one
+        memo = &db->query_memos[i];
+        if (memo->key && memo->key_len == key_len
+            && memcmp(memo->key, key, key_len) == 0)
+            break;
+    }
+    if (i == QUERY_MEMO_CACHE_SIZE) {
+        memo = &db->query_memos[db->next_query_memo];
+        db->next_query_memo = (db->next_query_memo + 1) % QUERY_MEMO_CACHE_SIZE;
+    }
+    if (memo->key)
+        free(memo->key);
+    if (memo->items)
+        free(memo->items);
+    memo->key = key;
+    memo->key_len = key_len;
+    memo->version = version;
+    memo->items = items;
+    memo->num_items = num_items;
+    return memo;
+}
+
+/*! Find the devices or signals matching a property query.  Returns the number
+ *  of matches, or -1 if the property cannot be indexed and the query must be
+ *  evaluated lazily.  The returned items are owned by the database. */
+static int property_query_items(mapper_database db, char record_type,
+                                const char *name, int length, char type,
+                                const void *value, mapper_op op,
+                                void ***items)
+{
+    if (!indexable_property(name))
+        return -1;
+
+    unsigned int version = record_version(db, record_type);
+    int key_len, num_items = 0;
+    char *key = query_key(record_type, name, length, type, value, op,
+                          &key_len);
+    mapper_query_memo_t *memo = find_query_memo(db, key, key_len, version);
+    if (memo) {
+        free(key);
+        *items = memo->items;
+        return memo->num_items;
+    }
+
+    void *item = record_list(db, record_type);
+    mapper_property_index_t *index = 0;
+    if (length == 1 && value && op != MAPPER_OP_EXISTS
+        && op != MAPPER_OP_DOES_NOT_EXIST)
+        index = property_index(db, record_type, name, type);
+    if (index) {
+        int lo = index_bound(index, value, 0);
+        int hi = index_bound(index, value, 1);
+        *items = malloc(sizeof(void*) * (index->count ? index->count : 1));
+        switch (op) {
+            case MAPPER_OP_EQUAL:
+                num_items = add_index_range(index, lo, hi, *items, 0);
+                break;
+            case MAPPER_OP_GREATER_THAN:
+                num_items = add_index_range(index, hi, index->count, *items, 0);
+                break;
+            case MAPPER_OP_GREATER_THAN_OR_EQUAL:
+                num_items = add_index_range(index, lo, index->count, *items, 0);
+                break;
+            case MAPPER_OP_LESS_THAN:
+                num_items = add_index_range(index, 0, lo, *items, 0);
+                break;
+            case MAPPER_OP_LESS_THAN_OR_EQUAL:
+                num_items = add_index_range(index, 0, hi, *items, 0);
+                break;
+            case MAPPER_OP_NOT_EQUAL:
+                num_items = add_index_range(index, 0, lo, *items, 0);
+                num_items = add_index_range(index, hi, index->count, *items,
+                                            num_items);
+                break;
+            default:
+                break;
+        }
+    }
+    else {
+        for (; item; item = mapper_list_next(item))
+            ++num_items;
+        *items = malloc(sizeof(void*) * (num_items ? num_items : 1));
+        num_items = 0;
+        for (item = record_list(db, record_type); item;
+             item = mapper_list_next(item)) {
+            if (match_property(record_type, item, name, length, type, value,
+                               op))
+                (*items)[num_items++] = item;
+        }
+    }
+    add_query_memo(db, key, key_len, version, *items, num_items);
+    return num_items;
+}
+
+/*! Find the devices or signals with names matching a pattern.  A pattern
+ *  without '*' is looked up in the name index, others scan the records; the
+ *  results are memoized. */
+static int name_query_items(mapper_database db, char record_type,
+                            const name_pattern_t *pattern, void ***items)
+{
+    unsigned int version = record_version(db, record_type);
+    int i, key_len, num_items = 0;
+    char *key = query_key(record_type == 'd' ? 'D' : 'S', pattern->pattern, 0,
+                          0, 0, 0, &key_len);
+    mapper_query_memo_t *memo = find_query_memo(db, key, key_len, version);
+    if (memo) {
+        free(key);
+        *items = memo->items;
+        return memo->num_items;
+    }
+
+    void *item;
+    mapper_property_index_t *index = 0;
+    if (pattern->exact)
+        index = property_index(db, record_type, "name", 's');
+    if (index) {
+        int lo = index_bound(index, pattern->pattern, 0);
+        int hi = index_bound(index, pattern->pattern, 1);
+        *items = malloc(sizeof(void*) * (hi > lo ? hi - lo : 1));
+        for (i = lo; i < hi; i++) {
+            item = index->entries[i].item;
+            if (match_name(record_type, item, pattern))
+                (*items)[num_items++] = item;
+        }
+    }
+    else {
+        for (item = record_list(db, record_type); item;
+             item = mapper_list_next(item))
+            ++num_items;
+        *items = malloc(sizeof(void*) * (num_items ? num_items : 1));
+        num_items = 0;
+        for (item = record_list(db, record_type); item;
+             item = mapper_list_next(item)) {
+            if (match_name(record_type, item, pattern))
+                (*items)[num_items++] = item;
+        }
+    }
+    add_query_memo(db, key, key_len, version, *items, num_items);
+    return num_items;
+}
+
+static int cmp_query_devices_by_property(const void *context_data,
+                                         mapper_device dev)
+{
+    int op = *(int*)context_data;
+    int length = *(int*)(context_data + sizeof(int));
+    char type = *(char*)(context_data + sizeof(int) * 2);
+    void *value = *(void**)(context_data + sizeof(int) * 3);
+    const char *name = (const char*)(context_data + sizeof(int) * 3
+                                     + sizeof(void*));
+    return match_property('d', dev, name, length, type, value, op);
+}
+
 mapper_device *mapper_database_devices_by_property(mapper_database db,
                                                    const char *name, int length,
                                                    char type, const void *value,
@@ -475,6 +1213,17 @@ mapper_device *mapper_database_devices_by_property(mapper_database db,
         return 0;
     if (op <= MAPPER_OP_UNDEFINED || op >= NUM_MAPPER_OPS)
         return 0;
+    if (!db->devices)
+        return 0;
+    void **items;
+    int num_items = property_query_items(db, 'd', name, length, type, value,
+                                         op, &items);
+    if (num_items >= 0)
+        return ((mapper_device *)
+                mapper_list_new_array_query(db->devices, items, num_items,
+                                            cmp_query_devices_by_property,
+                                            "iicvs", op, length, type, &value,
+                                            name));
     return ((mapper_device *)
             mapper_list_new_query(db->devices, cmp_query_devices_by_property,
                                   "iicvs", op, length, type, &value, name));
@@ -494,23 +1243,22 @@ void mapper_database_remove_device_callback(mapper_database db,
     remove_callback(&db->device_callbacks, h, user);
 }
 
+void mapper_database_device_synced(mapper_database db, mapper_device dev)
+{
+    if (dev->local || !dev->synced.sec)
+        return;
+    // the device expires once it has not synced for more than timeout_sec
+    mapper_timer_heap_set(&db->device_expiries, &dev->expiry, dev,
+                          dev->synced.sec + db->timeout_sec + 1);
+}
+
 void mapper_database_check_device_status(mapper_database db, uint32_t time_sec)
 {
-    time_sec -= db->timeout_sec;
-    mapper_device dev = db->devices;
-    while (dev) {
-        // check if device has "checked in" recently
-        // this could be /sync ping or any sent metadata
-        if (dev->synced.sec && (dev->synced.sec < time_sec)) {
-            fptr_list cb = db->device_callbacks;
-            while (cb) {
-                mapper_database_device_handler *h = cb->f;
-                h(db, dev, MAPPER_EXPIRED, cb->context);
-                cb = cb->next;
-            }
-        }
-        dev = mapper_list_next(dev);
-    }
+    // only devices that have not "checked in" in time are visited; checking
+    // in could be a /sync ping or any sent metadata
+    mapper_device dev;
+    while ((dev = mapper_timer_heap_expired(&db->device_expiries, time_sec)))
+        notify_change(db, MAPPER_OBJ_DEVICES, dev, MAPPER_EXPIRED);
 }
 
 mapper_device mapper_database_expired_device(mapper_database db,
@@ -550,13 +1298,15 @@ mapper_signal mapper_database_add_or_update_signal(mapper_database db,
     if (!sig) {
         trace_db("adding signal '%s:%s'.\n", device_name, name);
         sig = (mapper_signal)mapper_list_add_item((void**)&db->signals,
-                                                  sizeof(mapper_signal_t));
+                                                  sizeof(mapper_signal_t),
+                                                  &db->pool);
 
         // also add device record if necessary
         sig->device = dev;
 
         // Defaults (int, length=1)
         mapper_signal_init(sig, 0, 0, name, 0, 0, 0, 0, 0, 0, 0);
+        mapper_device_index_signal(dev, sig);
 
         sig_rc = 1;
     }
@@ -567,16 +1317,9 @@ mapper_signal mapper_database_add_or_update_signal(mapper_database db,
             trace_db("updated %d properties for signal '%s:%s'.\n", updated,
                      device_name, name);
 
-        if (sig_rc || updated) {
-            // TODO: Should we really allow callbacks to free themselves?
-            fptr_list cb = db->signal_callbacks, temp;
-            while (cb) {
-                temp = cb->next;
-                mapper_database_signal_handler *h = cb->f;
-                h(db, sig, sig_rc ? MAPPER_ADDED : MAPPER_MODIFIED, cb->context);
-                cb = temp;
-            }
-        }
+        if (sig_rc || updated)
+            notify_change(db, MAPPER_OBJ_SIGNALS, sig,
+                          sig_rc ? MAPPER_ADDED : MAPPER_MODIFIED);
     }
     return sig;
 }
@@ -623,14 +1366,10 @@ mapper_signal *mapper_database_signals(mapper_database db, mapper_direction dir)
 
 mapper_signal mapper_database_signal_by_id(mapper_database db, mapper_id id)
 {
-    mapper_signal sig = db->signals;
-    if (!sig)
-        return 0;
-
-    while (sig) {
+    mapper_signal sig = 0;
+    while ((sig = mapper_hash_index_find(&db->signals_by_id, id, sig))) {
         if (sig->id == id)
             return sig;
-        sig = mapper_list_next(sig);
     }
     return 0;
 }
@@ -639,16 +1378,24 @@ static int cmp_query_signals_by_name(const void *context_data,
                                      mapper_signal sig)
 {
     int dir = *(int*)context_data;
-    const char *name = (const char*)(context_data + sizeof(int));
-    return ((dir & sig->direction) && (match_pattern(sig->name, name)));
+    name_pattern_t p;
+    compile_pattern(&p, (const char*)(context_data + sizeof(int)));
+    return ((dir & sig->direction) && (match_pattern(&p, sig->name)));
 }
 
 mapper_signal *mapper_database_signals_by_name(mapper_database db,
                                                const char *name)
 {
+    void **items;
+    name_pattern_t p;
+    if (!db->signals || !name)
+        return 0;
+    compile_pattern(&p, name);
+    int num_items = name_query_items(db, 's', &p, &items);
     return ((mapper_signal *)
-            mapper_list_new_query(db->signals, cmp_query_signals_by_name,
-                                  "is", MAPPER_DIR_ANY, name));
+            mapper_list_new_array_query(db->signals, items, num_items,
+                                        cmp_query_signals_by_name, "is",
+                                        MAPPER_DIR_ANY, name));
 }
 
 static int cmp_query_signals_by_property(const void *context_data,
@@ -660,18 +1407,7 @@ static int cmp_query_signals_by_property(const void *context_data,
     void *value = *(void**)(context_data + sizeof(int) * 3);
     const char *name = (const char*)(context_data + sizeof(int) * 3
                                      + sizeof(void*));
-    int _length;
-    char _type;
-    const void *_value;
-    if (mapper_signal_property(sig, name, &_length, &_type, &_value))
-        return (op == MAPPER_OP_DOES_NOT_EXIST);
-    if (op == MAPPER_OP_EXISTS)
-        return 1;
-    if (op == MAPPER_OP_DOES_NOT_EXIST)
-        return 0;
-    if (_type != type || _length != length)
-        return 0;
-    return compare_value(op, length, type, _value, value);
+    return match_property('s', sig, name, length, type, value, op);
 }
 
 mapper_signal *mapper_database_signals_by_property(mapper_database db,
@@ -683,6 +1419,17 @@ mapper_signal *mapper_database_signals_by_property(mapper_database db,
         return 0;
     if (op <= MAPPER_OP_UNDEFINED || op >= NUM_MAPPER_OPS)
         return 0;
+    if (!db->signals)
+        return 0;
+    void **items;
+    int num_items = property_query_items(db, 's', name, length, type, value,
+                                         op, &items);
+    if (num_items >= 0)
+        return ((mapper_signal *)
+                mapper_list_new_array_query(db->signals, items, num_items,
+                                            cmp_query_signals_by_property,
+                                            "iicvs", op, length, type, &value,
+                                            name));
     return ((mapper_signal *)
             mapper_list_new_query(db->signals, cmp_query_signals_by_property,
                                   "iicvs", op, length, type, &value, name));
@@ -697,21 +1444,21 @@ void mapper_database_remove_signal(mapper_database db, mapper_signal sig,
                                          event);
 
     mapper_list_remove_item((void**)&db->signals, sig);
+    mapper_device_unindex_signal(sig->device, sig);
 
-    fptr_list cb = db->signal_callbacks;
-    while (cb) {
-        mapper_database_signal_handler *h = cb->f;
-        h(db, sig, event, cb->context);
-        cb = cb->next;
-    }
+    int deferred = notify_removal(db, MAPPER_OBJ_SIGNALS, sig, event, 0);
 
     if (sig->direction & MAPPER_DIR_INCOMING)
         --sig->device->num_inputs;
     if (sig->direction & MAPPER_DIR_OUTGOING)
         --sig->device->num_outputs;
 
-    mapper_signal_free(sig);
-    mapper_list_free_item(sig);
+    if (!deferred)
+        free_record(MAPPER_OBJ_SIGNALS, sig);
+    else {
+        // only the record memory may wait for the batch, not device state
+        mapper_signal_release_local(sig);
+    }
 }
 
 void mapper_database_remove_signals_by_query(mapper_database db,
@@ -735,13 +1482,7 @@ static void mapper_database_call_link_handlers(mapper_database db,
     if (!db || !link)
         return;
 
-    fptr_list cb = db->link_callbacks, temp;
-    while (cb) {
-        temp = cb->next;
-        mapper_database_link_handler *h = cb->f;
-        h(db, link, event, cb->context);
-        cb = temp;
-    }
+    notify_change(db, MAPPER_OBJ_LINKS, link, event);
 }
 
 mapper_link mapper_database_add_or_update_link(mapper_database db,
@@ -759,7 +1500,10 @@ mapper_link mapper_database_add_or_update_link(mapper_database db,
         trace_db("adding link '%s' <-> '%s'.\n", dev1->name, dev2->name);
 
         link = (mapper_link)mapper_list_add_item((void**)&db->links,
-                                                 sizeof(mapper_link_t));
+                                                 sizeof(mapper_link_t),
+                                                 &db->pool);
+        // indexed before init, which may assign an id
+        mapper_hash_index_add(&db->links_by_id, 0, link);
         if (dev2->local) {
             link->local_device = dev2;
             link->remote_device = dev1;
@@ -833,11 +1577,10 @@ mapper_link *mapper_database_links(mapper_database db)
 
 mapper_link mapper_database_link_by_id(mapper_database db, mapper_id id)
 {
-    mapper_link link = db->links;
-    while (link) {
+    mapper_link link = 0;
+    while ((link = mapper_hash_index_find(&db->links_by_id, id, link))) {
         if (link->id == id)
             return link;
-        link = mapper_list_next(link);
     }
     return 0;
 }
@@ -898,18 +1641,12 @@ void mapper_database_remove_link(mapper_database db, mapper_link link,
     mapper_database_remove_maps_by_query(db, mapper_link_maps(link), event);
 
     mapper_list_remove_item((void**)&db->links, link);
-
-    fptr_list cb = db->link_callbacks;
-    while (cb) {
-        mapper_database_link_handler *h = cb->f;
-        h(db, link, event, cb->context);
-        cb = cb->next;
-    }
+    mapper_hash_index_remove(&db->links_by_id, link->id, link);
 
     // TODO: also clear network info from remote devices?
 
-    mapper_link_free(link);
-    mapper_list_free_item(link);
+    if (!notify_removal(db, MAPPER_OBJ_LINKS, link, event, 0))
+        free_record(MAPPER_OBJ_LINKS, link);
 }
 
 /**** Map records ****/
@@ -1009,9 +1746,10 @@ mapper_map mapper_database_add_or_update_map(mapper_database db, int num_sources
         }
 
         map = (mapper_map)mapper_list_add_item((void**)&db->maps,
-                                               sizeof(mapper_map_t));
+                                               sizeof(mapper_map_t), &db->pool);
         map->database = db;
         map->id = id;
+        mapper_hash_index_add(&db->maps_by_id, id, map);
         map->num_sources = num_sources;
         map->sources = (mapper_slot*) malloc(sizeof(mapper_slot) * num_sources);
         for (i = 0; i < num_sources; i++) {
@@ -1106,14 +1844,9 @@ mapper_map mapper_database_add_or_update_map(mapper_database db, int num_sources
 
         if (map->status < STATUS_ACTIVE)
             return map;
-        if (rc || updated) {
-            fptr_list cb = db->map_callbacks;
-            while (cb) {
-                mapper_database_map_handler *h = cb->f;
-                h(db, map, rc ? MAPPER_ADDED : MAPPER_MODIFIED, cb->context);
-                cb = cb->next;
-            }
-        }
+        if (rc || updated)
+            notify_change(db, MAPPER_OBJ_MAPS, map,
+                          rc ? MAPPER_ADDED : MAPPER_MODIFIED);
     }
 
     return map;
@@ -1151,11 +1884,10 @@ mapper_map *mapper_database_maps(mapper_database db)
 
 mapper_map mapper_database_map_by_id(mapper_database db, mapper_id id)
 {
-    mapper_map map = db->maps;
-    while (map) {
+    mapper_map map = 0;
+    while ((map = mapper_hash_index_find(&db->maps_by_id, id, map))) {
         if (map->id == id)
             return map;
-        map = mapper_list_next(map);
     }
     return 0;
 }
@@ -1273,13 +2005,9 @@ void mapper_database_remove_map(mapper_database db, mapper_map map,
         return;
 
     mapper_list_remove_item((void**)&db->maps, map);
+    mapper_hash_index_remove(&db->maps_by_id, map->id, map);
 
-    fptr_list cb = db->map_callbacks;
-    while (cb) {
-        mapper_database_map_handler *h = cb->f;
-        h(db, map, event, cb->context);
-        cb = cb->next;
-    }
+    int deferred = notify_removal(db, MAPPER_OBJ_MAPS, map, event, 0);
 
     // decrement num_maps property of relevant links
     mapper_device src = 0, dst = map->destination.signal->device;
@@ -1294,8 +2022,8 @@ void mapper_database_remove_map(mapper_database db, mapper_map map,
         }
     }
 
-    mapper_map_free(map);
-    mapper_list_free_item(map);
+    if (!deferred)
+        free_record(MAPPER_OBJ_MAPS, map);
 }
 
 void mapper_database_remove_all_callbacks(mapper_database db)
@@ -1431,6 +2159,7 @@ static void unsubscribe_internal(mapper_database db, mapper_device dev,
             (*s)->device->subscribed = 0;
             mapper_subscription temp = *s;
             *s = temp->next;
+            mapper_timer_heap_remove(&db->renewals, &temp->renewal);
             free(temp);
             return;
         }
@@ -1438,20 +2167,25 @@ static void unsubscribe_internal(mapper_database db, mapper_device dev,
     }
 }
 
+static void set_lease(mapper_database db, mapper_subscription s,
+                      uint32_t time_sec)
+{
+    // leave 10-second buffer for subscription renewal
+    s->lease_expiration_sec = (time_sec + AUTOSUBSCRIBE_INTERVAL - 10);
+    mapper_timer_heap_set(&db->renewals, &s->renewal, s,
+                          s->lease_expiration_sec);
+}
+
 static void renew_subscriptions(mapper_database db, uint32_t time_sec)
 {
-    // check if any subscriptions need to be renewed
-    mapper_subscription s = db->subscriptions;
-    while (s) {
-        if (s->lease_expiration_sec <= time_sec) {
-            trace_db("automatically renewing subscription to %s for %d "
-                     "seconds.\n", mapper_device_name(s->device),
-                     AUTOSUBSCRIBE_INTERVAL);
-            subscribe_internal(db, s->device, s->flags, AUTOSUBSCRIBE_INTERVAL);
-            // leave 10-second buffer for subscription renewal
-            s->lease_expiration_sec = (time_sec + AUTOSUBSCRIBE_INTERVAL - 10);
-        }
-        s = s->next;
+    // renew the subscriptions whose lease is running out
+    mapper_subscription s;
+    while ((s = mapper_timer_heap_expired(&db->renewals, time_sec))) {
+        trace_db("automatically renewing subscription to %s for %d "
+                 "seconds.\n", mapper_device_name(s->device),
+                 AUTOSUBSCRIBE_INTERVAL);
+        subscribe_internal(db, s->device, s->flags, AUTOSUBSCRIBE_INTERVAL);
+        set_lease(db, s, time_sec);
     }
 }
 
@@ -1473,6 +2207,8 @@ int mapper_database_poll(mapper_database db, int block_ms)
             count = status[0] + status[1];
             net->msgs_recvd |= count;
         }
+        release_changes(db, 1);
+        mapper_database_publish_snapshot(db);
         return count;
     }
 
@@ -1498,6 +2234,8 @@ int mapper_database_poll(mapper_database db, int block_ms)
     }
 
     net->msgs_recvd |= count;
+    release_changes(db, 1);
+    mapper_database_publish_snapshot(db);
     return count;
 }
 
@@ -1523,8 +2261,7 @@ static void mapper_database_autosubscribe(mapper_database db, int flags)
                      "to %s.\n", mapper_device_name(s->device));
             if (flags & ~s->flags) {
                 subscribe_internal(db, s->device, flags, AUTOSUBSCRIBE_INTERVAL);
-                // leave 10-second buffer for subscription renewal
-                s->lease_expiration_sec = (tt.sec + AUTOSUBSCRIBE_INTERVAL - 10);
+                set_lease(db, s, tt.sec);
             }
             s->flags = flags;
             s = s->next;
@@ -1579,7 +2316,7 @@ void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
 
         if (!s) {
             // store subscription record
-            s = malloc(sizeof(struct _mapper_subscription));
+            s = calloc(1, sizeof(struct _mapper_subscription));
             s->device = dev;
             s->device->version = -1;
             s->next = db->subscriptions;
@@ -1593,8 +2330,7 @@ void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
 
         mapper_timetag_t tt;
         mapper_timetag_now(&tt);
-        // leave 10-second buffer for subscription lease
-        s->lease_expiration_sec = (tt.sec + AUTOSUBSCRIBE_INTERVAL - 10);
+        set_lease(db, s, tt.sec);
 
         timeout = AUTOSUBSCRIBE_INTERVAL;
     }
@@ -1,3 +1,7 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // for recvmmsg() and sendmmsg()
+#endif
+
 #include <lo/lo.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -8,6 +12,7 @@
 #include <sys/time.h>
 #include <zlib.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "mapper_internal.h"
 #include "types_internal.h"
@@ -18,11 +23,43 @@
 #include <pthread.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+/* Incoming TCP connections are accepted and read by the device rather than
+ * by liblo, so that their descriptors can be added to the event set. */
+#define ACCEPT_TCP_CONNECTIONS
+#endif
+
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
+
 extern const char* network_message_strings[NUM_MSG_STRINGS];
 
+// receive budget for handling waiting messages at the end of each poll
+#define DEFAULT_POLL_BUDGET_US  1000
+#define MIN_POLL_BUDGET         8
+#define MAX_POLL_BUDGET         65536
+#define POLL_STATS_WEIGHT       0.125
+
 void init_device_prop_table(mapper_device dev)
 {
     dev->props = mapper_table_new();
+    dev->props->version = &dev->database->devices_version;
     if (!dev->local)
         dev->staged_props = mapper_table_new();
     int flags = dev->local ? NON_MODIFIABLE : MODIFIABLE;
@@ -68,6 +105,970 @@ void init_device_prop_table(mapper_device dev)
                             LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
 }
 
+/* Maximum number of bytes a single queued update can carry. */
+#define QUEUED_VALUE_BYTES (MAPPER_MAX_VECTOR_LEN * sizeof(double))
+
+#ifdef HAVE_SYS_EPOLL_H
+// Add a descriptor to the event set, if there is one.
+static void watch_fd(mapper_device dev, int fd)
+{
+    struct epoll_event ev;
+    if (dev->local->epoll_fd < 0)
+        return;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(dev->local->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        trace_dev(dev, "couldn't add descriptor to event set.\n");
+}
+
+#endif
+
+/* The update queue is a bounded multi-producer ring after D. Vyukov: each
+ * entry carries a sequence number telling producers and the consumer whether
+ * the entry is free, being written, ready, or being read.  Producers never
+ * wait on the consumer, and neither side allocates memory or takes locks. */
+
+static mapper_queued_update claim_free_update(mapper_update_queue q,
+                                              unsigned int *pos)
+{
+    mapper_queued_update e;
+    unsigned int p = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    while (1) {
+        e = &q->entries[p & q->mask];
+        int diff = (int)(__atomic_load_n(&e->sequence, __ATOMIC_ACQUIRE) - p);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &p, p + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return 0; // queue is full
+        else
+            p = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+    *pos = p;
+    return e;
+}
+
+static mapper_queued_update claim_queued_update(mapper_update_queue q,
+                                                unsigned int *pos)
+{
+    mapper_queued_update e;
+    unsigned int p = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    while (1) {
+        e = &q->entries[p & q->mask];
+        int diff = (int)(__atomic_load_n(&e->sequence, __ATOMIC_ACQUIRE)
+                         - (p + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &p, p + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return 0; // queue is empty
+        else
+            p = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+    *pos = p;
+    return e;
+}
+
+// Hand a claimed entry back to producers.
+static void free_queued_update(mapper_update_queue q, mapper_queued_update e,
+                               unsigned int pos)
+{
+    __atomic_store_n(&e->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+}
+
+int mapper_device_queue_update(mapper_device dev, mapper_signal sig, int type,
+                               mapper_id id, const void *value, int count,
+                               mapper_timetag_t tt)
+{
+    mapper_update_queue q = dev->local->update_queue;
+    mapper_queued_update e = 0;
+    unsigned int pos;
+    size_t size = 0;
+
+    if (value) {
+        if (count <= 0)
+            count = 1;
+        size = mapper_signal_vector_bytes(sig) * count;
+    }
+    else
+        count = 0;
+
+    if (size <= QUEUED_VALUE_BYTES) {
+        e = claim_free_update(q, &pos);
+        if (!e && q->policy == MAPPER_OVERFLOW_DROP_OLDEST) {
+            // discard a single queued update and try once more
+            unsigned int old_pos;
+            mapper_queued_update old = claim_queued_update(q, &old_pos);
+            if (old) {
+                free_queued_update(q, old, old_pos);
+                __atomic_add_fetch(&q->overflows, 1, __ATOMIC_RELAXED);
+            }
+            e = claim_free_update(q, &pos);
+        }
+    }
+    if (!e) {
+        __atomic_add_fetch(&q->overflows, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    e->type = type;
+    e->signal = sig;
+    e->id = id;
+    e->timetag = tt;
+    e->count = count;
+    if (size)
+        memcpy(e->value, value, size);
+
+    // publish the entry to the consumer
+    __atomic_store_n(&e->sequence, pos + 1, __ATOMIC_RELEASE);
+
+#ifdef HAVE_SYS_EVENTFD_H
+    // wake the consumer only once until it next empties the queue
+    int fd = __atomic_load_n(&dev->local->wake_fd, __ATOMIC_RELAXED);
+    if (fd >= 0 && !__atomic_exchange_n(&q->wake_pending, 1, __ATOMIC_ACQ_REL))
+        eventfd_write(fd, 1);
+#endif
+    return 0;
+}
+
+/* Reset the wake descriptor before emptying the update queue.  It is read
+ * every time since a producer may signal it just after the flag is reset. */
+static void clear_update_wake(mapper_device dev)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    eventfd_t count;
+    if (dev->local->wake_fd < 0)
+        return;
+    __atomic_store_n(&dev->local->update_queue->wake_pending, 0,
+                     __ATOMIC_SEQ_CST);
+    eventfd_read(dev->local->wake_fd, &count);
+#endif
+}
+
+/* Perform the updates that were queued before this call started; updates
+ * queued by signal handlers meanwhile are left for the next poll.  Producers
+ * queue MAPPER_NOW as it is, and those updates share the time at which this
+ * call first dequeues one. */
+static int process_update_queue(mapper_update_queue q)
+{
+    mapper_queued_update e;
+    mapper_timetag_t now = MAPPER_NOW, tt;
+    unsigned int pos, count = 0;
+    unsigned int end = __atomic_load_n(&q->enqueue_pos, __ATOMIC_ACQUIRE);
+
+    while ((int)(end - __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED)) > 0
+           && (e = claim_queued_update(q, &pos))) {
+        tt = e->timetag;
+        if (memcmp(&tt, &MAPPER_NOW, sizeof(mapper_timetag_t))==0) {
+            if (memcmp(&now, &MAPPER_NOW, sizeof(mapper_timetag_t))==0)
+                mapper_timetag_now(&now);
+            tt = now;
+        }
+        mapper_signal_process_queued_update(e->signal, e->type, e->id,
+                                            e->count ? e->value : 0, e->count,
+                                            tt);
+        free_queued_update(q, e, pos);
+        ++count;
+    }
+    return count;
+}
+
+static void process_queued_updates(mapper_device dev)
+{
+    if (dev->local->update_queue) {
+        clear_update_wake(dev);
+        process_update_queue(dev->local->update_queue);
+    }
+}
+
+static void free_update_queue(mapper_update_queue q)
+{
+    free(q->entries);
+    free(q->values);
+    free(q);
+}
+
+int mapper_device_set_update_queue(mapper_device dev, int size,
+                                   mapper_overflow_policy policy)
+{
+    int i;
+    if (!dev || !dev->local)
+        return -1;
+
+    mapper_update_queue q = dev->local->update_queue;
+    if (q) {
+        /* Detach the queue first so that updates made by handlers while it is
+         * flushed are performed directly. */
+        dev->local->update_queue = 0;
+        process_update_queue(q);
+        free_update_queue(q);
+    }
+    if (size <= 0)
+        return 0;
+
+    unsigned int len = 2;
+    while (len < (unsigned int)size && len < (1u << 16))
+        len <<= 1;
+
+    q = (mapper_update_queue) calloc(1, sizeof(mapper_update_queue_t));
+    if (!q)
+        return -1;
+    q->entries = (mapper_queued_update) malloc(len * sizeof(mapper_queued_update_t));
+    // touch the sample storage now so that queuing never faults pages in
+    q->values = (char*) malloc(len * QUEUED_VALUE_BYTES);
+    if (!q->entries || !q->values) {
+        free_update_queue(q);
+        return -1;
+    }
+    memset(q->values, 0, len * QUEUED_VALUE_BYTES);
+    for (i = 0; i < len; i++) {
+        q->entries[i].sequence = i;
+        q->entries[i].value = q->values + i * QUEUED_VALUE_BYTES;
+    }
+    q->mask = len - 1;
+    q->policy = policy;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    // let producers wake a device waiting on its descriptors
+    if (dev->local->wake_fd < 0) {
+        dev->local->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#ifdef HAVE_SYS_EPOLL_H
+        if (dev->local->wake_fd >= 0)
+            watch_fd(dev, dev->local->wake_fd);
+#endif
+    }
+#endif
+
+    dev->local->update_queue = q;
+    return 0;
+}
+
+unsigned int mapper_device_update_queue_overflows(mapper_device dev)
+{
+    if (!dev || !dev->local || !dev->local->update_queue)
+        return 0;
+    return __atomic_load_n(&dev->local->update_queue->overflows,
+                           __ATOMIC_RELAXED);
+}
+
+static int handler_signal(const char *path, const char *types, lo_arg **argv,
+                          int argc, lo_message msg, void *user_data);
+
+/* Incoming messages for signals with a jitter buffer are held in a binary
+ * min-heap keyed by their local release time, so that holding and releasing
+ * a message costs O(log n) no matter how many are pending. */
+static inline uint64_t ntp_time(mapper_timetag_t tt)
+{
+    return ((uint64_t)tt.sec << 32) | tt.frac;
+}
+
+static void jitter_sift_up(mapper_jitter_buffer jb, int i)
+{
+    mapper_scheduled_message_t e = jb->entries[i];
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (jb->entries[parent].release <= e.release)
+            break;
+        jb->entries[i] = jb->entries[parent];
+        i = parent;
+    }
+    jb->entries[i] = e;
+}
+
+static void jitter_sift_down(mapper_jitter_buffer jb, int i)
+{
+    mapper_scheduled_message_t e = jb->entries[i];
+    int child;
+    while ((child = 2 * i + 1) < jb->size) {
+        if (child + 1 < jb->size
+            && jb->entries[child+1].release < jb->entries[child].release)
+            ++child;
+        if (e.release <= jb->entries[child].release)
+            break;
+        jb->entries[i] = jb->entries[child];
+        i = child;
+    }
+    jb->entries[i] = e;
+}
+
+/* Offset from the clock of the device sending to a signal to the local clock,
+ * or zero if the link's clock has not been synchronised yet. */
+static double sender_clock_offset(mapper_device dev, mapper_signal sig,
+                                  mapper_slot slot)
+{
+    mapper_link link = (slot ? slot->link
+                        : mapper_router_incoming_link(dev->local->router, sig));
+    if (link && link->local && !link->local->clock.new)
+        return link->local->clock.offset;
+    return 0;
+}
+
+/* Hold an incoming message until timetag + latency in local time.  Returns 1
+ * if the message was consumed, or 0 if it should be applied immediately. */
+static int hold_signal_message(mapper_device dev, mapper_signal sig,
+                               mapper_slot slot, lo_message msg,
+                               mapper_timetag_t tt)
+{
+    mapper_local_signal lsig = sig->local;
+    mapper_jitter_buffer jb = &dev->local->jitter_buffer;
+    mapper_timetag_t now, release = tt;
+
+    mapper_timetag_now(&now);
+    if (tt.sec == 0 && tt.frac == 1) {
+        // message was sent without a timetag
+        release = now;
+    }
+    else {
+        // convert from the sender's clock
+        mapper_timetag_add_double(&release,
+                                  sender_clock_offset(dev, sig, slot));
+    }
+    mapper_timetag_add_double(&release, lsig->jitter_latency);
+
+    if (ntp_time(release) <= ntp_time(now)) {
+        ++lsig->jitter_late;
+        return 0;
+    }
+    if (lsig->jitter_pending >= lsig->jitter_size) {
+        ++lsig->jitter_dropped;
+        return 1;
+    }
+    if (jb->size >= jb->capacity) {
+        int capacity = jb->capacity ? jb->capacity * 2 : 64;
+        mapper_scheduled_message entries;
+        entries = realloc(jb->entries,
+                          capacity * sizeof(mapper_scheduled_message_t));
+        if (!entries) {
+            ++lsig->jitter_dropped;
+            return 1;
+        }
+        jb->entries = entries;
+        jb->capacity = capacity;
+    }
+
+    lo_message_incref(msg);
+    jb->entries[jb->size].release = ntp_time(release);
+    jb->entries[jb->size].signal = sig;
+    jb->entries[jb->size].msg = msg;
+    jitter_sift_up(jb, jb->size++);
+    ++lsig->jitter_pending;
+    return 1;
+}
+
+static void deliver_signal_message(mapper_device dev,
+                                   mapper_scheduled_message_t e)
+{
+    mapper_jitter_buffer jb = &dev->local->jitter_buffer;
+    lo_message prev = jb->releasing;
+    jb->releasing = e.msg;
+    handler_signal(e.signal->path, lo_message_get_types(e.msg),
+                   lo_message_get_argv(e.msg), lo_message_get_argc(e.msg),
+                   e.msg, e.signal);
+    jb->releasing = prev;
+    lo_message_free(e.msg);
+}
+
+/* Deliver all held messages that have reached their release time. */
+static int process_jitter_buffer(mapper_device dev)
+{
+    mapper_jitter_buffer jb = &dev->local->jitter_buffer;
+    mapper_scheduled_message_t e;
+    mapper_timetag_t now;
+    uint64_t now_ntp;
+    int count = 0;
+
+    if (!jb->size)
+        return 0;
+    mapper_timetag_now(&now);
+    now_ntp = ntp_time(now);
+    while (jb->size && jb->entries[0].release <= now_ntp) {
+        e = jb->entries[0];
+        jb->entries[0] = jb->entries[--jb->size];
+        if (jb->size)
+            jitter_sift_down(jb, 0);
+        --e.signal->local->jitter_pending;
+        deliver_signal_message(dev, e);
+        ++count;
+    }
+    return count;
+}
+
+/* Milliseconds until the next held message is due, capped at max_ms. */
+static int jitter_buffer_wait_ms(mapper_device dev, int max_ms)
+{
+    mapper_jitter_buffer jb = &dev->local->jitter_buffer;
+    mapper_timetag_t now, release;
+    double wait;
+
+    if (!jb->size)
+        return max_ms;
+    mapper_timetag_now(&now);
+    release.sec = jb->entries[0].release >> 32;
+    release.frac = jb->entries[0].release & 0xFFFFFFFF;
+    wait = mapper_timetag_difference(release, now) * 1000;
+    if (wait <= 0)
+        return 0;
+    return wait < max_ms ? (int)wait + 1 : max_ms;
+}
+
+static int compare_release(const void *l, const void *r)
+{
+    uint64_t a = ((mapper_scheduled_message)l)->release;
+    uint64_t b = ((mapper_scheduled_message)r)->release;
+    return a < b ? -1 : a > b;
+}
+
+void mapper_device_flush_jitter_buffer(mapper_device dev, mapper_signal sig,
+                                       int deliver)
+{
+    mapper_jitter_buffer jb = &dev->local->jitter_buffer;
+    mapper_scheduled_message flushed;
+    int i, size = 0, num_flushed = 0;
+
+    if (!jb->size)
+        return;
+
+    // move the matching messages out, then restore the heap over the rest
+    flushed = (mapper_scheduled_message)
+        malloc(jb->size * sizeof(mapper_scheduled_message_t));
+    for (i = 0; i < jb->size; i++) {
+        if (!sig || jb->entries[i].signal == sig)
+            flushed[num_flushed++] = jb->entries[i];
+        else
+            jb->entries[size++] = jb->entries[i];
+    }
+    jb->size = size;
+    for (i = size / 2 - 1; i >= 0; i--)
+        jitter_sift_down(jb, i);
+
+    qsort(flushed, num_flushed, sizeof(mapper_scheduled_message_t),
+          compare_release);
+    for (i = 0; i < num_flushed; i++) {
+        --flushed[i].signal->local->jitter_pending;
+        if (deliver)
+            deliver_signal_message(dev, flushed[i]);
+        else
+            lo_message_free(flushed[i].msg);
+    }
+    free(flushed);
+}
+
+/* Where recvmmsg() and sendmmsg() are available, datagrams waiting on the
+ * device UDP server are drained several at a time and handed to liblo with
+ * lo_server_dispatch_data(), and the bundles sent by mapper_device_send_queue()
+ * are serialised and sent to all links together. */
+
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+
+#define UDP_BATCH_SIZE      32
+#define UDP_DATAGRAM_SIZE   65536
+
+struct _mapper_udp_batch {
+    // incoming datagrams, one maximum-sized buffer each
+    char *recv_data;
+    struct mmsghdr recv_msgs[UDP_BATCH_SIZE];
+    struct iovec recv_iov[UDP_BATCH_SIZE];
+    struct sockaddr_storage recv_addrs[UDP_BATCH_SIZE];
+    struct sockaddr_storage *source;    // sender of the datagram in dispatch
+
+    // serialised outgoing bundles, packed into a single buffer
+    char *send_data;
+    size_t send_len;
+    size_t send_size;
+    int num_sends;
+    size_t send_offsets[UDP_BATCH_SIZE];
+    size_t send_lengths[UDP_BATCH_SIZE];
+    struct sockaddr_storage send_addrs[UDP_BATCH_SIZE];
+    socklen_t send_addr_lens[UDP_BATCH_SIZE];
+};
+
+static struct _mapper_udp_batch *get_udp_batch(mapper_device dev)
+{
+    if (!dev->local->udp_batch)
+        dev->local->udp_batch = ((struct _mapper_udp_batch*)
+                                 calloc(1, sizeof(struct _mapper_udp_batch)));
+    return dev->local->udp_batch;
+}
+
+static void free_udp_batch(mapper_device dev)
+{
+    struct _mapper_udp_batch *b = dev->local->udp_batch;
+    if (!b)
+        return;
+    if (b->recv_data)
+        free(b->recv_data);
+    if (b->send_data)
+        free(b->send_data);
+    free(b);
+    dev->local->udp_batch = 0;
+}
+
+/* Address to reply to for a message dispatched from a batch. liblo only
+ * records the sender for datagrams it received itself, so a new address is
+ * returned here that must be freed by the caller. */
+static lo_address batch_source_address(mapper_device dev)
+{
+    struct _mapper_udp_batch *b = dev->local->udp_batch;
+    char host[NI_MAXHOST], port[NI_MAXSERV];
+    if (!b || !b->source)
+        return 0;
+    if (getnameinfo((struct sockaddr*)b->source, sizeof(*b->source),
+                    host, NI_MAXHOST, port, NI_MAXSERV,
+                    NI_NUMERICHOST | NI_NUMERICSERV))
+        return 0;
+    return lo_address_new(host, port);
+}
+
+#else
+
+static void free_udp_batch(mapper_device dev) {}
+
+static lo_address batch_source_address(mapper_device dev)
+{
+    return 0;
+}
+
+#endif /* HAVE_RECVMMSG || HAVE_SENDMMSG */
+
+/* Receive up to UDP_BATCH_SIZE waiting datagrams from the device UDP server
+ * with a single system call and dispatch them to the liblo methods. Returns
+ * the number of datagrams handled, or 0 if batching is not supported. */
+static int recv_udp_batch(mapper_device dev)
+{
+#ifdef HAVE_RECVMMSG
+    struct _mapper_udp_batch *b;
+    int i, n, fd;
+
+    if (!dev->local->udp_server || !(b = get_udp_batch(dev)))
+        return 0;
+    if (!b->recv_data) {
+        /* Only the pages touched by received datagrams are committed, so
+         * reserving the maximum datagram size for each slot is cheap. */
+        b->recv_data = malloc(UDP_BATCH_SIZE * UDP_DATAGRAM_SIZE);
+        if (!b->recv_data)
+            return 0;
+    }
+    for (i = 0; i < UDP_BATCH_SIZE; i++) {
+        b->recv_iov[i].iov_base = b->recv_data + i * UDP_DATAGRAM_SIZE;
+        b->recv_iov[i].iov_len = UDP_DATAGRAM_SIZE;
+        memset(&b->recv_msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+        b->recv_msgs[i].msg_hdr.msg_iov = &b->recv_iov[i];
+        b->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        b->recv_msgs[i].msg_hdr.msg_name = &b->recv_addrs[i];
+        b->recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    fd = lo_server_get_socket_fd(dev->local->udp_server);
+    do {
+        n = recvmmsg(fd, b->recv_msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return 0;
+
+    for (i = 0; i < n; i++) {
+        b->source = &b->recv_addrs[i];
+        lo_server_dispatch_data(dev->local->udp_server, b->recv_iov[i].iov_base,
+                                b->recv_msgs[i].msg_len);
+    }
+    b->source = 0;
+    return n;
+#else
+    return 0;
+#endif
+}
+
+#ifdef HAVE_SENDMMSG
+static int resolve_link_address(mapper_device dev, mapper_link link)
+{
+    struct addrinfo hints, *info;
+    struct sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    const char *host = lo_address_get_hostname(link->local->udp_data_addr);
+    const char *port = lo_address_get_port(link->local->udp_data_addr);
+    int fd = lo_server_get_socket_fd(dev->local->udp_server);
+
+    // resolve to the address family of the socket we will be sending from
+    if (!host || !port || getsockname(fd, (struct sockaddr*)&local, &len))
+        return -1;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = local.ss_family;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_V4MAPPED;
+    if (getaddrinfo(host, port, &hints, &info))
+        return -1;
+    if (!info || info->ai_addrlen > sizeof(struct sockaddr_storage)) {
+        freeaddrinfo(info);
+        return -1;
+    }
+    link->local->udp_sockaddr = malloc(sizeof(struct sockaddr_storage));
+    memcpy(link->local->udp_sockaddr, info->ai_addr, info->ai_addrlen);
+    link->local->udp_sockaddr_len = info->ai_addrlen;
+    freeaddrinfo(info);
+    return 0;
+}
+#endif
+
+/*! Add a bundle for a link to the outgoing batch of the device, to be sent
+ *  with the next call to mapper_device_send_batch(). The bundle is
+ *  serialised immediately and may be freed by the caller. Returns 0 if the
+ *  bundle was added, or -1 if it must be sent directly. */
+int mapper_device_batch_bundle(mapper_device dev, mapper_link link,
+                               lo_bundle bundle)
+{
+#ifdef HAVE_SENDMMSG
+    struct _mapper_udp_batch *b;
+    size_t len;
+    int i;
+
+    if (!dev->local->udp_server || !link->local->udp_data_addr
+        || !(b = get_udp_batch(dev)))
+        return -1;
+    if (!link->local->udp_sockaddr && resolve_link_address(dev, link))
+        return -1;
+    if (!(len = lo_bundle_length(bundle)))
+        return -1;
+
+    if (b->num_sends >= UDP_BATCH_SIZE) {
+        mapper_device_send_batch(dev);
+        // if the socket is still full, leave the bundle to the caller
+        if (b->num_sends >= UDP_BATCH_SIZE)
+            return -1;
+    }
+    if (b->send_len + len > b->send_size) {
+        size_t size = b->send_size ? b->send_size : 4096;
+        while (size < b->send_len + len)
+            size *= 2;
+        char *data = realloc(b->send_data, size);
+        if (!data)
+            return -1;
+        b->send_data = data;
+        b->send_size = size;
+    }
+    if (!lo_bundle_serialise(bundle, b->send_data + b->send_len, &len))
+        return -1;
+
+    i = b->num_sends++;
+    b->send_offsets[i] = b->send_len;
+    b->send_lengths[i] = len;
+    memcpy(&b->send_addrs[i], link->local->udp_sockaddr,
+           link->local->udp_sockaddr_len);
+    b->send_addr_lens[i] = link->local->udp_sockaddr_len;
+    b->send_len += len;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/*! Send all bundles added by mapper_device_batch_bundle() using a single
+ *  system call where possible. Bundles the socket has no room for are kept
+ *  for the next call. */
+void mapper_device_send_batch(mapper_device dev)
+{
+#ifdef HAVE_SENDMMSG
+    struct _mapper_udp_batch *b = dev->local->udp_batch;
+    struct mmsghdr msgs[UDP_BATCH_SIZE];
+    struct iovec iov[UDP_BATCH_SIZE];
+    int i, n, fd, sent = 0;
+    size_t start;
+
+    if (!b || !b->num_sends)
+        return;
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * b->num_sends);
+    for (i = 0; i < b->num_sends; i++) {
+        iov[i].iov_base = b->send_data + b->send_offsets[i];
+        iov[i].iov_len = b->send_lengths[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &b->send_addrs[i];
+        msgs[i].msg_hdr.msg_namelen = b->send_addr_lens[i];
+    }
+
+    fd = lo_server_get_socket_fd(dev->local->udp_server);
+    while (sent < b->num_sends) {
+        n = sendmmsg(fd, msgs + sent, b->num_sends - sent, 0);
+        if (n > 0)
+            sent += n;
+        else if (errno == EINTR)
+            continue;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            break;
+        else {
+            // like liblo, drop a datagram that cannot be sent at all
+            trace_dev(dev, "dropping datagram: %s\n", strerror(errno));
+            ++sent;
+        }
+    }
+
+    // keep what the socket had no room for until the next flush
+    b->num_sends -= sent;
+    if (!b->num_sends) {
+        b->send_len = 0;
+        return;
+    }
+    start = b->send_offsets[sent];
+    b->send_len -= start;
+    memmove(b->send_data, b->send_data + start, b->send_len);
+    for (i = 0; i < b->num_sends; i++) {
+        b->send_offsets[i] = b->send_offsets[sent + i] - start;
+        b->send_lengths[i] = b->send_lengths[sent + i];
+        b->send_addrs[i] = b->send_addrs[sent + i];
+        b->send_addr_lens[i] = b->send_addr_lens[sent + i];
+    }
+#endif
+}
+
+#ifdef ACCEPT_TCP_CONNECTIONS
+
+#define TCP_READ_SIZE       65536
+#define MAX_TCP_MESSAGE     (1 << 24)
+
+struct _mapper_tcp_connection {
+    int fd;
+    char *data;                 // received bytes not yet dispatched
+    size_t length;
+    size_t size;
+};
+
+struct _mapper_tcp_server {
+    int fd;                     // listening descriptor taken from liblo
+    int reply_fd;               // connection of the message in dispatch
+    int num_connections;
+    struct _mapper_tcp_connection *connections;
+};
+
+/* Take the listening socket of the TCP server away from liblo, leaving it a
+ * descriptor that never becomes readable in its place.  liblo then only
+ * services the connections it opened for sending, while the device accepts
+ * and reads incoming connections itself so that their descriptors can be
+ * waited on along with the others. */
+static void take_tcp_server(mapper_device dev)
+{
+    struct _mapper_tcp_server *t;
+    int fd = lo_server_get_socket_fd(dev->local->tcp_server);
+    int own = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    int idle = eventfd(0, EFD_CLOEXEC);
+
+    if (own < 0 || idle < 0 || fcntl(own, F_SETFL, O_NONBLOCK) < 0
+        || !(t = calloc(1, sizeof(struct _mapper_tcp_server)))
+        || dup2(idle, fd) < 0) {
+        trace_dev(dev, "couldn't take over TCP server, leaving it to liblo.\n");
+        if (own >= 0)
+            close(own);
+        if (idle >= 0)
+            close(idle);
+        return;
+    }
+    close(idle);
+    t->fd = own;
+    t->reply_fd = -1;
+    dev->local->tcp = t;
+}
+
+static void close_tcp_connection(mapper_device dev, int index)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    struct _mapper_tcp_connection *c = &t->connections[index];
+    if (dev->local->epoll_fd >= 0)
+        epoll_ctl(dev->local->epoll_fd, EPOLL_CTL_DEL, c->fd, 0);
+    close(c->fd);
+    free(c->data);
+    *c = t->connections[--t->num_connections];
+}
+
+static void free_tcp_server(mapper_device dev)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    if (!t)
+        return;
+    while (t->num_connections)
+        close_tcp_connection(dev, 0);
+    free(t->connections);
+    close(t->fd);
+    free(t);
+    dev->local->tcp = 0;
+}
+
+static void accept_tcp_connections(mapper_device dev)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    struct _mapper_tcp_connection *c;
+    int fd;
+
+    while ((fd = accept4(t->fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        c = realloc(t->connections, (t->num_connections + 1)
+                    * sizeof(struct _mapper_tcp_connection));
+        if (!c) {
+            close(fd);
+            return;
+        }
+        t->connections = c;
+        c = &t->connections[t->num_connections++];
+        memset(c, 0, sizeof(struct _mapper_tcp_connection));
+        c->fd = fd;
+        watch_fd(dev, fd);
+    }
+}
+
+/* Read what is waiting on an accepted connection and dispatch each complete
+ * message.  liblo prefixes messages on a stream with their length as a 32-bit
+ * big-endian integer.  Returns the number of messages handled, or -1 if the
+ * connection was closed. */
+static int recv_tcp_connection(mapper_device dev, int index)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    struct _mapper_tcp_connection *c = &t->connections[index];
+    size_t pos = 0;
+    uint32_t len;
+    ssize_t n;
+    int count = 0;
+
+    if (c->size - c->length < TCP_READ_SIZE) {
+        char *data = realloc(c->data, c->length + TCP_READ_SIZE);
+        if (!data)
+            return 0;
+        c->data = data;
+        c->size = c->length + TCP_READ_SIZE;
+    }
+    do {
+        n = read(c->fd, c->data + c->length, c->size - c->length);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if (n <= 0) {
+        close_tcp_connection(dev, index);
+        return -1;
+    }
+    c->length += n;
+
+    t->reply_fd = c->fd;
+    while (c->length - pos >= sizeof(len)) {
+        memcpy(&len, c->data + pos, sizeof(len));
+        len = ntohl(len);
+        if (len > MAX_TCP_MESSAGE) {
+            trace_dev(dev, "closing TCP connection with oversized message.\n");
+            t->reply_fd = -1;
+            close_tcp_connection(dev, index);
+            return -1;
+        }
+        if (c->length - pos - sizeof(len) < len)
+            break;
+        lo_server_dispatch_data(dev->local->tcp_server,
+                                c->data + pos + sizeof(len), len);
+        pos += sizeof(len) + len;
+        ++count;
+    }
+    t->reply_fd = -1;
+
+    c->length -= pos;
+    if (pos && c->length)
+        memmove(c->data, c->data + pos, c->length);
+    return count;
+}
+
+/* Send a bundle back on the connection of the message being dispatched,
+ * since liblo does not know where messages read by the device came from.
+ * Returns 0 if no such message is being dispatched. */
+static int reply_tcp(mapper_device dev, lo_bundle b)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    struct pollfd writable;
+    size_t len, sent = 0;
+    uint32_t prefix;
+    ssize_t n;
+    char *data;
+
+    if (!t || t->reply_fd < 0)
+        return 0;
+    len = lo_bundle_length(b);
+    if (!len || !(data = malloc(len + sizeof(prefix))))
+        return 1;
+    prefix = htonl(len);
+    memcpy(data, &prefix, sizeof(prefix));
+    lo_bundle_serialise(b, data + sizeof(prefix), 0);
+    len += sizeof(prefix);
+
+    // a partial message would corrupt the stream, so wait a little for room
+    writable.fd = t->reply_fd;
+    writable.events = POLLOUT;
+    while (sent < len) {
+        n = send(t->reply_fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n > 0)
+            sent += n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+                 && poll(&writable, 1, 100) > 0)
+            continue;
+        else
+            break;
+    }
+    free(data);
+    return 1;
+}
+
+/* Accept any new TCP connections and handle the messages waiting on those
+ * already accepted.  Returns the number of messages handled. */
+static int recv_tcp(mapper_device dev)
+{
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    int i, n, num, count = 0;
+
+    if (!t)
+        return 0;
+    num = t->num_connections;
+    struct pollfd fds[num + 1];
+    for (i = 0; i < num; i++) {
+        fds[i].fd = t->connections[i].fd;
+        fds[i].events = POLLIN;
+    }
+    fds[num].fd = t->fd;
+    fds[num].events = POLLIN;
+    if (poll(fds, num + 1, 0) <= 0)
+        return 0;
+
+    /* A closed connection is replaced by the last one, which has been read
+     * already when going backwards. */
+    for (i = num - 1; i >= 0; i--) {
+        if (fds[i].revents && (n = recv_tcp_connection(dev, i)) > 0)
+            count += n;
+    }
+    if (fds[num].revents) {
+        // new connections usually carry a message already
+        i = t->num_connections;
+        accept_tcp_connections(dev);
+        while (i < t->num_connections) {
+            if ((n = recv_tcp_connection(dev, i)) >= 0) {
+                count += n;
+                ++i;
+            }
+        }
+    }
+    return count;
+}
+
+#else
+
+static void free_tcp_server(mapper_device dev) {}
+
+static int reply_tcp(mapper_device dev, lo_bundle b)
+{
+    return 0;
+}
+
+static int recv_tcp(mapper_device dev)
+{
+    return 0;
+}
+
+#endif /* ACCEPT_TCP_CONNECTIONS */
+
 /*! Allocate and initialize a mapper device. This function is called to create
  *  a new mapper_device, not to create a representation of remote devices. */
 mapper_device mapper_device_new(const char *name_prefix, int port,
@@ -84,8 +1085,11 @@ mapper_device mapper_device_new(const char *name_prefix, int port,
     mapper_database db = &net->database;
     mapper_device dev;
     dev = (mapper_device)mapper_list_add_item((void**)&db->devices,
-                                              sizeof(mapper_device_t));
+                                              sizeof(mapper_device_t),
+                                              &db->pool);
     dev->database = db;
+    mapper_hash_index_add(&db->devices_by_id, dev->id, dev);
+    ++db->devices_version;
     dev->local = (mapper_local_device)calloc(1, sizeof(mapper_local_device_t));
     dev->local->own_network = 1 - net->own_network;
 
@@ -113,9 +1117,14 @@ mapper_device mapper_device_new(const char *name_prefix, int port,
     dev->local->router->device = dev;
 
     dev->local->link_timeout_sec = TIMEOUT_SEC;
+    dev->local->epoll_fd = -1;
+    dev->local->wake_fd = -1;
+    dev->local->poll_stats.budget_us = DEFAULT_POLL_BUDGET_US;
+    dev->local->poll_stats.budget = MIN_POLL_BUDGET;
 
     dev->local->active_id_maps = (mapper_id_map *) malloc(sizeof(mapper_id_map *));
     dev->local->active_id_maps[0] = 0;
+    dev->local->active_id_map_index = calloc(1, sizeof(mapper_id_map_index_t));
     dev->local->num_signal_groups = 1;
 
     mapper_network_add_device(net, dev);
@@ -138,9 +1147,30 @@ void mapper_device_free(mapper_device dev)
     mapper_database db = dev->database;
     mapper_network net = dev->database->network;
 
+    mapper_device_stop_thread(dev);
+
     // free any queued outgoing messages without sending
     mapper_network_free_messages(net);
 
+    // discard any updates handed off by other threads
+    if (dev->local->update_queue) {
+        free_update_queue(dev->local->update_queue);
+        dev->local->update_queue = 0;
+    }
+
+    // discard any incoming messages still held for later release
+    mapper_device_flush_jitter_buffer(dev, 0, 0);
+    if (dev->local->jitter_buffer.entries)
+        free(dev->local->jitter_buffer.entries);
+
+    if (dev->local->epoll_fd >= 0) {
+        close(dev->local->epoll_fd);
+        dev->local->epoll_fd = -1;
+    }
+    if (dev->local->wake_fd >= 0)
+        close(dev->local->wake_fd);
+    free_udp_batch(dev);
+
     // remove subscribers
     mapper_subscriber s;
     while (dev->local->subscribers) {
@@ -165,6 +1195,8 @@ void mapper_device_free(mapper_device dev)
         }
         mapper_device_remove_signal(dev, sig);
     }
+    if (dev->local->aliases)
+        free(dev->local->aliases);
 
     if (dev->local->registered) {
         // A registered device must tell the network it is leaving.
@@ -196,7 +1228,10 @@ void mapper_device_free(mapper_device dev)
             dev->local->active_id_maps[i] = map->next;
             free(map);
         }
+        free(dev->local->active_id_map_index[i].by_local);
+        free(dev->local->active_id_map_index[i].by_global);
     }
+    free(dev->local->active_id_map_index);
     while (dev->local->reserve_id_maps) {
         map = dev->local->reserve_id_maps;
         dev->local->reserve_id_maps = map->next;
@@ -216,8 +1251,11 @@ void mapper_device_free(mapper_device dev)
 
     if (dev->local->udp_server)
         lo_server_free(dev->local->udp_server);
+    free_tcp_server(dev);
     if (dev->local->tcp_server)
         lo_server_free(dev->local->tcp_server);
+    if (dev->local->ordinal.peers)
+        free(dev->local->ordinal.peers);
     free(dev->local);
 
     if (dev->identifier)
@@ -288,10 +1326,15 @@ void mapper_device_registered(mapper_device dev)
                     (*sig)->local->id_maps[i].map->global |= dev->id;
                 }
             }
+            mapper_signal_reindex_id_maps(*sig);
+            mapper_id id = (*sig)->id;
             (*sig)->id |= dev->id;
+            mapper_device_reindex_signal_id(dev, *sig, id);
         }
         sig = mapper_signal_query_next(sig);
     }
+    mapper_device_reindex_instance_id_maps(dev);
+    dev->ordinal = dev->local->ordinal.value;
     dev->local->registered = 1;
     dev->status = STATUS_READY;
 }
@@ -322,6 +1365,81 @@ static int check_types(const char *types, int len, char type, int vector_len)
     return len / vector_len;
 }
 
+/* Check a property key of a data message, which may be sent either in full
+ * or in the short form used with path aliases. */
+static int is_property_key(const char *key, mapper_property_t prop,
+                           const char *alias_key)
+{
+    return (strcmp(key, mapper_property_protocol_string(prop)) == 0
+            || strcmp(key, alias_key) == 0);
+}
+
+/* Find the cached layout of a data message for this signal.  Besides the
+ * typetag, the property keys found at the instance and slot positions must
+ * match, since other properties may share their typetags. */
+static mapper_message_shape match_message_shape(mapper_signal sig,
+                                                const char *types,
+                                                lo_arg **argv)
+{
+    int i;
+    mapper_message_shape shape;
+    for (i = 0; i < MESSAGE_SHAPE_CACHE_SIZE; i++) {
+        shape = &sig->local->shapes[i];
+        if (!shape->types || strcmp(shape->types, types))
+            continue;
+        if (shape->instance_arg >= 0
+            && !is_property_key(&argv[shape->instance_arg - 1]->s,
+                                AT_INSTANCE, ALIAS_INSTANCE_KEY))
+            return 0;
+        if (shape->slot_arg >= 0
+            && !is_property_key(&argv[shape->slot_arg - 1]->s, AT_SLOT,
+                                ALIAS_SLOT_KEY))
+            return 0;
+        return shape;
+    }
+    return 0;
+}
+
+static mapper_message_shape add_message_shape(mapper_signal sig,
+                                              const char *types, int value_len,
+                                              int nulls, int instance_arg,
+                                              int slot_arg)
+{
+    mapper_message_shape shape;
+    shape = &sig->local->shapes[sig->local->next_shape];
+    sig->local->next_shape = ((sig->local->next_shape + 1)
+                              % MESSAGE_SHAPE_CACHE_SIZE);
+    if (shape->types)
+        free(shape->types);
+    memset(shape, 0, sizeof(mapper_message_shape_t));
+    if (!(shape->types = strdup(types)))
+        return 0;
+    shape->value_len = value_len;
+    shape->nulls = nulls;
+    shape->instance_arg = instance_arg;
+    shape->slot_arg = slot_arg;
+    return shape;
+}
+
+/* liblo decodes message arguments in place, so a run of arguments of the same
+ * type without nulls is normally an aligned, host-order array inside the
+ * message buffer.  Check that this is the case before borrowing it. */
+static int values_are_contiguous(lo_arg **argv, int len, int size)
+{
+    if ((uintptr_t)argv[0] % size)
+        return 0;
+    return ((char*)argv[len-1] - (char*)argv[0]) == (len - 1) * size;
+}
+
+/* Check if a timetag is older than the last one applied.  Messages sent
+ * without a timetag are never considered out of order. */
+static inline int out_of_order(mapper_timetag_t *last, lo_timetag tt)
+{
+    if (tt.sec == 0 && tt.frac == 1)
+        return 0;
+    return tt.sec < last->sec || (tt.sec == last->sec && tt.frac < last->frac);
+}
+
 /* Notes:
  * - Incoming signal values may be scalars or vectors, but much match the
  *   length of the target signal or mapping slot.
@@ -334,6 +1452,8 @@ static int check_types(const char *types, int len, char type, int vector_len)
  *   within the network of libmapper devices
  * - Updates to specific "slots" of a convergent (i.e. multi-source) mapping
  *   are indicated using the label "@slot" followed by a single integer slot #
+ * - Updates sent to an aliased signal path may use the shorter labels "@i" and
+ *   "@s" instead
  * - Multiple "samples" of a signal value may be packed into a single message
  * - In future updates, instance release may be triggered by expression eval
  */
@@ -369,12 +1489,21 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
     mapper_signal_update_handler *update_h = sig->local->update_handler;
     mapper_instance_event_handler *event_h = sig->local->instance_event_handler;
 
+    int value_len = 0, instance_arg = -1, slot_arg = -1;
+    mapper_message_shape shape = match_message_shape(sig, types, argv);
+    if (shape) {
+        value_len = shape->value_len;
+        nulls = shape->nulls;
+        instance_arg = shape->instance_arg;
+        slot_arg = shape->slot_arg;
+        goto parsed;
+    }
+
     // We need to consider that there may be properties appended to the msg
     // check length and find properties if any
-    int value_len = 0;
     while (value_len < argc && types[value_len] != 's' && types[value_len] != 'S') {
         // count nulls here also to save time
-        if (types[i] == 'N')
+        if (types[value_len] == 'N')
             ++nulls;
         ++value_len;
     }
@@ -388,8 +1517,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
 #endif
             return 0;
         }
-        if (strcmp(&argv[argnum]->s,
-                   mapper_property_protocol_string(AT_INSTANCE)) == 0
+        if (is_property_key(&argv[argnum]->s, AT_INSTANCE, ALIAS_INSTANCE_KEY)
             && argc >= argnum + 2) {
             if (types[argnum+1] != 'h') {
 #ifdef DEBUG
@@ -398,11 +1526,10 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
 #endif
                 return 0;
             }
-            global_id = argv[argnum+1]->i64;
+            instance_arg = argnum + 1;
             argnum += 2;
         }
-        else if (strcmp(&argv[argnum]->s,
-                        mapper_property_protocol_string(AT_SLOT)) == 0
+        else if (is_property_key(&argv[argnum]->s, AT_SLOT, ALIAS_SLOT_KEY)
                  && argc >= argnum + 2) {
             if (types[argnum+1] != 'i') {
 #ifdef DEBUG
@@ -411,7 +1538,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
 #endif
                 return 0;
             }
-            slot_index = argv[argnum+1]->i32;
+            slot_arg = argnum + 1;
             argnum += 2;
         }
         else {
@@ -422,16 +1549,35 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             return 0;
         }
     }
+    shape = add_message_shape(sig, types, value_len, nulls, instance_arg,
+                              slot_arg);
+
+  parsed:
+    if (instance_arg >= 0)
+        global_id = argv[instance_arg]->i64;
+    if (slot_arg >= 0)
+        slot_index = argv[slot_arg]->i32;
 
     if (slot_index >= 0) {
-        // retrieve mapping associated with this slot
-        slot = mapper_router_slot(dev->local->router, sig, slot_index);
+        // retrieve mapping associated with this slot, reusing the last lookup
+        // for this message shape while the router is unchanged
+        if (shape && shape->slot && shape->slot_index == slot_index
+            && shape->router_version == dev->local->router->version
+            && shape->slot->id == slot_index)
+            slot = shape->slot;
+        else
+            slot = mapper_router_slot(dev->local->router, sig, slot_index);
         if (!slot) {
 #ifdef DEBUG
             printf("error in handler_signal: slot %d not found.\n", slot_index);
 #endif
             return 0;
         }
+        if (shape) {
+            shape->slot = slot;
+            shape->slot_index = slot_index;
+            shape->router_version = dev->local->router->version;
+        }
         map = slot->map;
         if (map->status < STATUS_READY) {
 #ifdef DEBUG
@@ -455,19 +1601,25 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             count = check_types(types, value_len, sig->type, sig->length);
         }
     }
+    else if (shape && shape->count) {
+        count = shape->count;
+    }
     else {
         count = check_types(types, value_len, sig->type, sig->length);
+        if (shape)
+            shape->count = count;
     }
 
     if (!count)
         return 0;
 
-    // TODO: optionally discard out-of-order messages
-    // requires timebase sync for many-to-one mappings or local updates
-    //    if (sig->discard_out_of_order && out_of_order(si->timetag, tt))
-    //        return 0;
     lo_timetag tt = lo_message_get_timestamp(msg);
 
+    if (sig->local->jitter_latency > 0
+        && msg != dev->local->jitter_buffer.releasing
+        && hold_signal_message(dev, sig, slot, msg, tt))
+        return 0;
+
     if (global_id) {
         id_map_index = mapper_signal_find_instance_with_global_id(sig, global_id,
                                                                   RELEASED_LOCALLY);
@@ -495,7 +1647,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 if (count == 1 && nulls == value_len) {
                     // we can clear signal's reference to map
                     id_map = sig->local->id_maps[id_map_index].map;
-                    sig->local->id_maps[id_map_index].map = 0;
+                    mapper_signal_clear_id_map(sig, id_map_index);
                     --id_map->refcount_global;
                     if (id_map->refcount_global <= 0
                         && id_map->refcount_local <= 0) {
@@ -528,6 +1680,24 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
     int id = si->index;
     id_map = sig->local->id_maps[id_map_index].map;
 
+    /* Optionally discard messages older than the last one applied.  Each
+     * source of a convergent map is checked against its own slot history
+     * since the sources' clocks may differ. */
+    if (sig->local->discard_out_of_order) {
+        if (map) {
+            mapper_history h = &slot->local->history[id];
+            if (h->position >= 0
+                && out_of_order(&h->timetag[h->position], tt)) {
+                ++sig->local->num_discarded;
+                return 0;
+            }
+        }
+        else if (si->has_value && out_of_order(&si->timetag, tt)) {
+            ++sig->local->num_discarded;
+            return 0;
+        }
+    }
+
     int size = (slot ? mapper_type_size(slot->signal->type)
                 : mapper_type_size(sig->type));
     void *out_buffer = alloca(count * value_len * size);
@@ -573,11 +1743,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 if (map->process_location != MAPPER_LOC_DESTINATION)
                     continue;
                 /* Reset memory for corresponding source slot. */
-                memset(slot_loc->history[id].value, 0, slot_loc->history_size
-                       * slot->signal->length * size);
-                memset(slot_loc->history[id].timetag, 0,
-                       slot_loc->history_size * sizeof(mapper_timetag_t));
-                slot_loc->history[id].position = -1;
+                mhist_reset(&slot_loc->history[id]);
                 continue;
             }
             else if (vals != slot->signal->length) {
@@ -613,6 +1779,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             }
             slot_loc->history[id].position = ((slot_loc->history[id].position + 1)
                                               % slot_loc->history[id].size);
+            mapper_history_touch(&slot_loc->history[id],
+                                 slot_loc->history[id].position);
             memcpy(mapper_history_value_ptr(slot_loc->history[id]),
                    argv[i*count], size * slot->signal->length);
             memcpy(mapper_history_tt_ptr(slot_loc->history[id]), &tt,
@@ -679,7 +1847,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     memcpy(&si->timetag, &tt, sizeof(mapper_timetag_t));
                     if (count > 1) {
                         memcpy(out_buffer + out_count * sig->length * size,
-                               si->value, size);
+                               si->value, size * sig->length);
                         ++out_count;
                     }
                     else {
@@ -703,6 +1871,23 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 update_h(sig, id_map->local, out_buffer, out_count, &tt);
         }
     }
+    else if (!nulls && values_are_contiguous(argv, value_len,
+                                             mapper_type_size(sig->type))) {
+        /* Fast path for complete updates: the router and update handler
+         * borrow the values from the message buffer, and only the newest
+         * sample is copied into the instance. */
+        size_t n = mapper_signal_vector_bytes(sig);
+        memcpy(si->value, (char*)argv[0] + n * (count - 1), n);
+        memcpy(si->has_value_flags, sig->local->has_complete_value,
+               sig->length / 8 + 1);
+        si->has_value = 1;
+        memcpy(&si->timetag, &tt, sizeof(mapper_timetag_t));
+        if (!(sig->direction & MAPPER_DIR_OUTGOING))
+            mapper_device_route_signal(dev, sig, id_map_index, argv[0], count,
+                                       tt);
+        if (update_h)
+            update_h(sig, id_map->local, argv[0], count, &tt);
+    }
     else {
         for (i = 0, k = 0; i < count; i++) {
             vals = 0;
@@ -743,7 +1928,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 memcpy(&si->timetag, &tt, sizeof(mapper_timetag_t));
                 if (count > 1) {
                     memcpy(out_buffer + out_count * sig->length * size,
-                           si->value, size);
+                           si->value, size * sig->length);
                     ++out_count;
                 }
                 else {
@@ -764,6 +1949,15 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
         }
     }
 
+    if (sig->local->interpolation && active && si->has_value) {
+        // keep interpolation history in local time
+        if (tt.sec == 0 && tt.frac == 1)
+            mapper_timetag_now(&tt);
+        else
+            mapper_timetag_add_double(&tt, sender_clock_offset(dev, sig, slot));
+        mapper_signal_instance_store_sample(sig, si, tt);
+    }
+
     return 0;
 }
 
@@ -858,29 +2052,24 @@ static int handler_query(const char *path, const char *types, lo_arg **argv,
         }
     }
 
-    lo_send_bundle(lo_message_get_source(msg), b);
+    if (reply_tcp(dev, b)) {
+        lo_bundle_free_recursive(b);
+        return 0;
+    }
+    lo_address source = batch_source_address(dev);
+    lo_send_bundle(source ? source : lo_message_get_source(msg), b);
     lo_bundle_free_recursive(b);
+    if (source)
+        lo_address_free(source);
     return 0;
 }
 
 static mapper_id get_unused_signal_id(mapper_device dev)
 {
-    int done = 0;
     mapper_id id;
-    while (!done) {
-        done = 1;
+    do {
         id = mapper_device_generate_unique_id(dev);
-        // check if input signal exists with this id
-        mapper_signal *sig = mapper_device_signals(dev, MAPPER_DIR_ANY);
-        while (sig) {
-            if ((*sig)->id == id) {
-                done = 0;
-                mapper_signal_query_done(sig);
-                break;
-            }
-            sig = mapper_signal_query_next(sig);
-        }
-    }
+    } while (mapper_device_signal_by_id(dev, id));
     return id;
 }
 
@@ -907,13 +2096,15 @@ mapper_signal mapper_device_add_signal(mapper_device dev, mapper_direction dir,
         return sig;
 
     sig = (mapper_signal)mapper_list_add_item((void**)&db->signals,
-                                              sizeof(mapper_signal_t));
+                                              sizeof(mapper_signal_t),
+                                              &db->pool);
     sig->local = (mapper_local_signal)calloc(1, sizeof(mapper_local_signal_t));
 
     sig->device = dev;
     sig->id = get_unused_signal_id(dev);
     mapper_signal_init(sig, dir, num_instances, name, length, type, unit,
                        minimum, maximum, handler, user_data);
+    mapper_device_index_signal(dev, sig);
 
     if (dir == MAPPER_DIR_INCOMING)
         ++dev->num_inputs;
@@ -957,44 +2148,137 @@ mapper_signal mapper_device_add_output_signal(mapper_device dev, const char *nam
 
 void mapper_device_add_signal_methods(mapper_device dev, mapper_signal sig)
 {
-    if (!sig || !sig->local)
+    if (!sig || !sig->local || sig->local->has_methods)
         return;
 
-    lo_server udp = dev->local->udp_server,
-              tcp = dev->local->tcp_server;
-
-    int len = strlen(sig->path) + 5;
-    char *path = (char*)malloc(sizeof(char) * len);
-    snprintf(path, len, "%s%s", sig->path, "/get");
-    lo_server_add_method(udp, path, NULL, handler_query, (void*)(sig));
-    lo_server_add_method(tcp, path, NULL, handler_query, (void*)(sig));
-    free(path);
-
-    lo_server_add_method(udp, sig->path, NULL, handler_signal, (void*)(sig));
-    lo_server_add_method(tcp, sig->path, NULL, handler_signal, (void*)(sig));
+    // messages are routed to the signal by handler_device
+    sig->local->has_methods = 1;
+    if (sig->local->alias)
+        dev->local->aliases[sig->local->alias - 1] = sig;
 
     ++dev->local->n_output_callbacks;
 }
 
 void mapper_device_remove_signal_methods(mapper_device dev, mapper_signal sig)
 {
-    if (!sig || !sig->local)
+    if (!sig || !sig->local || !sig->local->has_methods)
         return;
 
-    char *path = 0;
-    int len = (int)strlen(sig->path) + 5;
-    path = (char*)realloc(path, len);
-    snprintf(path, len, "%s%s", sig->path, "/get");
-    lo_server_del_method(dev->local->udp_server, path, NULL);
-    lo_server_del_method(dev->local->tcp_server, path, NULL);
-    free(path);
-
-    lo_server_del_method(dev->local->udp_server, sig->path, NULL);
-    lo_server_del_method(dev->local->tcp_server, sig->path, NULL);
+    sig->local->has_methods = 0;
+    if (sig->local->alias)
+        dev->local->aliases[sig->local->alias - 1] = 0;
 
     --dev->local->n_output_callbacks;
 }
 
+/*! Return the path alias of a local signal, assigning one if necessary.
+ *  Aliases are never reused, so that updates still in flight for a removed
+ *  signal cannot reach another one.  Returns 0 if none could be assigned. */
+int mapper_device_signal_alias(mapper_device dev, mapper_signal sig)
+{
+    if (!dev->local || !sig->local)
+        return 0;
+    if (sig->local->alias)
+        return sig->local->alias;
+
+    mapper_signal *aliases = realloc(dev->local->aliases, sizeof(mapper_signal)
+                                     * (dev->local->num_aliases + 1));
+    if (!aliases)
+        return 0;
+    aliases[dev->local->num_aliases++] = sig;
+    dev->local->aliases = aliases;
+    sig->local->alias = dev->local->num_aliases;
+    return sig->local->alias;
+}
+
+/* Catch-all method registered ahead of the signal methods: messages sent to
+ * an aliased path are passed to the signal found by array index, anything
+ * else falls through to the methods matching the full path. */
+static int handler_alias(const char *path, const char *types, lo_arg **argv,
+                         int argc, lo_message msg, void *user_data)
+{
+    mapper_device dev = (mapper_device)user_data;
+    mapper_signal sig;
+    char *end;
+
+    long alias = strtol(path + 2, &end, 10);
+    if (*end || alias < 1 || alias > dev->local->num_aliases
+        || !(sig = dev->local->aliases[alias - 1])) {
+#ifdef DEBUG
+        printf("error in handler_alias: unknown alias '%s'.\n", path);
+#endif
+        return 0;
+    }
+    return handler_signal(sig->path, types, argv, argc, msg, sig);
+}
+
+/* Dispatch a message whose path is an OSC pattern to every matching signal. */
+static int dispatch_pattern(mapper_device dev, const char *path,
+                            const char *types, lo_arg **argv, int argc,
+                            lo_message msg)
+{
+    int len, handled = 0;
+    char *query_path = 0;
+    mapper_signal *sigs = mapper_device_signals(dev, MAPPER_DIR_ANY);
+    while (sigs) {
+        mapper_signal sig = *sigs;
+        sigs = mapper_signal_query_next(sigs);
+        if (!sig->local || !sig->local->has_methods)
+            continue;
+        if (lo_pattern_match(sig->path, path)) {
+            handler_signal(sig->path, types, argv, argc, msg, sig);
+            ++handled;
+            continue;
+        }
+        len = strlen(sig->path) + 5;
+        query_path = realloc(query_path, len);
+        snprintf(query_path, len, "%s/get", sig->path);
+        if (lo_pattern_match(query_path, path)) {
+            handler_query(query_path, types, argv, argc, msg, sig);
+            ++handled;
+        }
+    }
+    if (query_path)
+        free(query_path);
+    return !handled;
+}
+
+/* Route messages to the signals of this device.  Signal paths are looked up
+ * in the device's signal index instead of being added to the servers as
+ * individual liblo methods, which liblo would search one by one for every
+ * registration and every incoming message. */
+static int handler_device(const char *path, const char *types, lo_arg **argv,
+                          int argc, lo_message msg, void *user_data)
+{
+    mapper_device dev = (mapper_device)user_data;
+    mapper_signal sig;
+
+    if (strncmp(path, ALIAS_PREFIX, 2) == 0)
+        return handler_alias(path, types, argv, argc, msg, user_data);
+
+    sig = mapper_device_signal_by_name(dev, path);
+    if (sig && sig->local && sig->local->has_methods)
+        return handler_signal(path, types, argv, argc, msg, sig);
+
+    int len = strlen(path);
+    if (len > 4 && strcmp(path + len - 4, "/get") == 0) {
+        char *name = alloca(len - 3);
+        memcpy(name, path, len - 4);
+        name[len - 4] = 0;
+        sig = mapper_device_signal_by_name(dev, name);
+        if (sig && sig->local && sig->local->has_methods)
+            return handler_query(path, types, argv, argc, msg, sig);
+    }
+
+    if (strpbrk(path, "*?[]{}"))
+        return dispatch_pattern(dev, path, types, argv, argc, msg);
+
+#ifdef DEBUG
+    printf("error in handler_device: no signal found for path '%s'.\n", path);
+#endif
+    return 1;
+}
+
 static void send_unmap(mapper_network net, mapper_map map)
 {
     if (!map->status)
@@ -1035,6 +2319,11 @@ void mapper_device_remove_signal(mapper_device dev, mapper_signal sig)
     if (!dev || !sig || !sig->local || sig->device != dev)
         return;
 
+    // queued updates may still refer to this signal
+    if (dev->local->update_queue)
+        process_update_queue(dev->local->update_queue);
+    mapper_device_flush_jitter_buffer(dev, sig, 0);
+
     mapper_direction dir = sig->direction;
     mapper_device_remove_signal_methods(dev, sig);
 
@@ -1090,18 +2379,118 @@ mapper_signal *mapper_device_signals(mapper_device dev, mapper_direction dir)
                                   cmp_query_device_signals, "hi", dev->id, dir));
 }
 
+/* Rebuild the signal indexes with a new number of buckets. */
+static void rehash_signal_index(mapper_signal_index_t *index, int size)
+{
+    int i, b;
+    mapper_signal sig, next;
+    mapper_signal *by_name = calloc(size, sizeof(mapper_signal));
+    mapper_signal *by_id = calloc(size, sizeof(mapper_signal));
+    for (i = 0; i < index->size; i++) {
+        for (sig = index->by_name[i]; sig; sig = next) {
+            next = sig->next_by_name;
+            b = mapper_string_hash(sig->name) & (size - 1);
+            sig->next_by_name = by_name[b];
+            by_name[b] = sig;
+        }
+        for (sig = index->by_id[i]; sig; sig = next) {
+            next = sig->next_by_id;
+            b = mapper_id_hash(sig->id) & (size - 1);
+            sig->next_by_id = by_id[b];
+            by_id[b] = sig;
+        }
+    }
+    free(index->by_name);
+    free(index->by_id);
+    index->by_name = by_name;
+    index->by_id = by_id;
+    index->size = size;
+}
+
+void mapper_device_index_signal(mapper_device dev, mapper_signal sig)
+{
+    mapper_signal_index_t *index = &dev->signal_index;
+    if (index->count >= index->size)
+        rehash_signal_index(index, index->size ? index->size * 2 : 16);
+    int b = mapper_string_hash(sig->name) & (index->size - 1);
+    sig->next_by_name = index->by_name[b];
+    index->by_name[b] = sig;
+    b = mapper_id_hash(sig->id) & (index->size - 1);
+    sig->next_by_id = index->by_id[b];
+    index->by_id[b] = sig;
+    ++index->count;
+    mapper_hash_index_add(&dev->database->signals_by_id, sig->id, sig);
+    ++dev->database->signals_version;
+}
+
+static void unindex_signal_id(mapper_signal_index_t *index, mapper_signal sig,
+                              mapper_id id)
+{
+    mapper_signal *temp = &index->by_id[mapper_id_hash(id) & (index->size - 1)];
+    while (*temp) {
+        if (*temp == sig) {
+            *temp = sig->next_by_id;
+            break;
+        }
+        temp = &(*temp)->next_by_id;
+    }
+    sig->next_by_id = 0;
+}
+
+void mapper_device_unindex_signal(mapper_device dev, mapper_signal sig)
+{
+    mapper_signal_index_t *index = &dev->signal_index;
+    if (!index->size)
+        return;
+    mapper_signal *temp = &index->by_name[mapper_string_hash(sig->name)
+                                          & (index->size - 1)];
+    while (*temp) {
+        if (*temp == sig)
+            break;
+        temp = &(*temp)->next_by_name;
+    }
+    if (!*temp)
+        return;
+    *temp = sig->next_by_name;
+    sig->next_by_name = 0;
+    unindex_signal_id(index, sig, sig->id);
+    --index->count;
+    mapper_hash_index_remove(&dev->database->signals_by_id, sig->id, sig);
+    ++dev->database->signals_version;
+}
+
+void mapper_device_reindex_signal_id(mapper_device dev, mapper_signal sig,
+                                     mapper_id old_id)
+{
+    mapper_signal_index_t *index = &dev->signal_index;
+    if (!index->size || sig->id == old_id)
+        return;
+    unindex_signal_id(index, sig, old_id);
+    int b = mapper_id_hash(sig->id) & (index->size - 1);
+    sig->next_by_id = index->by_id[b];
+    index->by_id[b] = sig;
+    mapper_hash_index_rekey(&dev->database->signals_by_id, old_id, sig->id,
+                            sig);
+    ++dev->database->signals_version;
+}
+
+void mapper_device_free_signal_index(mapper_device dev)
+{
+    free(dev->signal_index.by_name);
+    free(dev->signal_index.by_id);
+    memset(&dev->signal_index, 0, sizeof(mapper_signal_index_t));
+}
+
 mapper_signal mapper_device_signal_by_id(mapper_device dev, mapper_id id)
 {
-    if (!dev)
-        return 0;
-    mapper_signal sig = dev->database->signals;
-    if (!sig)
+    if (!dev || !dev->signal_index.size)
         return 0;
-
+    int b = mapper_id_hash(id) & (dev->signal_index.size - 1);
+    mapper_signal sig = dev->signal_index.by_id[b];
     while (sig) {
-        if ((sig->device == dev) && (sig->id == id))
+        if (sig->id == id)
             return sig;
-        sig = mapper_list_next(sig);
+        sig = sig->next_by_id;
     }
     return 0;
 }
@@ -1109,16 +2498,15 @@ mapper_signal mapper_device_signal_by_id(mapper_device dev, mapper_id id)
 mapper_signal mapper_device_signal_by_name(mapper_device dev,
                                            const char *sig_name)
 {
-    if (!dev)
+    if (!dev || !sig_name || !dev->signal_index.size)
         return 0;
-    mapper_signal sig = dev->database->signals;
-    if (!sig)
-        return 0;
-
+    sig_name = skip_slash(sig_name);
+    int b = mapper_string_hash(sig_name) & (dev->signal_index.size - 1);
+    mapper_signal sig = dev->signal_index.by_name[b];
     while (sig) {
-        if ((sig->device == dev) && strcmp(sig->name, skip_slash(sig_name))==0)
-        return sig;
-        sig = mapper_list_next(sig);
+        if (strcmp(sig->name, sig_name) == 0)
+            return sig;
+        sig = sig->next_by_name;
     }
     return 0;
 }
@@ -1258,11 +2646,84 @@ mapper_link mapper_device_link_by_remote_device(mapper_device dev,
     return 0;
 }
 
-int mapper_device_poll(mapper_device dev, int block_ms)
+/* Handle messages still waiting on the data servers at the end of a poll,
+ * up to an adaptive number of messages and within the time budget of the
+ * device, and update the poll statistics.  The message budget follows the
+ * recent number of messages per poll, and doubles whenever it runs out
+ * before the servers are empty.  Returns the number of messages handled. */
+static int drain_servers(mapper_device dev, lo_server *servers, int handled)
 {
-    if (!dev || !dev->local)
-        return 0;
+    mapper_poll_stats_t *stats = &dev->local->poll_stats;
+    double start = mapper_get_current_time(), now = start;
+    int status[2], tcp, count = 0, exhausted = 0;
+
+    while (1) {
+        if (count >= stats->budget
+            || (stats->budget_us
+                && (now - start) * 1000000 >= stats->budget_us)) {
+            exhausted = 1;
+            break;
+        }
+        tcp = recv_tcp(dev);
+        if (!lo_servers_recv_noblock(servers, status, 2, 0) && !tcp)
+            break;
+        count += status[0] + status[1] + tcp;
+        if (status[0])
+            count += recv_udp_batch(dev);
+        now = mapper_get_current_time();
+    }
+    now = mapper_get_current_time();
+
+    handled += count;
+    stats->msgs += (handled - stats->msgs) * POLL_STATS_WEIGHT;
+    stats->usec += ((now - start) * 1000000 - stats->usec) * POLL_STATS_WEIGHT;
+
+    if (exhausted) {
+        /* Messages may still be waiting; assume the backlog is at least as
+         * deep as what could be handled this time. */
+        stats->backlog = count;
+        if (count >= stats->budget && stats->budget < MAX_POLL_BUDGET)
+            stats->budget *= 2;
+    }
+    else {
+        stats->backlog = 0;
+        stats->budget = stats->msgs * 2 + 1;
+        if (stats->budget < MIN_POLL_BUDGET)
+            stats->budget = MIN_POLL_BUDGET;
+    }
+    return count;
+}
+
+/* Wait until messages arrive for the device, another thread queues an
+ * update, or the timeout expires. */
+static void wait_for_messages(mapper_device dev, lo_server *servers, int ms)
+{
+#ifdef ACCEPT_TCP_CONNECTIONS
+    struct _mapper_tcp_server *t = dev->local->tcp;
+    if (t) {
+        int i, num = 4;
+        struct pollfd fds[t->num_connections + 5];
+        for (i = 0; i < 4; i++)
+            fds[i].fd = i < 3 ? lo_server_get_socket_fd(servers[i]) : t->fd;
+        for (i = 0; i < t->num_connections; i++)
+            fds[num++].fd = t->connections[i].fd;
+        if (dev->local->wake_fd >= 0)
+            fds[num++].fd = dev->local->wake_fd;
+        for (i = 0; i < num; i++)
+            fds[i].events = POLLIN;
+        poll(fds, num, ms);
+        return;
+    }
+#endif
+    int status[4];
+    // without a wake descriptor, check for queued updates every millisecond
+    if (dev->local->update_queue && dev->local->wake_fd < 0 && ms > 1)
+        ms = 1;
+    lo_servers_wait(servers, status, 4, ms);
+}
 
+static int poll_device(mapper_device dev, int block_ms)
+{
     int admin_count = 0, device_count = 0, status[4];
     mapper_network net = dev->database->network;
 
@@ -1273,6 +2734,11 @@ int mapper_device_poll(mapper_device dev, int block_ms)
 
     mapper_network_poll(net);
 
+    // retry datagrams the socket had no room for at the last flush
+    mapper_device_send_batch(dev);
+    process_queued_updates(dev);
+    process_jitter_buffer(dev);
+
     if (!dev->local->registered) {
         if (lo_servers_recv_noblock(servers, status, 2, 0)) {
             admin_count = status[0] + status[1];
@@ -1284,22 +2750,34 @@ int mapper_device_poll(mapper_device dev, int block_ms)
         if (lo_servers_recv_noblock(servers, status, 4, 0)) {
             admin_count = status[0] + status[1];
             device_count = status[2] + status[3];
+            if (status[2])
+                device_count += recv_udp_batch(dev);
             net->msgs_recvd |= admin_count;
         }
+        device_count += process_jitter_buffer(dev);
+        device_count += drain_servers(dev, &servers[2],
+                                      admin_count + device_count);
         return admin_count + device_count;
     }
 
     double then = mapper_get_current_time();
     int left_ms = block_ms, elapsed, checked_admin = 0;
     while (left_ms > 0) {
-        // set timeout to a maximum of 100ms
+        // set timeout to a maximum of 100ms, or until a held message is due
         if (left_ms > 100)
             left_ms = 100;
+        left_ms = jitter_buffer_wait_ms(dev, left_ms);
 
-        if (lo_servers_recv_noblock(servers, status, 4, left_ms)) {
+        wait_for_messages(dev, servers, left_ms);
+        process_queued_updates(dev);
+        if (lo_servers_recv_noblock(servers, status, 4, 0)) {
             admin_count += status[0] + status[1];
             device_count += status[2] + status[3];
+            if (status[2])
+                device_count += recv_udp_batch(dev);
         }
+        device_count += recv_tcp(dev);
+        device_count += process_jitter_buffer(dev);
 
         elapsed = (mapper_get_current_time() - then) * 1000;
         if ((elapsed - checked_admin) > 100) {
@@ -1310,14 +2788,10 @@ int mapper_device_poll(mapper_device dev, int block_ms)
         left_ms = block_ms - elapsed;
     }
 
-    /* When done, or if non-blocking, check for remaining messages up to a
-     * proportion of the number of input signals. Arbitrarily choosing 1 for
-     * now, but perhaps could be a heuristic based on a recent number of
-     * messages per channel per poll. */
-    while (device_count < (dev->num_inputs + dev->local->n_output_callbacks)*1
-           && (lo_servers_recv_noblock(&servers[2], &status[2], 2, 0))) {
-        device_count += status[2] + status[3];
-    }
+    process_queued_updates(dev);
+
+    // when done, check for remaining messages
+    device_count += drain_servers(dev, &servers[2], admin_count + device_count);
 
     if (dev->props->dirty && mapper_device_ready(dev)
         && dev->local->subscribers) {
@@ -1330,12 +2804,148 @@ int mapper_device_poll(mapper_device dev, int block_ms)
     return admin_count + device_count;
 }
 
+int mapper_device_poll(mapper_device dev, int block_ms)
+{
+    if (!dev || !dev->local)
+        return 0;
+
+    if (dev->local->thread_running) {
+        // messages are handled by the I/O thread; keep the caller's pacing
+        if (block_ms)
+            usleep(block_ms * 1000);
+        return 0;
+    }
+    return poll_device(dev, block_ms);
+}
+
+int mapper_device_set_poll_budget(mapper_device dev, int usec)
+{
+    if (!dev || !dev->local || usec < 0)
+        return -1;
+    dev->local->poll_stats.budget_us = usec;
+    return 0;
+}
+
+int mapper_device_poll_budget(mapper_device dev)
+{
+    if (!dev || !dev->local)
+        return 0;
+    return dev->local->poll_stats.budget_us;
+}
+
+int mapper_device_poll_stats(mapper_device dev, double *msgs_per_poll,
+                             double *usec_per_poll, int *backlog)
+{
+    if (!dev || !dev->local)
+        return -1;
+    if (msgs_per_poll)
+        *msgs_per_poll = dev->local->poll_stats.msgs;
+    if (usec_per_poll)
+        *usec_per_poll = dev->local->poll_stats.usec;
+    if (backlog)
+        *backlog = dev->local->poll_stats.backlog;
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+static void *device_thread_func(void *data)
+{
+    mapper_device dev = (mapper_device)data;
+    mapper_network net = dev->database->network;
+    int timeout;
+
+    lo_server servers[4] = { net->bus_server,
+                             net->mesh_server,
+                             dev->local->udp_server,
+                             dev->local->tcp_server };
+
+    while (__atomic_load_n(&dev->local->thread_running, __ATOMIC_ACQUIRE)) {
+        /* Wait for messages or queued updates without holding the lock, and
+         * wake up periodically for housekeeping.  Connections accepted by
+         * polls are added to the event set, so prefer waiting on that. */
+        timeout = jitter_buffer_wait_ms(dev, 100);
+#ifdef HAVE_SYS_EPOLL_H
+        if (dev->local->epoll_fd >= 0) {
+            struct epoll_event ev;
+            epoll_wait(dev->local->epoll_fd, &ev, 1, timeout);
+        }
+        else
+#endif
+            wait_for_messages(dev, servers, timeout);
+
+        pthread_mutex_lock(&net->lock);
+        poll_device(dev, 0);
+        pthread_mutex_unlock(&net->lock);
+    }
+    return 0;
+}
+#endif
+
+int mapper_device_start_thread(mapper_device dev)
+{
+#ifdef HAVE_PTHREAD
+    if (!dev || !dev->local)
+        return -1;
+    if (dev->local->thread_running)
+        return 0;
+
+    mapper_device_event_fd(dev);
+    dev->local->thread_running = 1;
+    if (pthread_create(&dev->local->thread, 0, device_thread_func, dev)) {
+        trace_dev(dev, "couldn't start I/O thread.\n");
+        dev->local->thread_running = 0;
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void mapper_device_stop_thread(mapper_device dev)
+{
+#ifdef HAVE_PTHREAD
+    if (!dev || !dev->local || !dev->local->thread_running)
+        return;
+
+    __atomic_store_n(&dev->local->thread_running, 0, __ATOMIC_RELEASE);
+    pthread_join(dev->local->thread, 0);
+#endif
+}
+
+void mapper_device_lock(mapper_device dev)
+{
+#ifdef HAVE_PTHREAD
+    if (dev && dev->local)
+        pthread_mutex_lock(&dev->database->network->lock);
+#endif
+}
+
+void mapper_device_unlock(mapper_device dev)
+{
+#ifdef HAVE_PTHREAD
+    if (dev && dev->local)
+        pthread_mutex_unlock(&dev->database->network->lock);
+#endif
+}
+
 int mapper_device_num_fds(mapper_device dev)
 {
     // Two for the admin inputs (bus and mesh), and two for the signal input.
     return 4;
 }
 
+/* The listening descriptor of the TCP server, which liblo no longer polls if
+ * the device accepts connections itself. */
+static int tcp_server_fd(mapper_device dev)
+{
+#ifdef ACCEPT_TCP_CONNECTIONS
+    if (dev->local->tcp)
+        return dev->local->tcp->fd;
+#endif
+    return lo_server_get_socket_fd(dev->local->tcp_server);
+}
+
 int mapper_device_fds(mapper_device dev, int *fds, int num)
 {
     if (!dev || !dev->local)
@@ -1347,7 +2957,7 @@ int mapper_device_fds(mapper_device dev, int *fds, int num)
         if (num > 2) {
             fds[2] = lo_server_get_socket_fd(dev->local->udp_server);
             if (num > 3)
-                fds[3] = lo_server_get_socket_fd(dev->local->tcp_server);
+                fds[3] = tcp_server_fd(dev);
             else
                 return 3;
         }
@@ -1359,6 +2969,90 @@ int mapper_device_fds(mapper_device dev, int *fds, int num)
     return 4;
 }
 
+int mapper_device_event_fd(mapper_device dev)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    int i, num, fds[4];
+
+    if (!dev || !dev->local)
+        return -1;
+    if (dev->local->epoll_fd >= 0)
+        return dev->local->epoll_fd;
+
+    dev->local->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (dev->local->epoll_fd < 0)
+        return -1;
+    num = mapper_device_fds(dev, fds, 4);
+    for (i = 0; i < num; i++) {
+        if (fds[i] >= 0)
+            watch_fd(dev, fds[i]);
+    }
+#ifdef ACCEPT_TCP_CONNECTIONS
+    // connections accepted later are added as they come
+    if (dev->local->tcp) {
+        for (i = 0; i < dev->local->tcp->num_connections; i++)
+            watch_fd(dev, dev->local->tcp->connections[i].fd);
+    }
+#endif
+    if (dev->local->wake_fd >= 0)
+        watch_fd(dev, dev->local->wake_fd);
+    return dev->local->epoll_fd;
+#else
+    return -1;
+#endif
+}
+
+/* Messages on TCP connections accepted by liblo are not covered by the
+ * descriptors returned by mapper_device_fds(), so they must be polled for. */
+static int device_uses_tcp(mapper_device dev)
+{
+    int i;
+    mapper_router_signal rs = dev->local->router->signals;
+    while (rs) {
+        for (i = 0; i < rs->num_slots; i++) {
+            if (rs->slots[i] && rs->slots[i]->map->protocol == MAPPER_PROTO_TCP)
+                return 1;
+        }
+        rs = rs->next;
+    }
+    return 0;
+}
+
+int mapper_device_next_timeout(mapper_device dev)
+{
+    mapper_network net;
+    mapper_timetag_t now;
+    double wait, elapsed;
+
+    if (!dev || !dev->local)
+        return 0;
+    net = dev->database->network;
+
+    // queued administrative messages and property changes are sent on poll
+    if (net->bundle || (dev->props->dirty && dev->local->subscribers))
+        return 0;
+
+    // next clock sync and link housekeeping
+    mapper_timetag_now(&now);
+    wait = net->next_ping - mapper_timetag_double(now);
+
+    if (!dev->local->registered) {
+        elapsed = mapper_network_allocation_wait(net, &dev->local->ordinal);
+        if (elapsed < wait)
+            wait = elapsed;
+    }
+
+    // without a wake descriptor other threads cannot wake us for updates
+    if (dev->local->update_queue && dev->local->wake_fd < 0 && wait > 0.001)
+        wait = 0.001;
+    if (wait > 0.1 && !dev->local->tcp && device_uses_tcp(dev))
+        wait = 0.1;
+
+    if (wait <= 0)
+        return 0;
+    return jitter_buffer_wait_ms(dev, (int)(wait * 1000) + 1);
+}
+
 void mapper_device_service_fd(mapper_device dev, int fd)
 {
     if (!dev || !dev->local)
@@ -1373,8 +3067,14 @@ void mapper_device_service_fd(mapper_device dev, int fd)
         mapper_network_poll(dev->database->network);
     }
     else if (dev->local->udp_server
-             && fd == lo_server_get_socket_fd(dev->local->udp_server))
-        lo_server_recv_noblock(dev->local->udp_server, 0);
+             && fd == lo_server_get_socket_fd(dev->local->udp_server)) {
+        if (!recv_udp_batch(dev))
+            lo_server_recv_noblock(dev->local->udp_server, 0);
+    }
+    else if (fd >= 0 && fd == dev->local->wake_fd)
+        process_queued_updates(dev);
+    else if (dev->local->tcp)
+        recv_tcp(dev);
     else if (dev->local->tcp_server
              && fd == lo_server_get_socket_fd(dev->local->tcp_server))
         lo_server_recv_noblock(dev->local->tcp_server, 0);
@@ -1410,6 +3110,17 @@ void mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt)
     }
 }
 
+int mapper_device_has_queue(mapper_device dev, mapper_timetag_t tt)
+{
+    mapper_link link = dev->database->links;
+    while (link) {
+        if (link->local && mapper_link_has_queue(link, tt))
+            return 1;
+        link = mapper_list_next(link);
+    }
+    return 0;
+}
+
 // Function to send a signal update queue
 void mapper_device_send_queue(mapper_device dev, mapper_timetag_t tt)
 {
@@ -1422,6 +3133,7 @@ void mapper_device_send_queue(mapper_device dev, mapper_timetag_t tt)
             mapper_link_send_queue(link, tt);
         link = mapper_list_next(link);
     }
+    mapper_device_send_batch(dev);
 }
 
 int mapper_device_route_query(mapper_device dev, mapper_signal sig,
@@ -1438,6 +3150,45 @@ void mapper_device_reserve_instance_id_map(mapper_device dev)
     dev->local->reserve_id_maps = map;
 }
 
+/* Rebuild an id map index from the group's active list.  Maps are appended to
+ * their buckets so that lookups return the same map as a walk of the list. */
+static void rehash_id_map_index(mapper_id_map_index index, mapper_id_map list,
+                                int size)
+{
+    mapper_id_map *bucket;
+    index->by_local = realloc(index->by_local, size * sizeof(mapper_id_map));
+    index->by_global = realloc(index->by_global, size * sizeof(mapper_id_map));
+    memset(index->by_local, 0, size * sizeof(mapper_id_map));
+    memset(index->by_global, 0, size * sizeof(mapper_id_map));
+    index->size = size;
+    index->count = 0;
+    while (list) {
+        bucket = &index->by_local[mapper_id_hash(list->local) & (size - 1)];
+        while (*bucket)
+            bucket = &(*bucket)->next_by_local;
+        *bucket = list;
+        list->next_by_local = 0;
+        bucket = &index->by_global[mapper_id_hash(list->global) & (size - 1)];
+        while (*bucket)
+            bucket = &(*bucket)->next_by_global;
+        *bucket = list;
+        list->next_by_global = 0;
+        ++index->count;
+        list = list->next;
+    }
+}
+
+void mapper_device_reindex_instance_id_maps(mapper_device dev)
+{
+    int i;
+    for (i = 0; i < dev->local->num_signal_groups; i++) {
+        mapper_id_map_index index = &dev->local->active_id_map_index[i];
+        if (index->size)
+            rehash_id_map_index(index, dev->local->active_id_maps[i],
+                                index->size);
+    }
+}
+
 mapper_id_map mapper_device_add_instance_id_map(mapper_device dev,
                                                 int group_index,
                                                 mapper_id local_id,
@@ -1454,6 +3205,22 @@ mapper_id_map mapper_device_add_instance_id_map(mapper_device dev,
     dev->local->reserve_id_maps = map->next;
     map->next = dev->local->active_id_maps[group_index];
     dev->local->active_id_maps[group_index] = map;
+
+    mapper_id_map_index index = &dev->local->active_id_map_index[group_index];
+    if (index->count >= index->size) {
+        // grow the index, this also adds the new map
+        rehash_id_map_index(index, map, index->size ? index->size * 2 : 16);
+    }
+    else {
+        // most recent maps are found first, as in the active list
+        int b = mapper_id_hash(local_id) & (index->size - 1);
+        map->next_by_local = index->by_local[b];
+        index->by_local[b] = map;
+        b = mapper_id_hash(global_id) & (index->size - 1);
+        map->next_by_global = index->by_global[b];
+        index->by_global[b] = map;
+        ++index->count;
+    }
     return map;
 }
 
@@ -1462,25 +3229,44 @@ void mapper_device_remove_instance_id_map(mapper_device dev, int group_index,
 {
     mapper_id_map *id_map = &dev->local->active_id_maps[group_index];
     while (*id_map) {
-        if ((*id_map) == map) {
-            *id_map = (*id_map)->next;
-            map->next = dev->local->reserve_id_maps;
-            dev->local->reserve_id_maps = map;
+        if ((*id_map) == map)
             break;
-        }
         id_map = &(*id_map)->next;
     }
+    if (!*id_map)
+        return;
+    *id_map = map->next;
+    map->next = dev->local->reserve_id_maps;
+    dev->local->reserve_id_maps = map;
+
+    // also remove from the hash indexes
+    mapper_id_map_index index = &dev->local->active_id_map_index[group_index];
+    id_map = &index->by_local[mapper_id_hash(map->local) & (index->size - 1)];
+    while (*id_map && *id_map != map)
+        id_map = &(*id_map)->next_by_local;
+    if (*id_map)
+        *id_map = map->next_by_local;
+    id_map = &index->by_global[mapper_id_hash(map->global) & (index->size - 1)];
+    while (*id_map && *id_map != map)
+        id_map = &(*id_map)->next_by_global;
+    if (*id_map)
+        *id_map = map->next_by_global;
+    --index->count;
 }
 
 mapper_id_map mapper_device_find_instance_id_map_by_local(mapper_device dev,
                                                           int group_index,
                                                           mapper_id local_id)
 {
-    mapper_id_map map = dev->local->active_id_maps[group_index];
+    mapper_id_map_index index = &dev->local->active_id_map_index[group_index];
+    if (!index->count)
+        return 0;
+    mapper_id_map map = index->by_local[mapper_id_hash(local_id)
+                                        & (index->size - 1)];
     while (map) {
         if (map->local == local_id)
             return map;
-        map = map->next;
+        map = map->next_by_local;
     }
     return 0;
 }
@@ -1489,11 +3275,15 @@ mapper_id_map mapper_device_find_instance_id_map_by_global(mapper_device dev,
                                                            int group_index,
                                                            mapper_id global_id)
 {
-    mapper_id_map map = dev->local->active_id_maps[group_index];
+    mapper_id_map_index index = &dev->local->active_id_map_index[group_index];
+    if (!index->count)
+        return 0;
+    mapper_id_map map = index->by_global[mapper_id_hash(global_id)
+                                         & (index->size - 1)];
     while (map) {
         if (map->global == global_id)
             return map;
-        map = map->next;
+        map = map->next_by_global;
     }
     return 0;
 }
@@ -1518,8 +3308,7 @@ void mapper_device_start_servers(mapper_device dev, int starting_port)
     if (dev->local->udp_server || dev->local->tcp_server)
         return;
 
-    int len;
-    char port[16], *pport = port, *path = 0;
+    char port[16], *pport = port;
 
     if (starting_port)
         sprintf(port, "%d", starting_port);
@@ -1542,6 +3331,10 @@ void mapper_device_start_servers(mapper_device dev, int starting_port)
     lo_server_enable_queue(dev->local->udp_server, 0, 1);
     lo_server_enable_queue(dev->local->tcp_server, 0, 1);
 
+#ifdef ACCEPT_TCP_CONNECTIONS
+    take_tcp_server(dev);
+#endif
+
     int portnum = lo_server_get_port(dev->local->udp_server);
     mapper_table_set_record(dev->props, AT_PORT, NULL, 1, 'i', &portnum,
                             NON_MODIFIABLE);
@@ -1557,26 +3350,11 @@ void mapper_device_start_servers(mapper_device dev, int starting_port)
     free(url);
     trace_dev(dev, "bound to port %i\n", portnum);
 
-    // add signal methods
-    mapper_signal *sig = mapper_device_signals(dev, MAPPER_DIR_ANY);
-    while (sig) {
-        if ((*sig)->local->update_handler) {
-            lo_server_add_method(dev->local->udp_server, (*sig)->path, NULL,
-                                 handler_signal, (void*)(*sig));
-            lo_server_add_method(dev->local->tcp_server, (*sig)->path, NULL,
-                                 handler_signal, (void*)(*sig));
-        }
-
-        len = (int)strlen((*sig)->path) + 5;
-        path = (char*)realloc(path, len);
-        snprintf(path, len, "%s%s", (*sig)->path, "/get");
-        lo_server_add_method(dev->local->udp_server, path, NULL, handler_query,
-                             (void*)(*sig));
-        lo_server_add_method(dev->local->tcp_server, path, NULL, handler_query,
-                             (void*)(*sig));
-        sig = mapper_signal_query_next(sig);
-    }
-    free(path);
+    // all signal paths are dispatched through the device's signal index
+    lo_server_add_method(dev->local->udp_server, NULL, NULL, handler_device,
+                         (void*)dev);
+    lo_server_add_method(dev->local->tcp_server, NULL, NULL, handler_device,
+                         (void*)dev);
 }
 
 const char *mapper_device_name(mapper_device dev)
@@ -1591,6 +3369,9 @@ const char *mapper_device_name(mapper_device dev)
     dev->name = (char*)malloc(len);
     dev->name[0] = 0;
     snprintf(dev->name, len, "%s.%d", dev->identifier, dev->local->ordinal.value);
+    mapper_hash_index_add(&dev->database->devices_by_name,
+                          mapper_string_hash(dev->name), dev);
+    ++dev->database->devices_version;
     return dev->name;
 }
 
@@ -1628,6 +3409,27 @@ unsigned int mapper_device_port(mapper_device dev)
     return 0;
 }
 
+int mapper_device_set_fast_allocation(mapper_device dev, int enable)
+{
+    if (!dev || !dev->local)
+        return -1;
+    return mapper_network_set_fast_allocation(dev->database->network, dev,
+                                              enable, 0);
+}
+
+int mapper_device_fast_allocation(mapper_device dev)
+{
+    return dev && dev->local ? dev->local->ordinal.fast : 0;
+}
+
+int mapper_device_set_ordinal(mapper_device dev, unsigned int ordinal)
+{
+    if (!dev || !dev->local || !ordinal)
+        return -1;
+    return mapper_network_set_fast_allocation(dev->database->network, dev, 1,
+                                              ordinal);
+}
+
 unsigned int mapper_device_ordinal(mapper_device dev)
 {
     return dev->ordinal;
@@ -1835,7 +3637,10 @@ int mapper_device_set_from_message(mapper_device dev, mapper_message msg)
 {
     if (!msg)
         return 0;
-    return mapper_table_set_from_message(dev->props, msg, REMOTE_MODIFY);
+    mapper_id id = dev->id;
+    int updated = mapper_table_set_from_message(dev->props, msg, REMOTE_MODIFY);
+    mapper_hash_index_rekey(&dev->database->devices_by_id, id, dev->id, dev);
+    return updated;
 }
 
 static int mapper_device_send_signals(mapper_device dev, mapper_direction dir,
@@ -2006,6 +3811,11 @@ mapper_signal_group mapper_device_add_signal_group(mapper_device dev)
                                          dev->local->num_signal_groups
                                          * sizeof(mapper_id_map*));
     dev->local->active_id_maps[dev->local->num_signal_groups-1] = 0;
+    dev->local->active_id_map_index = realloc(dev->local->active_id_map_index,
+                                              dev->local->num_signal_groups
+                                              * sizeof(mapper_id_map_index_t));
+    memset(&dev->local->active_id_map_index[dev->local->num_signal_groups-1], 0,
+           sizeof(mapper_id_map_index_t));
 
     return dev->local->num_signal_groups-1;
 }
@@ -2017,13 +3827,19 @@ void mapper_device_remove_signal_group(mapper_device dev,
         return;
 
     int i = (int)group + 1;
+    free(dev->local->active_id_map_index[group].by_local);
+    free(dev->local->active_id_map_index[group].by_global);
     for (; i < dev->local->num_signal_groups; i++) {
         dev->local->active_id_maps[i-1] = dev->local->active_id_maps[i];
+        dev->local->active_id_map_index[i-1] = dev->local->active_id_map_index[i];
     }
     --dev->local->num_signal_groups;
     dev->local->active_id_maps = realloc(dev->local->active_id_maps,
                                          dev->local->num_signal_groups
                                          * sizeof(mapper_id_map *));
+    dev->local->active_id_map_index = realloc(dev->local->active_id_map_index,
+                                              dev->local->num_signal_groups
+                                              * sizeof(mapper_id_map_index_t));
 }
 
 void mapper_device_print(mapper_device dev)
@@ -1143,6 +1143,8 @@ static int precompute(mapper_token_t *stack, int length, int vector_length)
     void *v = malloc(mapper_type_size(stack[length-1].datatype) * vector_length);
     h.type = stack[length-1].datatype;
     h.value = v;
+    h.timetag = 0;
+    h.sample_generation = 0;
     h.position = -1;
     h.length = vector_length;
     h.size = 1;
@@ -2289,6 +2291,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 dims[top] = tok->vector_length;
                 idx = ((tok->history_index + output->position
                         + output->size) % output->size);
+                mapper_history_touch(output, idx);
                 switch (output->type) {
                 case 'f': {
                     float *v = (output->value + idx * output->length
@@ -2326,6 +2329,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 dims[top] = tok->vector_length;
                 mapper_history h = input[tok->var-VAR_X];
                 idx = ((tok->history_index + h->position + h->size) % h->size);
+                mapper_history_touch(h, idx);
                 switch (h->type) {
                 case 'f': {
                     float *v = (h->value + idx * h->length
@@ -2366,6 +2370,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 mapper_history h = *expr_vars + (tok->var);
                 idx = ((tok->history_index + h->position
                         + var->history_size) % var->history_size);
+                mapper_history_touch(h, idx);
                 double *v = h->value + idx * var->vector_length * mapper_type_size(var->datatype);
                 for (i = 0; i < tok->vector_length; i++)
                     stack[top][i].d = v[i+tok->vector_index];
@@ -2956,6 +2961,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                     idx = output->size - idx;
                 else
                     idx %= output->size;
+                mapper_history_touch(output, idx);
 
                 switch (output->type) {
                 case 'f': {
@@ -3001,12 +3007,14 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 mapper_variable var = &expr->variables[tok->var];
                 int idx = (tok->history_index + h->position
                            + var->history_size) % var->history_size;
+                mapper_history_touch(h, idx);
                 double *v = h->value + idx * var->vector_length * mapper_type_size(var->datatype);
                 for (i = 0; i < tok->vector_length; i++)
                     v[i + tok->vector_index] = stack[top][i + tok->assignment_offset].d;
 
                 // Also copy timetag from input
                 if (tt) {
+                    mapper_history_touch(h, h->position);
                     mapper_timetag_t *ttvar = mapper_history_tt_ptr(*h);
                     memcpy(ttvar, tt, sizeof(mapper_timetag_t));
                 }
@@ -3093,6 +3101,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
 
         /* Increment index position of output data structure. */
         output->position = (output->position + 1) % output->size;
+        mapper_history_touch(output, output->position);
 
         switch (output->type) {
         case 'f': {
@@ -3128,6 +3137,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
     }
     else if (tt) {
         // Also copy timetag from input
+        mapper_history_touch(output, output->position);
         mapper_timetag_t *ttto = mapper_history_tt_ptr(*output);
         memcpy(ttto, tt, sizeof(mapper_timetag_t));
     }
@@ -34,8 +34,11 @@ void mapper_link_init(mapper_link link, int is_local)
     link->local = ((mapper_local_link)
                    calloc(1, sizeof(struct _mapper_local_link)));
 
-    if (!link->id && link->local_device->local)
+    if (!link->id && link->local_device->local) {
         link->id = mapper_device_generate_unique_id(link->local_device);
+        mapper_hash_index_rekey(&link->local_device->database->links_by_id, 0,
+                                link->id, link);
+    }
 
     if (link->local_device == link->remote_device) {
         /* Add data_addr for use by self-connections. In the future we may
@@ -82,6 +85,10 @@ void mapper_link_connect(mapper_link link, const char *host, int admin_port,
     mapper_table_set_record(link->remote_device->props, AT_PORT, NULL, 1, 'i',
                             &data_port, REMOTE_MODIFY);
     sprintf(str, "%d", data_port);
+    if (link->local->udp_sockaddr) {
+        free(link->local->udp_sockaddr);
+        link->local->udp_sockaddr = 0;
+    }
     link->local->udp_data_addr = lo_address_new(host, str);
     link->local->tcp_data_addr = lo_address_new_with_proto(LO_TCP, host, str);
     sprintf(str, "%d", admin_port);
@@ -103,6 +110,8 @@ void mapper_link_free(mapper_link link)
             lo_address_free(link->local->udp_data_addr);
         if (link->local->tcp_data_addr)
             lo_address_free(link->local->tcp_data_addr);
+        if (link->local->udp_sockaddr)
+            free(link->local->udp_sockaddr);
         while (link->local->queues) {
             mapper_queue queue = link->local->queues;
             lo_bundle_free_recursive(queue->udp_bundle);
@@ -115,19 +124,28 @@ void mapper_link_free(mapper_link link)
     }
 }
 
-void mapper_link_start_queue(mapper_link link, mapper_timetag_t tt)
+int mapper_link_has_queue(mapper_link link, mapper_timetag_t tt)
 {
     if (!link || !link->local)
-        return;
-    // check if queue already exists
+        return 0;
     mapper_queue queue = link->local->queues;
     while (queue) {
         if (memcmp(&queue->tt, &tt, sizeof(mapper_timetag_t))==0)
-            return;
+            return 1;
         queue = queue->next;
     }
+    return 0;
+}
+
+void mapper_link_start_queue(mapper_link link, mapper_timetag_t tt)
+{
+    if (!link || !link->local)
+        return;
+    // check if queue already exists
+    if (mapper_link_has_queue(link, tt))
+        return;
     // need to create a new queue
-    queue = malloc(sizeof(struct _mapper_queue));
+    mapper_queue queue = malloc(sizeof(struct _mapper_queue));
     memcpy(&queue->tt, &tt, sizeof(mapper_timetag_t));
     queue->udp_bundle = lo_bundle_new(tt);
     queue->tcp_bundle = lo_bundle_new(tt);
@@ -149,9 +167,11 @@ void mapper_link_send_queue(mapper_link link, mapper_timetag_t tt)
 #ifdef HAVE_LIBLO_BUNDLE_COUNT
         if (lo_bundle_count((*queue)->udp_bundle))
 #endif
-            lo_send_bundle_from(link->local->udp_data_addr,
-                                link->local_device->local->udp_server,
-                                (*queue)->udp_bundle);
+            if (mapper_device_batch_bundle(link->local_device, link,
+                                           (*queue)->udp_bundle))
+                lo_send_bundle_from(link->local->udp_data_addr,
+                                    link->local_device->local->udp_server,
+                                    (*queue)->udp_bundle);
         lo_bundle_free_recursive((*queue)->udp_bundle);
 #ifdef HAVE_LIBLO_BUNDLE_COUNT
         if (lo_bundle_count((*queue)->tcp_bundle))
@@ -267,9 +287,12 @@ int mapper_link_set_from_message(mapper_link link, mapper_message msg,
         if (msg->atoms[i].index == AT_ID) {
             // choose lowest id
             if (!link->id || link->id > (*msg->atoms[i].values)->h) {
-                mapper_id id = msg->atoms[i].values[0]->h;
+                mapper_id id = msg->atoms[i].values[0]->h, old_id = link->id;
+                mapper_database db = link->local_device->database;
                 mapper_table_set_record(link->props, AT_ID, NULL, 1, 'h', &id,
                                         LOCAL_MODIFY);
+                mapper_hash_index_rekey(&db->links_by_id, old_id, link->id,
+                                        link);
                 ++updated;
             }
         }
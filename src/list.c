@@ -62,14 +62,107 @@ typedef struct _query_info {
     unsigned int size;
     query_compare_func_t *query_compare;
     query_free_func_t *query_free;
+    void **items;       // precomputed results, or 0 for lazy evaluation
+    int num_items;
+    int item_index;
     int data[0]; // stub
 } query_info_t;
 
 #define LIST_HEADER_SIZE (sizeof(mapper_list_header_t)-sizeof(int[1]))
 
+/**** Memory pools ****/
+
+/* Every block handed out by a pool is preceded by this prefix, so that it can
+ * be released without knowing its size, and so that queries can find the pool
+ * of the list they are evaluating. */
+typedef struct {
+    mapper_pool pool;
+    int size_class;         // -1 for blocks too large to come from a slab
+} pool_block_t;
+
+#define POOL_BLOCK_PREFIX ((sizeof(pool_block_t) + 15) & ~15)
+#define POOL_SLAB_HEADER ((sizeof(struct _mapper_slab) + 15) & ~15)
+
+static int add_slab(mapper_pool pool, int size_class)
+{
+    int i, block_size = (size_class + 1) * POOL_GRANULARITY;
+    int num_blocks = (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / block_size;
+    mapper_slab slab = malloc(POOL_SLAB_SIZE);
+    if (!slab)
+        return 0;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    ++pool->num_mallocs;
+
+    char *block = (char*)slab + POOL_SLAB_HEADER;
+    for (i = 0; i < num_blocks; i++, block += block_size) {
+        *(void**)block = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = block;
+    }
+    return 1;
+}
+
+void *mapper_pool_alloc(mapper_pool pool, size_t size)
+{
+    pool_block_t *block;
+    int size_class = (size + POOL_BLOCK_PREFIX - 1) / POOL_GRANULARITY;
+    if (!pool || size_class >= POOL_NUM_CLASSES) {
+        if (!(block = malloc(size + POOL_BLOCK_PREFIX)))
+            return 0;
+        size_class = -1;
+        if (pool)
+            ++pool->num_mallocs;
+    }
+    else {
+        if (!pool->free_blocks[size_class] && !add_slab(pool, size_class))
+            return 0;
+        block = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = *(void**)block;
+    }
+    if (pool)
+        ++pool->num_allocs;
+    block->pool = pool;
+    block->size_class = size_class;
+    void *mem = (char*)block + POOL_BLOCK_PREFIX;
+    memset(mem, 0, size);
+    return mem;
+}
+
+/*! Get the pool a block was allocated from. */
+static mapper_pool mapper_pool_of(void *mem)
+{
+    return ((pool_block_t*)((char*)mem - POOL_BLOCK_PREFIX))->pool;
+}
+
+void mapper_pool_release(void *mem)
+{
+    if (!mem)
+        return;
+    pool_block_t *block = (pool_block_t*)((char*)mem - POOL_BLOCK_PREFIX);
+    mapper_pool pool = block->pool;
+    int size_class = block->size_class;
+    if (size_class < 0) {
+        free(block);
+        return;
+    }
+    *(void**)block = pool->free_blocks[size_class];
+    pool->free_blocks[size_class] = block;
+}
+
+void mapper_pool_free(mapper_pool pool)
+{
+    mapper_slab slab;
+    while ((slab = pool->slabs)) {
+        pool->slabs = slab->next;
+        free(slab);
+    }
+    memset(pool, 0, sizeof(mapper_pool_t));
+}
+
 /*! Reserve memory for a list item.  Reserves an extra pointer at the
  *  beginning of the structure to allow for a list pointer. */
-static mapper_list_header_t* mapper_list_new_item(size_t size)
+static mapper_list_header_t* mapper_list_new_item(size_t size,
+                                                  mapper_pool pool)
 {
     mapper_list_header_t *lh=0;
 
@@ -81,7 +174,7 @@ static mapper_list_header_t* mapper_list_new_item(size_t size)
                "unexpected offset for data in mapper_list_header_t");
 
     size += LIST_HEADER_SIZE;
-    lh = calloc(1, size);
+    lh = mapper_pool_alloc(pool, size);
     if (!lh)
         return 0;
 
@@ -133,9 +226,9 @@ static void *mapper_list_prepend_item(void *item, void **list)
     return item;
 }
 
-void *mapper_list_add_item(void **list, size_t size)
+void *mapper_list_add_item(void **list, size_t size, mapper_pool pool)
 {
-    mapper_list_header_t* lh = mapper_list_new_item(size);
+    mapper_list_header_t* lh = mapper_list_new_item(size, pool);
     mapper_list_prepend_item(lh, list);
     return lh;
 }
@@ -164,7 +257,7 @@ void mapper_list_remove_item(void **head, void *item)
 void mapper_list_free_item(void *item)
 {
     if (item)
-        free(mapper_list_header_by_data(item));
+        mapper_pool_release(mapper_list_header_by_data(item));
 }
 
 /** Structures and functions for performing dynamic queries **/
@@ -193,6 +286,21 @@ void **mapper_list_query_continuation(mapper_list_header_t *lh)
     return 0;
 }
 
+/*! Continuation for queries over an array of precomputed results. */
+static void **mapper_list_query_array_continuation(mapper_list_header_t *lh)
+{
+    query_info_t *c = lh->query_context;
+    if (c->item_index < c->num_items) {
+        lh->self = c->items[c->item_index++];
+        return &lh->self;
+    }
+
+    // Clean up
+    if (c->query_free)
+        c->query_free(lh);
+    return 0;
+}
+
 static void free_query_single_context(mapper_list_header_t *lh)
 {
     if (lh->query_context->query_compare == cmp_compound_query) {
@@ -203,24 +311,24 @@ static void free_query_single_context(mapper_list_header_t *lh)
         free_query_single_context(lh1);
         free_query_single_context(lh2);
     }
-    free(lh->query_context);
-    free(lh);
+    if (lh->query_context->items)
+        mapper_pool_release(lh->query_context->items);
+    mapper_pool_release(lh->query_context);
+    mapper_pool_release(lh);
 }
 
-/* We need to be careful of memory alignment here - for now we will just ensure
- * that string arguments are always passed last. */
-void **mapper_list_new_query(const void *list, const void *compare_func,
-                             const char *types, ...)
+static mapper_list_header_t *new_query_header(const void *list,
+                                              const void *compare_func,
+                                              const char *types, va_list args)
 {
-    if (!list || !compare_func || !types)
-        return 0;
-
-    mapper_list_header_t *lh = (mapper_list_header_t*)malloc(LIST_HEADER_SIZE);
+    // queries are allocated from the pool of the list they are evaluating
+    mapper_pool pool = mapper_pool_of(mapper_list_header_by_data(list));
+    mapper_list_header_t *lh = mapper_pool_alloc(pool, LIST_HEADER_SIZE);
     lh->next = mapper_list_query_continuation;
     lh->query_type = QUERY_DYNAMIC;
 
     va_list aq;
-    va_start(aq, types);
+    va_copy(aq, args);
 
     int i = 0, j, size = 0, num_args;
     while (types[i]) {
@@ -278,18 +386,18 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
                 break;
             default:
                 va_end(aq);
-                free(lh);
+                mapper_pool_release(lh);
                 return 0;
         }
         i++;
     };
     va_end(aq);
 
-    lh->query_context = (query_info_t*)malloc(sizeof(query_info_t)+size);
+    lh->query_context = mapper_pool_alloc(pool, sizeof(query_info_t)+size);
 
     char *d = (char*)&lh->query_context->data;
     int offset = 0;
-    va_start(aq, types);
+    va_copy(aq, args);
     i = 0;
     while (types[i]) {
         switch (types[i]) {
@@ -358,8 +466,8 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
             }
             default:
                 va_end(aq);
-                free(lh->query_context);
-                free(lh);
+                mapper_pool_release(lh->query_context);
+                mapper_pool_release(lh);
                 return 0;
         }
         i++;
@@ -369,8 +477,27 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
     lh->query_context->size = sizeof(query_info_t)+size;
     lh->query_context->query_compare = (query_compare_func_t*)compare_func;
     lh->query_context->query_free = (query_free_func_t*)free_query_single_context;
+    lh->query_context->items = 0;
+    lh->query_context->num_items = lh->query_context->item_index = 0;
 
     lh->self = lh->start = (void*)list;
+    return lh;
+}
+
+/* We need to be careful of memory alignment here - for now we will just ensure
+ * that string arguments are always passed last. */
+void **mapper_list_new_query(const void *list, const void *compare_func,
+                             const char *types, ...)
+{
+    if (!list || !compare_func || !types)
+        return 0;
+
+    va_list aq;
+    va_start(aq, types);
+    mapper_list_header_t *lh = new_query_header(list, compare_func, types, aq);
+    va_end(aq);
+    if (!lh)
+        return 0;
 
     // try evaluating the first item
     if (lh->query_context->query_compare(&lh->query_context->data, list))
@@ -379,6 +506,53 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
     return mapper_list_query_continuation(lh);
 }
 
+/*! Set the results of a query to a copy of the given array. */
+static void **set_query_items(mapper_list_header_t *lh, void **items,
+                              int num_items)
+{
+    query_info_t *c = lh->query_context;
+    if (num_items <= 0) {
+        c->query_free(lh);
+        return 0;
+    }
+    c->items = mapper_pool_alloc(mapper_pool_of(lh),
+                                 sizeof(void*) * num_items);
+    memcpy(c->items, items, sizeof(void*) * num_items);
+    c->num_items = num_items;
+    c->item_index = 1;
+    lh->next = mapper_list_query_array_continuation;
+    lh->self = c->items[0];
+    return &lh->self;
+}
+
+void **mapper_list_new_array_query(const void *list, void **items,
+                                   int num_items, const void *compare_func,
+                                   const char *types, ...)
+{
+    if (!list || !compare_func || !types || num_items <= 0)
+        return 0;
+
+    va_list aq;
+    va_start(aq, types);
+    mapper_list_header_t *lh = new_query_header(list, compare_func, types, aq);
+    va_end(aq);
+    if (!lh)
+        return 0;
+    return set_query_items(lh, items, num_items);
+}
+
+int mapper_list_query_items(void **query, void ***items)
+{
+    if (!query || !*query)
+        return -1;
+    mapper_list_header_t *lh = mapper_list_header_by_self(query);
+    if (lh->query_type != QUERY_DYNAMIC || !lh->query_context->items)
+        return -1;
+    if (items)
+        *items = lh->query_context->items;
+    return lh->query_context->num_items;
+}
+
 void **mapper_list_query_next(void **query)
 {
     if (!query) {
@@ -426,6 +600,11 @@ void *mapper_list_query_index(void **query, int index)
 
     mapper_list_header_t *lh = mapper_list_header_by_self(query);
 
+    if (lh->query_type == QUERY_DYNAMIC && lh->query_context->items) {
+        query_info_t *c = lh->query_context;
+        return index < c->num_items ? c->items[index] : 0;
+    }
+
     if (index == 0)
         return lh->start;
 
@@ -467,15 +646,22 @@ static int cmp_compound_query(const void *context_data, const void *dev)
 
 static mapper_list_header_t *mapper_list_header_copy(mapper_list_header_t *lh)
 {
-    mapper_list_header_t *copy = (mapper_list_header_t*)malloc(LIST_HEADER_SIZE);
+    mapper_pool pool = mapper_pool_of(lh);
+    mapper_list_header_t *copy = mapper_pool_alloc(pool, LIST_HEADER_SIZE);
     memcpy(copy, lh, LIST_HEADER_SIZE);
 
     if (!lh->query_context)
         return copy;
 
-    copy->query_context = (query_info_t*)malloc(lh->query_context->size);
+    copy->query_context = mapper_pool_alloc(pool, lh->query_context->size);
     memcpy(copy->query_context, lh->query_context, lh->query_context->size);
 
+    if (copy->query_context->items) {
+        size_t size = sizeof(void*) * copy->query_context->num_items;
+        copy->query_context->items = mapper_pool_alloc(pool, size);
+        memcpy(copy->query_context->items, lh->query_context->items, size);
+    }
+
     if (copy->query_context->query_compare == cmp_compound_query) {
         // this is a compound query – we need to copy components
         void *data = &copy->query_context->data;
@@ -501,6 +687,62 @@ void **mapper_list_query_copy(void **query)
     return &copy->self;
 }
 
+static int compare_pointers(const void *l, const void *r)
+{
+    const void *a = *(const void**)l, *b = *(const void**)r;
+    return a < b ? -1 : a > b;
+}
+
+/*! Combine two queries.  If both already hold their results in arrays the
+ *  combination is computed from the arrays rather than by re-evaluating both
+ *  compare functions against every item of the list. */
+static void **compound_query(mapper_list_header_t *lh1,
+                             mapper_list_header_t *lh2, binary_op_t op)
+{
+    query_info_t *c1 = lh1->query_context, *c2 = lh2->query_context;
+    if (   lh1->query_type != QUERY_DYNAMIC || !c1->items
+        || lh2->query_type != QUERY_DYNAMIC || !c2->items)
+        return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi",
+                                     &lh1, &lh2, op);
+
+    int i, num_items = 0, size = sizeof(void*) * c2->num_items;
+    void **sorted = malloc(size);
+    void **items = malloc(sizeof(void*) * (c1->num_items + c2->num_items));
+    memcpy(sorted, c2->items, size);
+    qsort(sorted, c2->num_items, sizeof(void*), compare_pointers);
+
+    for (i = 0; i < c1->num_items; i++) {
+        int found = bsearch(&c1->items[i], sorted, c2->num_items,
+                            sizeof(void*), compare_pointers) != 0;
+        if (found ? op != OP_DIFFERENCE : op != OP_INTERSECTION)
+            items[num_items++] = c1->items[i];
+    }
+    if (op == OP_UNION) {
+        free(sorted);
+        size = sizeof(void*) * c1->num_items;
+        sorted = malloc(size);
+        memcpy(sorted, c1->items, size);
+        qsort(sorted, c1->num_items, sizeof(void*), compare_pointers);
+        for (i = 0; i < c2->num_items; i++) {
+            if (!bsearch(&c2->items[i], sorted, c1->num_items, sizeof(void*),
+                         compare_pointers))
+                items[num_items++] = c2->items[i];
+        }
+    }
+    free(sorted);
+
+    void **query = mapper_list_new_array_query(lh1->start, items, num_items,
+                                               cmp_compound_query, "vvi",
+                                               &lh1, &lh2, op);
+    if (!query) {
+        // an empty result does not take ownership of the operands
+        free_query_single_context(lh1);
+        free_query_single_context(lh2);
+    }
+    free(items);
+    return query;
+}
+
 void **mapper_list_query_union(void **query1, void **query2)
 {
     if (!query1)
@@ -510,8 +752,7 @@ void **mapper_list_query_union(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_UNION);
+    return compound_query(lh1, lh2, OP_UNION);
 }
 
 void **mapper_list_query_intersection(void **query1, void **query2)
@@ -521,8 +762,7 @@ void **mapper_list_query_intersection(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_INTERSECTION);
+    return compound_query(lh1, lh2, OP_INTERSECTION);
 }
 
 void **mapper_list_query_difference(void **query1, void **query2)
@@ -534,6 +774,182 @@ void **mapper_list_query_difference(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_DIFFERENCE);
+    return compound_query(lh1, lh2, OP_DIFFERENCE);
+}
+
+/**** Hash indexes ****/
+
+static void resize_hash_index(mapper_hash_index index, int size)
+{
+    int i, b;
+    mapper_hash_entry entry, next;
+    mapper_hash_entry *buckets = calloc(size, sizeof(mapper_hash_entry));
+    for (i = 0; i < index->size; i++) {
+        for (entry = index->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            b = mapper_id_hash(entry->key) & (size - 1);
+            entry->next = buckets[b];
+            buckets[b] = entry;
+        }
+    }
+    free(index->buckets);
+    index->buckets = buckets;
+    index->size = size;
+}
+
+void mapper_hash_index_add(mapper_hash_index index, uint64_t key, void *item)
+{
+    if (index->count >= index->size)
+        resize_hash_index(index, index->size ? index->size * 2 : 16);
+    mapper_hash_entry entry = malloc(sizeof(struct _mapper_hash_entry));
+    int b = mapper_id_hash(key) & (index->size - 1);
+    entry->key = key;
+    entry->item = item;
+    entry->next = index->buckets[b];
+    index->buckets[b] = entry;
+    ++index->count;
+}
+
+void mapper_hash_index_remove(mapper_hash_index index, uint64_t key,
+                              void *item)
+{
+    if (!index->size)
+        return;
+    mapper_hash_entry *entry;
+    entry = &index->buckets[mapper_id_hash(key) & (index->size - 1)];
+    while (*entry) {
+        if ((*entry)->key == key && (*entry)->item == item) {
+            mapper_hash_entry temp = *entry;
+            *entry = temp->next;
+            free(temp);
+            --index->count;
+            return;
+        }
+        entry = &(*entry)->next;
+    }
+}
+
+void mapper_hash_index_rekey(mapper_hash_index index, uint64_t old_key,
+                             uint64_t new_key, void *item)
+{
+    if (old_key == new_key)
+        return;
+    mapper_hash_index_remove(index, old_key, item);
+    mapper_hash_index_add(index, new_key, item);
+}
+
+void *mapper_hash_index_find(mapper_hash_index index, uint64_t key,
+                             void *prev)
+{
+    if (!index->size)
+        return 0;
+    mapper_hash_entry entry;
+    entry = index->buckets[mapper_id_hash(key) & (index->size - 1)];
+    if (prev) {
+        while (entry && (entry->key != key || entry->item != prev))
+            entry = entry->next;
+        if (!entry)
+            return 0;
+        entry = entry->next;
+    }
+    while (entry && entry->key != key)
+        entry = entry->next;
+    return entry ? entry->item : 0;
+}
+
+void mapper_hash_index_free(mapper_hash_index index)
+{
+    int i;
+    mapper_hash_entry entry;
+    for (i = 0; i < index->size; i++) {
+        while ((entry = index->buckets[i])) {
+            index->buckets[i] = entry->next;
+            free(entry);
+        }
+    }
+    free(index->buckets);
+    memset(index, 0, sizeof(mapper_hash_index_t));
+}
+
+/**** Timer heaps ****/
+
+static void timer_heap_place(mapper_timer_heap heap, mapper_timer timer,
+                             int pos)
+{
+    heap->timers[pos] = timer;
+    timer->slot = pos + 1;
+}
+
+static void timer_heap_sift(mapper_timer_heap heap, int pos)
+{
+    mapper_timer *timers = heap->timers, timer = timers[pos];
+    int child;
+
+    // move up past later parents
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (timers[parent]->deadline <= timer->deadline)
+            break;
+        timer_heap_place(heap, timers[parent], pos);
+        pos = parent;
+    }
+
+    // or down past earlier children
+    while ((child = pos * 2 + 1) < heap->size) {
+        if (child + 1 < heap->size
+            && timers[child + 1]->deadline < timers[child]->deadline)
+            ++child;
+        if (timers[child]->deadline >= timer->deadline)
+            break;
+        timer_heap_place(heap, timers[child], pos);
+        pos = child;
+    }
+    timer_heap_place(heap, timer, pos);
+}
+
+void mapper_timer_heap_set(mapper_timer_heap heap, mapper_timer timer,
+                           void *item, uint32_t deadline)
+{
+    timer->item = item;
+    timer->deadline = deadline;
+    if (!timer->slot) {
+        if (heap->size >= heap->alloced) {
+            int alloced = heap->alloced ? heap->alloced * 2 : 16;
+            mapper_timer *timers = realloc(heap->timers,
+                                           sizeof(mapper_timer) * alloced);
+            if (!timers)
+                return;
+            heap->timers = timers;
+            heap->alloced = alloced;
+        }
+        timer_heap_place(heap, timer, heap->size++);
+    }
+    timer_heap_sift(heap, timer->slot - 1);
+}
+
+void mapper_timer_heap_remove(mapper_timer_heap heap, mapper_timer timer)
+{
+    int pos = timer->slot - 1;
+    if (pos < 0 || pos >= heap->size || heap->timers[pos] != timer)
+        return;
+    timer->slot = 0;
+    if (--heap->size > pos) {
+        timer_heap_place(heap, heap->timers[heap->size], pos);
+        timer_heap_sift(heap, pos);
+    }
+}
+
+void *mapper_timer_heap_expired(mapper_timer_heap heap, uint32_t time_sec)
+{
+    if (!heap->size || heap->timers[0]->deadline > time_sec)
+        return 0;
+    mapper_timer timer = heap->timers[0];
+    mapper_timer_heap_remove(heap, timer);
+    return timer->item;
+}
+
+void mapper_timer_heap_free(mapper_timer_heap heap)
+{
+    free(heap->timers);
+    memset(heap, 0, sizeof(mapper_timer_heap_t));
 }
@@ -154,7 +154,7 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
     }
 
     map = (mapper_map)mapper_list_add_item((void**)&db->maps,
-                                           sizeof(mapper_map_t));
+                                           sizeof(mapper_map_t), &db->pool);
     map->database = db;
     map->num_sources = num_sources;
     map->sources = (mapper_slot*) malloc(sizeof(mapper_slot) * num_sources);
@@ -166,9 +166,14 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
             if (!sig->id) {
                 sig->id = sources[order[i]]->id;
                 sig->direction = sources[order[i]]->direction;
+                mapper_device_reindex_signal_id(sig->device, sig, 0);
+                ++db->signals_version;
             }
             if (!sig->device->id) {
                 sig->device->id = sources[order[i]]->device->id;
+                mapper_hash_index_rekey(&db->devices_by_id, 0, sig->device->id,
+                                        sig->device);
+                ++db->devices_version;
             }
         }
         map->sources[i]->signal = sig;
@@ -182,6 +187,7 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
     // we need to give the map a temporary id – this may be overwritten later
     if (destination->device->local)
         map->id = mapper_device_generate_unique_id(destination->device);
+    mapper_hash_index_add(&db->maps_by_id, map->id, map);
 
     mapper_map_init(map);
 
@@ -747,6 +753,7 @@ int mapper_map_perform(mapper_map map, mapper_slot slot, int instance,
     }
     else if (map->process_location == MAPPER_LOC_DESTINATION) {
         to[instance].position = 0;
+        mapper_history_touch(&to[instance], 0);
         // copy value without type coercion
         memcpy(mapper_history_value_ptr(to[instance]),
                mapper_history_value_ptr(from[instance]),
@@ -989,14 +996,17 @@ lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
             lo_message_add_nil(msg);
     }
 
+    // messages sent to an aliased path use the short property keys
+    int alias = map->local && map->local->alias;
+
     if (id_map) {
-        lo_message_add_string(msg, "@instance");
+        lo_message_add_string(msg, alias ? ALIAS_INSTANCE_KEY : "@instance");
         lo_message_add_int64(msg, id_map->global);
     }
 
     if (map->process_location == MAPPER_LOC_DESTINATION) {
         // add slot
-        lo_message_add_string(msg, "@slot");
+        lo_message_add_string(msg, alias ? ALIAS_SLOT_KEY : "@slot");
         lo_message_add_int32(msg, slot->id);
     }
 
@@ -1276,6 +1286,8 @@ static void init_slot_history(mapper_slot slot)
         slot->local->history[i].value = calloc(1, mapper_type_size(slot->signal->type)
                                                * slot->signal->length);
         slot->local->history[i].timetag = calloc(1, sizeof(mapper_timetag_t));
+        slot->local->history[i].sample_generation = calloc(1, sizeof(unsigned int));
+        slot->local->history[i].generation = 0;
         slot->local->history[i].position = -1;
     }
 }
@@ -1448,6 +1460,7 @@ static int mapper_map_check_status(mapper_map map)
 int mapper_map_set_from_message(mapper_map map, mapper_message msg, int override)
 {
     int i, j, updated = 0;
+    mapper_id id = map->id;
     mapper_message_atom atom;
     if (!msg) {
         if (map->local && map->status < STATUS_READY) {
@@ -1604,6 +1617,17 @@ int mapper_map_set_from_message(mapper_map map, mapper_message msg, int override
                                                    'i', &pro, REMOTE_MODIFY);
                 break;
             }
+            case AT_ALIAS:
+                // only used by the sources of a map with a remote destination
+                if (!map->local
+                    || map->destination.direction != MAPPER_DIR_OUTGOING
+                    || atom->types[0] != 'i' || (atom->values[0])->i32 < 0)
+                    break;
+                // an alias of 0 withdraws it, falling back to the full path
+                map->local->alias = (atom->values[0])->i32;
+                snprintf(map->local->alias_path, 16, "%s%d", ALIAS_PREFIX,
+                         map->local->alias);
+                break;
             case AT_EXTRA:
                 if (!atom->key)
                     break;
@@ -1627,6 +1651,7 @@ int mapper_map_set_from_message(mapper_map map, mapper_message msg, int override
         else if (updated)
             apply_mode(map);
     }
+    mapper_hash_index_rekey(&map->database->maps_by_id, id, map->id, map);
     return updated;
 }
 
@@ -1690,6 +1715,10 @@ void reallocate_map_histories(mapper_map map)
                 map->local->expr_vars[i][j].length = 0;
                 map->local->expr_vars[i][j].size = 0;
                 map->local->expr_vars[i][j].position = -1;
+                map->local->expr_vars[i][j].value = 0;
+                map->local->expr_vars[i][j].timetag = 0;
+                map->local->expr_vars[i][j].sample_generation = 0;
+                map->local->expr_vars[i][j].generation = 0;
             }
             for (j = 0; j < new_num_vars; j++) {
                 int history_size = mapper_expr_variable_history_size(map->local->expr, j);
@@ -1713,10 +1742,20 @@ void mhist_realloc(mapper_history history,
                    int sample_size,
                    int is_input)
 {
+    int i;
     if (!history || !history_size || !sample_size)
         return;
     if (history_size == history->size)
         return;
+    if (history->sample_generation) {
+        // samples are about to be moved around, so clear stale ones first
+        for (i = 0; i < history->size; i++) {
+            if (history->sample_generation[i] != history->generation) {
+                memset(history->value + sample_size * i, 0, sample_size);
+                memset(&history->timetag[i], 0, sizeof(mapper_timetag_t));
+            }
+        }
+    }
     if (!is_input || (history_size > history->size) || (history->position == 0)) {
         // realloc in place
         history->value = realloc(history->value, history_size * sample_size);
@@ -1790,6 +1829,32 @@ void mhist_realloc(mapper_history history,
         }
     }
     history->size = history_size;
+
+    // all remaining samples are now current
+    history->sample_generation = realloc(history->sample_generation,
+                                         history_size * sizeof(unsigned int));
+    for (i = 0; i < history_size; i++)
+        history->sample_generation[i] = history->generation;
+}
+
+void mhist_reset(mapper_history history)
+{
+    history->position = -1;
+    if (history->sample_generation) {
+        ++history->generation;
+        return;
+    }
+    memset(history->value, 0, history->size * history->length
+           * mapper_type_size(history->type));
+    memset(history->timetag, 0, history->size * sizeof(mapper_timetag_t));
+}
+
+void mhist_clear_stale(mapper_history history, int index)
+{
+    size_t sample_size = history->length * mapper_type_size(history->type);
+    memset(history->value + sample_size * index, 0, sample_size);
+    memset(&history->timetag[index], 0, sizeof(mapper_timetag_t));
+    history->sample_generation[index] = history->generation;
 }
 
 /* If the "slot_index" argument is >= 0, we can assume this message will be sent
@@ -1852,6 +1917,16 @@ int mapper_map_send_state(mapper_map map, int slot, network_message_t cmd)
         return i-1;
     }
 
+    /* Offer the sources a short alias for the destination signal path, to be
+     * used when sending updates, or 0 if none could be assigned. */
+    if ((cmd == MSG_MAP_TO || cmd == MSG_MAPPED) && map->local
+        && map->destination.direction == MAPPER_DIR_INCOMING) {
+        int alias = mapper_device_signal_alias(map->destination.signal->device,
+                                               map->destination.signal);
+        lo_message_add_string(msg, mapper_property_protocol_string(AT_ALIAS));
+        lo_message_add_int32(msg, alias);
+    }
+
     // add other properties
     int staged = (cmd == MSG_MAP) || (cmd == MSG_MAP_MODIFY);
     mapper_table_add_to_message(0, staged ? map->staged_props : map->props, msg);
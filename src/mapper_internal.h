@@ -41,6 +41,14 @@ void mapper_network_add_device(mapper_network net, mapper_device dev);
 
 void mapper_network_remove_device(mapper_network net, mapper_device dev);
 
+void mapper_network_probe_device_name(mapper_network net, mapper_device dev);
+
+int mapper_network_set_fast_allocation(mapper_network net, mapper_device dev,
+                                       int enable, unsigned int ordinal);
+
+double mapper_network_allocation_wait(mapper_network net,
+                                      mapper_allocated resource);
+
 void mapper_network_poll(mapper_network net);
 
 int mapper_network_init(mapper_network net);
@@ -68,6 +76,8 @@ void mapper_device_add_signal_methods(mapper_device dev, mapper_signal sig);
 
 void mapper_device_remove_signal_methods(mapper_device dev, mapper_signal sig);
 
+int mapper_device_signal_alias(mapper_device dev, mapper_signal sig);
+
 void mapper_device_num_instances_changed(mapper_device dev, mapper_signal sig,
                                          int size);
 
@@ -78,10 +88,24 @@ void mapper_device_route_signal(mapper_device dev, mapper_signal sig,
 int mapper_device_route_query(mapper_device dev, mapper_signal sig,
                               mapper_timetag_t tt);
 
+int mapper_device_has_queue(mapper_device dev, mapper_timetag_t tt);
+
 void mapper_device_release_scope(mapper_device dev, const char *scope);
 
 void mapper_device_start_servers(mapper_device dev, int port);
 
+void mapper_device_flush_jitter_buffer(mapper_device dev, mapper_signal sig,
+                                       int deliver);
+
+int mapper_device_batch_bundle(mapper_device dev, mapper_link link,
+                               lo_bundle bundle);
+
+void mapper_device_send_batch(mapper_device dev);
+
+int mapper_device_queue_update(mapper_device dev, mapper_signal sig, int type,
+                               mapper_id id, const void *value, int count,
+                               mapper_timetag_t tt);
+
 void mapper_device_on_id_and_ordinal(mapper_device dev,
                                      mapper_allocated_t *resource);
 
@@ -101,6 +125,20 @@ mapper_id_map mapper_device_find_instance_id_map_by_global(mapper_device dev,
                                                            int group_index,
                                                            mapper_id global_id);
 
+/*! Rebuild the hash indexes of active id maps, e.g. after their ids changed. */
+void mapper_device_reindex_instance_id_maps(mapper_device dev);
+
+/*! Add a signal to the name and id indexes of its device. */
+void mapper_device_index_signal(mapper_device dev, mapper_signal sig);
+
+void mapper_device_unindex_signal(mapper_device dev, mapper_signal sig);
+
+/*! Move a signal to the id bucket for its current id. */
+void mapper_device_reindex_signal_id(mapper_device dev, mapper_signal sig,
+                                     mapper_id old_id);
+
+void mapper_device_free_signal_index(mapper_device dev);
+
 const char *mapper_device_name(mapper_device dev);
 
 void mapper_device_send_state(mapper_device dev, network_message_t cmd);
@@ -144,6 +182,9 @@ mapper_map mapper_router_incoming_map(mapper_router router,
 mapper_map mapper_router_map_by_id(mapper_router router, mapper_signal local_sig,
                                    mapper_id id, mapper_direction dir);
 
+mapper_link mapper_router_incoming_link(mapper_router router,
+                                       mapper_signal signal);
+
 mapper_slot mapper_router_slot(mapper_router router, mapper_signal signal,
                                int slot_number);
 
@@ -178,6 +219,12 @@ mapper_signal mapper_signal_new(const char *name, int length, char type,
  *  \param sig      The signal to free. */
 void mapper_signal_free(mapper_signal sig);
 
+/*! Release the active instances and id maps of a local signal, which refer to
+ *  state of its device.  Used when the signal is removed from a database that
+ *  defers freeing its record, since the device may be freed first.
+ *  \param sig      The signal to release. */
+void mapper_signal_release_local(mapper_signal sig);
+
 /*! Coerce a signal instance value to a particular type and vector length and
  *  add it to a lo_message. */
 void message_add_coerced_signal_instance_value(lo_message m, mapper_signal sig,
@@ -231,6 +278,24 @@ void mapper_signal_instance_release_internal(mapper_signal sig,
                                              int instance_index,
                                              mapper_timetag_t timetag);
 
+/*! Record an instance's current value in its interpolation history, if
+ *  interpolation is enabled for the signal.  The timetag is in local time. */
+void mapper_signal_instance_store_sample(mapper_signal sig,
+                                         mapper_signal_instance si,
+                                         mapper_timetag_t tt);
+
+/*! Drop the signal's reference to the id map at a given index. */
+void mapper_signal_clear_id_map(mapper_signal sig, int index);
+
+/*! Rebuild the global id index of a signal's id maps, e.g. after their global
+ *  ids changed. */
+void mapper_signal_reindex_id_maps(mapper_signal sig);
+
+/*! Perform an update that was handed off through the device update queue. */
+void mapper_signal_process_queued_update(mapper_signal sig, int type,
+                                         mapper_id id, const void *value,
+                                         int count, mapper_timetag_t tt);
+
 /**** Links ****/
 
 void mapper_link_init(mapper_link link, int is_local);
@@ -239,6 +304,7 @@ void mapper_link_connect(mapper_link link, const char *host, int admin_port,
 void mapper_link_free(mapper_link link);
 int mapper_link_set_from_message(mapper_link link, mapper_message msg, int rev);
 void mapper_link_send_state(mapper_link link, network_message_t cmd, int staged);
+int mapper_link_has_queue(mapper_link link, mapper_timetag_t tt);
 void mapper_link_start_queue(mapper_link link, mapper_timetag_t tt);
 void mapper_link_send_queue(mapper_link link, mapper_timetag_t tt);
 
@@ -255,6 +321,13 @@ int mapper_database_update_link(mapper_database db, mapper_link link,
 void mhist_realloc(mapper_history history, int history_size,
                    int sample_size, int is_output);
 
+/*! Reset a history buffer without clearing its memory.  Samples written before
+ *  the reset are zeroed lazily the first time they are accessed again. */
+void mhist_reset(mapper_history history);
+
+/*! Zero a history sample left over from before the last reset. */
+void mhist_clear_stale(mapper_history history, int index);
+
 /*! Process the signal instance value according to mapping properties.
  *  The result of this operation should be sent to the destination.
  *  \param map          The mapping process to perform.
@@ -287,6 +360,11 @@ const char *mapper_property_string(mapper_property_t prop);
 
 const char *mapper_property_protocol_string(mapper_property_t prop);
 
+/*! Check whether a property is linked to a field that is written directly
+ *  rather than through the property table, so that changes to it are not
+ *  tracked by the table. */
+int mapper_property_written_directly(mapper_property_t prop);
+
 const char *mapper_boundary_action_string(mapper_boundary_action bound);
 
 mapper_boundary_action mapper_boundary_action_from_string(const char *string);
@@ -378,6 +456,14 @@ mapper_map mapper_database_add_or_update_map(mapper_database db, int num_srcs,
 void mapper_database_remove_device(mapper_database db, mapper_device dev,
                                    mapper_record_event event, int quiet);
 
+/*! Free the hash indexes of a database, once its lists are no longer used. */
+void mapper_database_free_indexes(mapper_database db);
+
+/**** Snapshots ****/
+
+/*! Drop the references of a database to its snapshots. */
+void mapper_database_free_snapshots(mapper_database db);
+
 void mapper_database_remove_signal(mapper_database db, mapper_signal sig,
                                    mapper_record_event event);
 
@@ -413,6 +499,10 @@ void mapper_database_remove_all_callbacks(mapper_database db);
 /*! Check device records for unresponsive devices. */
 void mapper_database_check_device_status(mapper_database db, uint32_t now_sec);
 
+/*! Move the deadline by which a remote device must sync again, after its
+ *  synced timestamp has been updated. */
+void mapper_database_device_synced(mapper_database db, mapper_device dev);
+
 /*! Flush device records for unresponsive devices. */
 mapper_device mapper_database_expired_device(mapper_database db,
                                              uint32_t last_ping);
@@ -589,7 +679,7 @@ void mapper_table_clear_empty_records(mapper_table tab);
 
 void *mapper_list_from_data(const void *data);
 
-void *mapper_list_add_item(void **list, size_t size);
+void *mapper_list_add_item(void **list, size_t size, mapper_pool pool);
 
 void mapper_list_remove_item(void **list, void *item);
 
@@ -598,6 +688,18 @@ void mapper_list_free_item(void *item);
 void **mapper_list_new_query(const void *list, const void *f,
                              const char *types, ...);
 
+/*! Create a query whose results are a copy of the given array of items.  The
+ *  compare function and its arguments are kept so that the query can still be
+ *  combined with others.  Returns zero if the array is empty. */
+void **mapper_list_new_array_query(const void *list, void **items,
+                                   int num_items, const void *f,
+                                   const char *types, ...);
+
+/*! Get the precomputed results of a query created by
+ *  mapper_list_new_array_query().  Returns the number of items, or -1 if the
+ *  query is evaluated lazily. */
+int mapper_list_query_items(void **query, void ***items);
+
 void **mapper_list_query_union(void **query1, void **query2);
 
 void **mapper_list_query_intersection(void **query1, void **query2);
@@ -614,6 +716,45 @@ void **mapper_list_query_copy(void **query);
 
 void mapper_list_query_done(void **query);
 
+void mapper_hash_index_add(mapper_hash_index index, uint64_t key, void *item);
+
+void mapper_hash_index_remove(mapper_hash_index index, uint64_t key,
+                              void *item);
+
+/*! Move an item stored under old_key to new_key. */
+void mapper_hash_index_rekey(mapper_hash_index index, uint64_t old_key,
+                             uint64_t new_key, void *item);
+
+/*! Return the next item stored under key after prev, or the first one if prev
+ *  is zero. */
+void *mapper_hash_index_find(mapper_hash_index index, uint64_t key,
+                             void *prev);
+
+void mapper_hash_index_free(mapper_hash_index index);
+
+/*! Allocate a zeroed block of memory from a pool, or using malloc() if pool
+ *  is zero. */
+void *mapper_pool_alloc(mapper_pool pool, size_t size);
+
+/*! Return a block allocated by mapper_pool_alloc() to its pool. */
+void mapper_pool_release(void *mem);
+
+/*! Free all the memory held by a pool, including blocks still in use. */
+void mapper_pool_free(mapper_pool pool);
+
+/*! Add a timer to a heap, or move it if it is already there. */
+void mapper_timer_heap_set(mapper_timer_heap heap, mapper_timer timer,
+                           void *item, uint32_t deadline);
+
+/*! Take a timer out of a heap, if it is there. */
+void mapper_timer_heap_remove(mapper_timer_heap heap, mapper_timer timer);
+
+/*! Take the earliest timer out of a heap if its deadline is not after
+ *  time_sec, and return the object owning it. */
+void *mapper_timer_heap_expired(mapper_timer_heap heap, uint32_t time_sec);
+
+void mapper_timer_heap_free(mapper_timer_heap heap);
+
 /**** Time ****/
 
 /*! Get the current time. */
@@ -698,6 +839,14 @@ inline static void* mapper_history_tt_ptr(mapper_history_t h)
     return &h.timetag[h.position];
 }
 
+/*! Must be called before reading or writing a history sample, since samples
+ *  that predate the last call to mhist_reset() may still hold stale values. */
+inline static void mapper_history_touch(mapper_history h, int index)
+{
+    if (h->sample_generation && h->sample_generation[index] != h->generation)
+        mhist_clear_stale(h, index);
+}
+
 /*! Helper to check if a type character is valid. */
 inline static int check_signal_type(char type)
 {
@@ -764,6 +913,26 @@ inline static int type_match(const char l, const char r)
     return (l == r) || (strchr("bTF", l) && strchr("bTF", r));
 }
 
+/*! Mix the bits of an id for use as a hash table key. */
+inline static unsigned int mapper_id_hash(mapper_id id)
+{
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    return (unsigned int)id;
+}
+
+/*! Hash a string for use as a hash table key. */
+inline static unsigned int mapper_string_hash(const char *string)
+{
+    unsigned int hash = 2166136261u;
+    while (*string) {
+        hash ^= (unsigned char)*string++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 /*! Helper to remove a leading slash '/' from a string. */
 inline static const char *skip_slash(const char *string)
 {
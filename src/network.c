@@ -40,6 +40,12 @@ extern const char* prop_message_strings[NUM_AT_PROPERTIES];
 
 #define MAX_BUNDLE_COUNT 10
 
+/* Probe windows in seconds used by fast name allocation. */
+#define FAST_PROBE_QUIET        0.1
+#define FAST_PROBE_CONTENDED    0.2
+#define FAST_PROBE_MAX          2.0
+#define FAST_REPROBE            0.5
+
 /* Note: any call to liblo where get_liblo_error will be called afterwards must
  * lock this mutex, otherwise there is a race condition on receiving this
  * information.  Could be fixed by the liblo error handler having a user context
@@ -479,6 +485,15 @@ mapper_network mapper_network_new(const char *iface, const char *group, int port
     lo_server_enable_queue(net->bus_server, 0, 1);
     lo_server_enable_queue(net->mesh_server, 0, 1);
 
+#ifdef HAVE_PTHREAD
+    // recursive, so that handlers running on an I/O thread may take it again
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&net->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+
     return net;
 }
 
@@ -623,13 +638,18 @@ void mapper_network_free(mapper_network net)
     if (net->bus_addr)
         lo_address_free(net->bus_addr);
 
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy(&net->lock);
+#endif
+
+    mapper_database_free_indexes(&net->database);
+    mapper_pool_free(&net->database.pool);
     free(net);
 }
 
 /*! Probe the libmapper bus to see if a device's proposed name.ordinal is
  *  already taken. */
-static void mapper_network_probe_device_name(mapper_network net,
-                                             mapper_device dev)
+void mapper_network_probe_device_name(mapper_network net, mapper_device dev)
 {
     dev->local->ordinal.collision_count = -1;
     dev->local->ordinal.count_time = mapper_get_current_time();
@@ -641,7 +661,10 @@ static void mapper_network_probe_device_name(mapper_network net,
     snprintf(name, 256, "%s.%d", dev->identifier, dev->local->ordinal.value);
 
     /* Calculate an id from the name and store it in id.value */
+    mapper_id id = dev->id;
     dev->id = (mapper_id)crc32(0L, (const Bytef *)name, strlen(name)) << 32;
+    mapper_hash_index_rekey(&dev->database->devices_by_id, id, dev->id, dev);
+    ++dev->database->devices_version;
 
     /* For the same reason, we can't use mapper_network_send() here. */
     lo_send(net->bus_addr, network_message_strings[MSG_NAME_PROBE], "si",
@@ -860,6 +883,289 @@ int mapper_network_port(mapper_network net)
     return lo_server_get_port(net->bus_server);
 }
 
+/*! Return the ordinal of a bus name "<identifier>.<n>" if it shares the
+ *  identifier of a device, or zero otherwise. */
+static unsigned int name_ordinal(mapper_device dev, const char *name)
+{
+    const char *identifier = dev->identifier, *dot;
+    int len, ordinal;
+
+    if (name[0] == '/')
+        ++name;
+    if (identifier[0] == '/')
+        ++identifier;
+    dot = strrchr(name, '.');
+    len = strlen(identifier);
+    if (!dot || dot - name != len || strncmp(name, identifier, len))
+        return 0;
+    ordinal = atoi(dot + 1);
+    return ordinal > 0 ? ordinal : 0;
+}
+
+/*! Record a peer probing for a value, or a value that a peer has locked,
+ *  while a resource is still being allocated. */
+static void add_allocation_peer(mapper_allocated resource, int id,
+                                unsigned int value, int registered)
+{
+    int i, j;
+    mapper_allocation_peer peer;
+
+    if (registered) {
+        // peers probing this value have to move, and will probe again
+        for (i = 0, j = 0; i < resource->num_peers; i++) {
+            peer = &resource->peers[i];
+            if (peer->value == value && !peer->registered)
+                continue;
+            resource->peers[j++] = *peer;
+        }
+        resource->num_peers = j;
+    }
+
+    for (i = 0; i < resource->num_peers; i++) {
+        peer = &resource->peers[i];
+        if (registered ? (peer->registered && peer->value == value)
+            : (!peer->registered && peer->id == id))
+            break;
+    }
+    if (i == resource->num_peers) {
+        if (resource->num_peers == resource->peers_alloced) {
+            j = resource->peers_alloced ? resource->peers_alloced * 2 : 8;
+            peer = realloc(resource->peers,
+                           sizeof(mapper_allocation_peer_t) * j);
+            if (!peer)
+                return;
+            resource->peers = peer;
+            resource->peers_alloced = j;
+        }
+        ++resource->num_peers;
+    }
+    peer = &resource->peers[i];
+    peer->time = mapper_get_current_time();
+    peer->value = value;
+    peer->id = id;
+    peer->registered = registered;
+}
+
+/*! Check whether a device ordinal is registered by a peer, either announced
+ *  on the bus during allocation or already known to the network database. */
+static int ordinal_taken(mapper_network net, mapper_device dev,
+                         unsigned int value)
+{
+    mapper_allocated resource = &dev->local->ordinal;
+    mapper_device remote;
+    int i;
+
+    for (i = 0; i < resource->num_peers; i++) {
+        if (resource->peers[i].registered && resource->peers[i].value == value)
+            return 1;
+    }
+    remote = net->database.devices;
+    while (remote) {
+        if (!remote->local && remote->name
+            && name_ordinal(dev, remote->name) == value)
+            return 1;
+        remote = mapper_list_next(remote);
+    }
+    return 0;
+}
+
+static int compare_peer_ids(const void *l, const void *r)
+{
+    int lid = ((mapper_allocation_peer)l)->id;
+    int rid = ((mapper_allocation_peer)r)->id;
+    return lid < rid ? -1 : lid > rid;
+}
+
+/*! Choose the ordinal a device should probe next during fast allocation.
+ *  Peers probing the same ordinal are ranked by their random ids: the lowest
+ *  keeps it unless it is registered, and the others take the lowest free
+ *  ordinals in rank order.  Peers that have heard the same probes reach the
+ *  same assignment, so a crowd of devices starting together settles in one
+ *  round instead of backing off at random. */
+static unsigned int fast_pick_ordinal(mapper_network net, mapper_device dev)
+{
+    mapper_allocated resource = &dev->local->ordinal;
+    mapper_allocation_peer probing;
+    double now = mapper_get_current_time();
+    int i, j, num = 0, *taken, *lost;
+    unsigned int value = 0;
+
+    probing = malloc(sizeof(mapper_allocation_peer_t)
+                     * (resource->num_peers + 1));
+    taken = malloc(sizeof(int) * (resource->num_peers + 1) * 2);
+    if (!probing || !taken)
+        goto done;
+    lost = taken + resource->num_peers + 1;
+
+    // peers that stopped probing have either registered or gone away
+    for (i = 0; i < resource->num_peers; i++) {
+        if (!resource->peers[i].registered
+            && now - resource->peers[i].time < TIMEOUT_SEC)
+            probing[num++] = resource->peers[i];
+    }
+    probing[num].value = resource->value;
+    probing[num].id = net->random_id;
+    probing[num].registered = 0;
+    ++num;
+    qsort(probing, num, sizeof(mapper_allocation_peer_t), compare_peer_ids);
+
+    for (i = 0; i < num; i++) {
+        taken[i] = ordinal_taken(net, dev, probing[i].value);
+        lost[i] = taken[i];
+        for (j = 0; j < i && !lost[i]; j++)
+            lost[i] = probing[j].value == probing[i].value;
+    }
+
+    // hand out free ordinals to the peers that lost, in order of their ids
+    value = 1;
+    for (i = 0; i < num; i++) {
+        if (!lost[i]) {
+            if (probing[i].id == net->random_id)
+                break;
+            continue;
+        }
+        while (1) {
+            for (j = 0; j < num; j++) {
+                if (probing[j].value == value && !taken[j])
+                    break;
+            }
+            if (j == num && !ordinal_taken(net, dev, value))
+                break;
+            ++value;
+        }
+        if (probing[i].id == net->random_id)
+            break;
+        ++value;
+    }
+    if (i == num || !lost[i])
+        value = resource->value;
+
+  done:
+    if (probing)
+        free(probing);
+    if (taken)
+        free(taken);
+    return value ? value : resource->value;
+}
+
+/*! Return the probe window for fast allocation: short on a quiet bus, longer
+ *  while other devices are probing, and doubled after each collision. */
+static double fast_probe_window(mapper_allocated resource)
+{
+    double now = mapper_get_current_time(), window = FAST_PROBE_QUIET;
+    int i;
+
+    for (i = 0; i < resource->num_peers; i++) {
+        if (!resource->peers[i].registered
+            && now - resource->peers[i].time < FAST_PROBE_MAX) {
+            window = FAST_PROBE_CONTENDED;
+            break;
+        }
+    }
+    for (i = 0; i < resource->rounds && window < FAST_PROBE_MAX; i++)
+        window *= 2;
+    return window < FAST_PROBE_MAX ? window : FAST_PROBE_MAX;
+}
+
+static void lock_resource(mapper_allocated resource)
+{
+    resource->locked = 1;
+    if (resource->peers) {
+        free(resource->peers);
+        resource->peers = 0;
+    }
+    resource->num_peers = resource->peers_alloced = 0;
+    if (resource->on_lock)
+        resource->on_lock(resource);
+}
+
+int mapper_network_set_fast_allocation(mapper_network net, mapper_device dev,
+                                       int enable, unsigned int ordinal)
+{
+    mapper_allocated resource = &dev->local->ordinal;
+    unsigned int value;
+
+    if (dev->local->registered || resource->locked)
+        return -1;
+    resource->fast = enable ? 1 : 0;
+    resource->pinned = 0;
+    resource->rounds = 0;
+    if (!enable)
+        return 0;
+
+    if (ordinal) {
+        resource->pinned = 1;
+        value = ordinal;
+    }
+    else {
+        // skip ordinals already held by known peers
+        value = fast_pick_ordinal(net, dev);
+    }
+    if (value != resource->value) {
+        resource->value = value;
+        mapper_network_probe_device_name(net, dev);
+    }
+    return 0;
+}
+
+double mapper_network_allocation_wait(mapper_network net,
+                                      mapper_allocated resource)
+{
+    double elapsed = mapper_get_current_time() - resource->count_time;
+    double window;
+
+    if (resource->locked)
+        return 0;
+    if (resource->fast) {
+        window = net->msgs_recvd ? fast_probe_window(resource) : FAST_REPROBE;
+        return window > elapsed ? window - elapsed : 0;
+    }
+
+    // name collisions are checked 0.5, 2 and 5 seconds after probing
+    if (elapsed < 0.5)
+        return 0.5 - elapsed;
+    else if (elapsed < 2.0)
+        return 2.0 - elapsed;
+    else if (elapsed < 5.0)
+        return 5.0 - elapsed;
+    return 0;
+}
+
+/*! Fast variant of check_collisions() for device ordinals. */
+static int check_fast_collisions(mapper_network net, mapper_allocated resource)
+{
+    mapper_device dev = net->device;
+    double timediff = mapper_get_current_time() - resource->count_time;
+    unsigned int value;
+
+    if (!net->msgs_recvd) {
+        if (timediff >= FAST_REPROBE) {
+            // reprobe with the same value
+            resource->count_time = mapper_get_current_time();
+            return 1;
+        }
+        return 0;
+    }
+    if (timediff < fast_probe_window(resource))
+        return 0;
+
+    value = fast_pick_ordinal(net, dev);
+    if (value == resource->value) {
+        lock_resource(resource);
+        return 2;
+    }
+    if (resource->pinned) {
+        trace_dev(dev, "pinned ordinal %d is taken, allocating another.\n",
+                  resource->value);
+        resource->pinned = 0;
+    }
+    resource->value = value;
+    ++resource->rounds;
+
+    /* Indicate that we need to re-probe the new value. */
+    return 1;
+}
+
 /*! Algorithm for checking collisions and allocating resources. */
 static int check_collisions(mapper_network net, mapper_allocated resource)
 {
@@ -867,6 +1173,9 @@ static int check_collisions(mapper_network net, mapper_allocated resource)
 
     if (resource->locked)
         return 0;
+    if (resource->fast && net->device
+        && resource == &net->device->local->ordinal)
+        return check_fast_collisions(net, resource);
 
     timediff = mapper_get_current_time() - resource->count_time;
 
@@ -879,9 +1188,7 @@ static int check_collisions(mapper_network net, mapper_allocated resource)
         return 0;
     }
     else if (timediff >= 2.0 && resource->collision_count <= 1) {
-        resource->locked = 1;
-        if (resource->on_lock)
-            resource->on_lock(resource);
+        lock_resource(resource);
         return 2;
     }
     else if (timediff >= 0.5 && resource->collision_count > 0) {
@@ -1413,6 +1720,12 @@ static int handler_registered(const char *path, const char *types, lo_arg **argv
         }
     }
     else {
+        if (dev->local->ordinal.fast) {
+            ordinal = name_ordinal(dev, name);
+            if (ordinal)
+                add_allocation_peer(&dev->local->ordinal, -1, ordinal, 1);
+        }
+
         id = (mapper_id)crc32(0L, (const Bytef *)name, strlen(name)) << 32;
         if (id == dev->id) {
             if (argc > 1) {
@@ -1421,7 +1734,7 @@ static int handler_registered(const char *path, const char *types, lo_arg **argv
                 if (types[2] == 'i')
                     suggestion = argv[2]->i;
             }
-            if (temp_id == net->random_id &&
+            if (temp_id == net->random_id && !dev->local->ordinal.fast &&
                 suggestion != dev->local->ordinal.value && suggestion > 0) {
                 dev->local->ordinal.value = suggestion;
                 mapper_network_probe_device_name(net, dev);
@@ -1446,6 +1759,7 @@ static int handler_probe(const char *path, const char *types, lo_arg **argv,
     double current_time;
     mapper_id id;
     int temp_id = -1, i;
+    unsigned int ordinal;
 
     if (types[0] == 's' || types[0] == 'S')
         name = &argv[0]->s;
@@ -1461,6 +1775,13 @@ static int handler_probe(const char *path, const char *types, lo_arg **argv,
 
     trace_dev(dev, "got /name/probe %s %i \n", name, temp_id);
 
+    if (!dev->local->ordinal.locked && dev->local->ordinal.fast
+        && temp_id != net->random_id) {
+        ordinal = name_ordinal(dev, name);
+        if (ordinal)
+            add_allocation_peer(&dev->local->ordinal, temp_id, ordinal, 0);
+    }
+
     id = (mapper_id)crc32(0L, (const Bytef *)name, strlen(name)) << 32;
     if (id == dev->id) {
         if (dev->local->ordinal.locked) {
@@ -1498,6 +1819,11 @@ static int handler_probe(const char *path, const char *types, lo_arg **argv,
  *  send the message "/mapped" to its peer.  Data will be sent only after the
  *  "/mapped" message has been received from the peer device.
  *
+ * The destination device adds the property "@alias" to its "/mapTo" and
+ * "/mapped" messages: a small integer that sources may use to send updates to
+ * the short path "/@<alias>" instead of the full signal path.  An alias of 0
+ * withdraws any alias offered before, and sources return to the full path.
+ *
  * The "/map/modify" message is used to change the properties of existing maps.
  * The device administering the map will make appropriate changes and then send
  * "/mapped" to its peer.
@@ -2618,6 +2944,7 @@ static int handler_sync(const char *path, const char *types, lo_arg **argv,
                 return 0;
             trace_db("updating sync record for device '%s'\n", dev->name);
             mapper_timetag_copy(&dev->synced, lo_message_get_timestamp(msg));
+            mapper_database_device_synced(&net->database, dev);
 
             if (!dev->subscribed && net->database.autosubscribe) {
                 trace_db("autosubscribing to device '%s'.\n", &argv[0]->s);
@@ -2641,8 +2968,10 @@ static int handler_sync(const char *path, const char *types, lo_arg **argv,
         }
     }
     else if (types[0] == 'i') {
-        if ((dev = mapper_database_device_by_id(&net->database, argv[0]->i)))
+        if ((dev = mapper_database_device_by_id(&net->database, argv[0]->i))) {
             mapper_timetag_copy(&dev->synced, lo_message_get_timestamp(msg));
+            mapper_database_device_synced(&net->database, dev);
+        }
     }
 
     return 0;
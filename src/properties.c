@@ -60,6 +60,9 @@ const static_property_t static_properties[] = {
     { "@use_instances",     1, 'b', 'b' },  /* AT_USE_INSTANCES */
     { "@user_data",         1, 'v',  0  },  /* AT_USER_DATA */
     { "@version",           1, 'i', 'i' },  /* AT_VERSION */
+    { "@alias",             1, 'i', 'i' },  /* AT_ALIAS (protocol only,
+                                             * kept out of the alphabetical
+                                             * search) */
     { "@extra",             0, 'a', 'a' },  /* AT_EXTRA (special case, does not
                                              * represent a specific property
                                              * name) */
@@ -454,7 +457,7 @@ const char *mapper_property_string(mapper_property_t prop)
 mapper_property_t mapper_property_from_string(const char *string)
 {
     // property names are stored alphabetically so we can use a binary search
-    int beg = 0, end = NUM_AT_PROPERTIES - 2;
+    int beg = 0, end = AT_ALIAS - 1;
     int mid = (beg + end) * 0.5, cmp;
     while (beg <= end) {
         cmp = strcmp(string, static_properties[mid].name + 1);
@@ -466,6 +469,8 @@ mapper_property_t mapper_property_from_string(const char *string)
             end = mid - 1;
         mid = (beg + end) * 0.5;
     }
+    if (strcmp(string, "alias")==0)
+        return AT_ALIAS;
     if (strcmp(string, "maximum")==0)
         return AT_MAX;
     if (strcmp(string, "minimum")==0)
@@ -473,6 +478,26 @@ mapper_property_t mapper_property_from_string(const char *string)
     return AT_EXTRA;
 }
 
+int mapper_property_written_directly(mapper_property_t prop)
+{
+    switch (MASK_PROP_BITFLAGS(prop)) {
+        case AT_NUM_INCOMING_MAPS:
+        case AT_NUM_INPUTS:
+        case AT_NUM_INSTANCES:
+        case AT_NUM_LINKS:
+        case AT_NUM_OUTGOING_MAPS:
+        case AT_NUM_OUTPUTS:
+        case AT_RATE:
+        case AT_STATUS:
+        case AT_SYNCED:
+        case AT_USER_DATA:
+        case AT_VERSION:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 const char *mapper_boundary_action_string(mapper_boundary_action bound)
 {
     if (bound <= MAPPER_BOUND_UNDEFINED || bound > NUM_MAPPER_BOUNDARY_ACTIONS)
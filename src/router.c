@@ -24,6 +24,14 @@ static int map_in_scope(mapper_map map, mapper_id id)
     return 0;
 }
 
+// path to send updates to, using the alias offered by the destination if any
+static inline const char *dest_path(mapper_map map)
+{
+    if (map->local->alias)
+        return map->local->alias_path;
+    return map->destination.signal->path;
+}
+
 static void reallocate_slot_instances(mapper_slot slot, int size)
 {
     int i;
@@ -38,6 +46,9 @@ static void reallocate_slot_instances(mapper_slot slot, int size)
                                                    * slot->local->history_size);
             slot->local->history[i].timetag = calloc(1, sizeof(mapper_timetag_t)
                                                      * slot->local->history_size);
+            slot->local->history[i].sample_generation =
+                calloc(1, sizeof(unsigned int) * slot->local->history_size);
+            slot->local->history[i].generation = 0;
             slot->local->history[i].position = -1;
         }
         slot->num_instances = size;
@@ -80,6 +91,9 @@ static void reallocate_map_instances(mapper_map map, int size)
                                                      * lmap->expr_vars[i][j].size);
                 lmap->expr_vars[i][j].timetag = calloc(1, sizeof(mapper_timetag_t)
                                                        * lmap->expr_vars[i][j].size);
+                lmap->expr_vars[i][j].sample_generation =
+                    calloc(1, sizeof(unsigned int) * lmap->expr_vars[i][j].size);
+                lmap->expr_vars[i][j].generation = 0;
             }
         }
         lmap->num_var_instances = size;
@@ -148,37 +162,28 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
             if (map->status < STATUS_ACTIVE)
                 continue;
 
-            // need to reset user variable memory for this instance
-            for (j = 0; j < lmap->num_expr_vars; j++) {
-                memset(lmap->expr_vars[idx][j].value, 0, sizeof(double)
-                       * lmap->expr_vars[idx][j].length
-                       * lmap->expr_vars[idx][j].size);
-                memset(lmap->expr_vars[idx][j].timetag, 0,
-                       sizeof(mapper_timetag_t)
-                       * lmap->expr_vars[idx][j].size);
-                lmap->expr_vars[idx][j].position = -1;
-            }
+            /* Need to reset user variable memory for this instance. Histories
+             * are cleared lazily so releasing is cheap for deep histories. */
+            for (j = 0; j < lmap->num_expr_vars; j++)
+                mhist_reset(&lmap->expr_vars[idx][j]);
 
             mapper_slot dst_slot = &map->destination;
             mapper_local_slot dst_lslot = dst_slot->local;
 
             // also need to reset associated output memory
-            dst_lslot->history[idx].position= -1;
-            memset(dst_lslot->history[idx].value, 0, dst_lslot->history_size
-                   * dst_slot->signal->length * mapper_type_size(dst_slot->signal->type));
-            memset(dst_lslot->history[idx].timetag, 0, dst_lslot->history_size
-                   * sizeof(mapper_timetag_t));
-            dst_lslot->history[idx].position = -1;
-
-            if (slot->direction == MAPPER_DIR_OUTGOING
-                && !(sig->local->id_maps[instance].status & RELEASED_REMOTELY)) {
+            mhist_reset(&dst_lslot->history[idx]);
+
+            /* Also send the release if the destination released the instance
+             * first, since it keeps the instance's id map until it hears
+             * that the source has released it too. */
+            if (slot->direction == MAPPER_DIR_OUTGOING) {
                 msg = 0;
                 if (!slot->use_instances)
                     msg = mapper_map_build_message(map, slot, 0, 1, 0, 0);
                 else if (map_in_scope(map, id_map->global))
                     msg = mapper_map_build_message(map, slot, 0, 1, 0, id_map);
                 if (msg)
-                    send_or_bundle_message(dst_slot->link, dst_slot->signal->path,
+                    send_or_bundle_message(dst_slot->link, dest_path(map),
                                            msg, tt, map->protocol);
             }
 
@@ -187,11 +192,7 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                 lslot = slot->local;
 
                 // also need to reset associated input memory
-                memset(lslot->history[idx].value, 0, lslot->history_size
-                       * slot->signal->length * mapper_type_size(slot->signal->type));
-                memset(lslot->history[idx].timetag, 0, lslot->history_size
-                       * sizeof(mapper_timetag_t));
-                lslot->history[idx].position = -1;
+                mhist_reset(&lslot->history[idx]);
 
                 if (!map->sources[j]->use_instances)
                     continue;
@@ -249,6 +250,8 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
             size_t n = mapper_signal_vector_bytes(sig);
             lslot->history[idx].position = ((lslot->history[idx].position + 1)
                                             % lslot->history[idx].size);
+            mapper_history_touch(&lslot->history[idx],
+                                 lslot->history[idx].position);
             memcpy(mapper_history_value_ptr(lslot->history[idx]), value + n * j, n);
             memcpy(mapper_history_tt_ptr(lslot->history[idx]),
                    &tt, sizeof(mapper_timetag_t));
@@ -297,7 +300,7 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                                                slot->use_instances ? id_map : 0);
                 if (msg)
                     send_or_bundle_message(map->destination.link,
-                                           dst_slot->signal->path, msg, tt,
+                                           dest_path(map), msg, tt,
                                            map->protocol);
             }
             ++k;
@@ -308,7 +311,7 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                                            slot->use_instances ? id_map : 0);
             if (msg)
                 send_or_bundle_message(map->destination.link,
-                                       dst_slot->signal->path, msg, tt,
+                                       dest_path(map), msg, tt,
                                        map->protocol);
         }
     }
@@ -526,6 +529,7 @@ void mapper_router_add_map(mapper_router rtr, mapper_map map)
         if (map->sources[i]->signal->local)
             ++local_src;
     }
+    ++rtr->version;
 
     if (map->local) {
         trace("error in mapper_router_add_map – local structures already exist.\n");
@@ -559,8 +563,11 @@ void mapper_router_add_map(mapper_router rtr, mapper_map map)
     lmap->num_var_instances = max_num_instances;
 
     // assign a unique id to this map if we are the destination
-    if (local_dst)
+    if (local_dst) {
+        mapper_id id = map->id;
         map->id = unused_map_id(rtr->device, rtr);
+        mapper_hash_index_rekey(&map->database->maps_by_id, id, map->id, map);
+    }
 
     /* assign indices to source slots - may be overwritten later by message */
     for (i = 0; i < map->num_sources; i++) {
@@ -654,6 +661,7 @@ void mapper_router_remove_signal(mapper_router rtr, mapper_router_signal rs)
 {
     if (rtr && rs) {
         // No maps remaining – we can remove the router_signal also
+        ++rtr->version;
         mapper_router_signal *rstemp = &rtr->signals;
         while (*rstemp) {
             if (*rstemp == rs) {
@@ -678,6 +686,7 @@ static void free_slot_memory(mapper_slot slot)
             for (i = 0; i < slot->num_instances; i++) {
                 free(slot->local->history[i].value);
                 free(slot->local->history[i].timetag);
+                free(slot->local->history[i].sample_generation);
             }
             free(slot->local->history);
         }
@@ -691,6 +700,7 @@ int mapper_router_remove_map(mapper_router rtr, mapper_map map)
     int i, j;
     if (!map || !map->local)
         return 1;
+    ++rtr->version;
 
     // remove map and slots from router_signal lists if necessary
     if (map->destination.local->router_sig) {
@@ -738,6 +748,7 @@ int mapper_router_remove_map(mapper_router rtr, mapper_map map)
                 for (j = 0; j < map->local->num_expr_vars; j++) {
                     free(map->local->expr_vars[i][j].value);
                     free(map->local->expr_vars[i][j].timetag);
+                    free(map->local->expr_vars[i][j].sample_generation);
                 }
             }
             free(map->local->expr_vars[i]);
@@ -871,6 +882,25 @@ mapper_map mapper_router_map_by_id(mapper_router router, mapper_signal local_sig
     return 0;
 }
 
+mapper_link mapper_router_incoming_link(mapper_router router,
+                                       mapper_signal signal)
+{
+    // use the first incoming map, since unslotted updates have a single source
+    mapper_router_signal rs = router->signals;
+    while (rs && rs->signal != signal)
+        rs = rs->next;
+    if (!rs)
+        return NULL;
+
+    int i;
+    for (i = 0; i < rs->num_slots; i++) {
+        if (!rs->slots[i] || rs->slots[i]->direction == MAPPER_DIR_OUTGOING)
+            continue;
+        return rs->slots[i]->map->sources[0]->link;
+    }
+    return NULL;
+}
+
 mapper_slot mapper_router_slot(mapper_router router, mapper_signal signal,
                                int slot_id)
 {
@@ -9,8 +9,14 @@
 #include "types_internal.h"
 #include <mapper/mapper.h>
 
+/* Default limit on the number of instances and id maps of a signal.  Signals
+ * created with more instances than this are limited to that number instead. */
 #define MAX_INSTANCES 128
 
+/* Number of recent samples kept per instance for interpolation, enough for a
+ * cubic segment and its neighbouring tangents. */
+#define INTERP_HISTORY_SIZE 4
+
 /* Function prototypes */
 static void mapper_signal_update_internal(mapper_signal sig, int instance_index,
                                           const void *value, int count,
@@ -22,6 +28,8 @@ static void *mapper_signal_instance_value_internal(mapper_signal sig,
 
 static int mapper_signal_oldest_active_instance_internal(mapper_signal sig);
 
+static void free_interp_history(mapper_signal_instance si);
+
 static int mapper_signal_newest_active_instance_internal(mapper_signal sig);
 
 static int mapper_signal_find_instance_with_local_id(mapper_signal sig,
@@ -90,18 +98,26 @@ void mapper_signal_init(mapper_signal sig, mapper_direction dir,
             sig->local->has_complete_value[i/8] |= 1 << (i % 8);
         }
 
+        sig->local->max_instances = (num_instances > MAX_INSTANCES
+                                     ? num_instances : MAX_INSTANCES);
         if (num_instances)
             mapper_signal_reserve_instances(sig, num_instances, 0, 0);
 
         // Reserve one instance id map
         sig->local->id_map_length = 1;
         sig->local->id_maps = calloc(1, sizeof(struct _mapper_signal_id_map));
+        sig->local->id_maps[0].next_by_global = -1;
+        sig->local->free_id_map = 0;
+        sig->local->id_maps_by_global = malloc(sizeof(int));
+        sig->local->id_maps_by_global[0] = -1;
+        sig->local->oldest_active = sig->local->newest_active = -1;
     }
     else {
         sig->staged_props = mapper_table_new();
     }
 
     sig->props = mapper_table_new();
+    sig->props->version = &sig->device->database->signals_version;
     int flags = sig->local ? NON_MODIFIABLE : MODIFIABLE;
 
     // these properties need to be added in alphabetical order
@@ -158,6 +174,24 @@ void mapper_signal_init(mapper_signal sig, mapper_direction dir,
                             LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
 }
 
+void mapper_signal_release_local(mapper_signal sig)
+{
+    int i;
+    if (!sig || !sig->local || !sig->local->id_maps)
+        return;
+
+    for (i = 0; i < sig->local->id_map_length; i++) {
+        if (sig->local->id_maps[i].instance) {
+            mapper_signal_instance_release_internal(sig, i, MAPPER_NOW);
+        }
+    }
+    free(sig->local->id_maps);
+    free(sig->local->id_maps_by_global);
+    sig->local->id_maps = 0;
+    sig->local->id_maps_by_global = 0;
+    sig->local->id_map_length = 0;
+}
+
 void mapper_signal_free(mapper_signal sig)
 {
     int i;
@@ -165,22 +199,22 @@ void mapper_signal_free(mapper_signal sig)
 
     if (sig->local) {
         // Free instances
-        for (i = 0; i < sig->local->id_map_length; i++) {
-            if (sig->local->id_maps[i].instance) {
-                mapper_signal_instance_release_internal(sig, i, MAPPER_NOW);
-            }
-        }
-        free(sig->local->id_maps);
+        mapper_signal_release_local(sig);
         for (i = 0; i < sig->num_instances; i++) {
             if (sig->local->instances[i]->value)
                 free(sig->local->instances[i]->value);
             if (sig->local->instances[i]->has_value_flags)
                 free(sig->local->instances[i]->has_value_flags);
+            free_interp_history(sig->local->instances[i]);
             free(sig->local->instances[i]);
         }
         free(sig->local->instances);
         if (sig->local->has_complete_value)
             free(sig->local->has_complete_value);
+        for (i = 0; i < MESSAGE_SHAPE_CACHE_SIZE; i++) {
+            if (sig->local->shapes[i].types)
+                free(sig->local->shapes[i].types);
+        }
         free(sig->local);
     }
 
@@ -230,12 +264,9 @@ void mapper_signal_push(mapper_signal sig)
     }
 }
 
-void mapper_signal_update(mapper_signal sig, const void *value, int count,
+static void update_signal(mapper_signal sig, const void *value, int count,
                           mapper_timetag_t tt)
 {
-    if (!sig || !sig->local)
-        return;
-
     mapper_timetag_t tt2, *ttp;
     if (memcmp(&tt, &MAPPER_NOW, sizeof(mapper_timetag_t))==0) {
         ttp = &tt2;
@@ -250,6 +281,20 @@ void mapper_signal_update(mapper_signal sig, const void *value, int count,
     mapper_signal_update_internal(sig, index, value, count, *ttp);
 }
 
+void mapper_signal_update(mapper_signal sig, const void *value, int count,
+                          mapper_timetag_t tt)
+{
+    if (!sig || !sig->local)
+        return;
+
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_UPDATE, 0, value,
+                                   count, tt);
+        return;
+    }
+    update_signal(sig, value, count, tt);
+}
+
 void mapper_signal_update_int(mapper_signal sig, int value)
 {
     if (!sig || !sig->local)
@@ -268,6 +313,12 @@ void mapper_signal_update_int(mapper_signal sig, int value)
     }
 #endif
 
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_UPDATE, 0, &value,
+                                   1, MAPPER_NOW);
+        return;
+    }
+
     mapper_timetag_t tt;
     mapper_timetag_now(&tt);
 
@@ -295,6 +346,12 @@ void mapper_signal_update_float(mapper_signal sig, float value)
     }
 #endif
 
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_UPDATE, 0, &value,
+                                   1, MAPPER_NOW);
+        return;
+    }
+
     mapper_timetag_t tt;
     mapper_timetag_now(&tt);
 
@@ -322,6 +379,12 @@ void mapper_signal_update_double(mapper_signal sig, double value)
     }
 #endif
 
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_UPDATE, 0, &value,
+                                   1, MAPPER_NOW);
+        return;
+    }
+
     mapper_timetag_t tt;
     mapper_timetag_now(&tt);
 
@@ -349,6 +412,44 @@ static void mapper_signal_init_instance(mapper_signal_instance si)
 {
     si->has_value = 0;
     mapper_timetag_now(&si->created);
+    if (si->interp_history.value)
+        mhist_reset(&si->interp_history);
+}
+
+static void free_interp_history(mapper_signal_instance si)
+{
+    if (si->interp_history.value)
+        free(si->interp_history.value);
+    if (si->interp_history.timetag)
+        free(si->interp_history.timetag);
+    si->interp_history.value = 0;
+    si->interp_history.timetag = 0;
+}
+
+// Append an id map to the list of active instances as the newest one.
+static void link_active_instance(mapper_signal sig, int index)
+{
+    mapper_signal_id_map_t *maps = sig->local->id_maps;
+    maps[index].prev_active = sig->local->newest_active;
+    maps[index].next_active = -1;
+    if (sig->local->newest_active >= 0)
+        maps[sig->local->newest_active].next_active = index;
+    else
+        sig->local->oldest_active = index;
+    sig->local->newest_active = index;
+}
+
+static void unlink_active_instance(mapper_signal sig, int index)
+{
+    mapper_signal_id_map_t *maps = sig->local->id_maps;
+    if (maps[index].prev_active >= 0)
+        maps[maps[index].prev_active].next_active = maps[index].next_active;
+    else
+        sig->local->oldest_active = maps[index].next_active;
+    if (maps[index].next_active >= 0)
+        maps[maps[index].next_active].prev_active = maps[index].prev_active;
+    else
+        sig->local->newest_active = maps[index].prev_active;
 }
 
 static int mapper_signal_find_instance_with_local_id(mapper_signal sig,
@@ -367,22 +468,78 @@ static int mapper_signal_find_instance_with_local_id(mapper_signal sig,
     return -1;
 }
 
-int mapper_signal_find_instance_with_global_id(mapper_signal sig,
-                                               mapper_id global_id,
-                                               int flags)
+/* Look up the lowest id map index with a given global id, optionally only
+ * considering id maps with an active instance. */
+static int find_id_map_with_global_id(mapper_signal sig, mapper_id global_id,
+                                      int active)
+{
+    mapper_signal_id_map_t *maps = sig->local->id_maps;
+    int i = sig->local->id_maps_by_global[mapper_id_hash(global_id)
+                                          & (sig->local->id_map_length - 1)];
+    int found = -1;
+    while (i >= 0) {
+        if (   maps[i].map->global == global_id
+            && (!active || maps[i].instance)
+            && (found < 0 || i < found))
+            found = i;
+        i = maps[i].next_by_global;
+    }
+    return found;
+}
+
+static void index_id_map(mapper_signal sig, int index)
+{
+    mapper_id global_id = sig->local->id_maps[index].map->global;
+    int *bucket = &sig->local->id_maps_by_global[mapper_id_hash(global_id)
+                                                 & (sig->local->id_map_length - 1)];
+    sig->local->id_maps[index].next_by_global = *bucket;
+    *bucket = index;
+}
+
+void mapper_signal_reindex_id_maps(mapper_signal sig)
 {
     int i;
-    for (i = 0; i < sig->local->id_map_length; i++) {
-        if (!sig->local->id_maps[i].map)
-            continue;
-        if (sig->local->id_maps[i].map->global == global_id) {
-            if (sig->local->id_maps[i].status & ~flags)
-                return -1;
-            else
-                return i;
+    for (i = 0; i < sig->local->id_map_length; i++)
+        sig->local->id_maps_by_global[i] = -1;
+    // unused id maps are linked through next_by_global, lowest index first
+    sig->local->free_id_map = -1;
+    for (i = sig->local->id_map_length - 1; i >= 0; i--) {
+        if (sig->local->id_maps[i].map)
+            index_id_map(sig, i);
+        else {
+            sig->local->id_maps[i].next_by_global = sig->local->free_id_map;
+            sig->local->free_id_map = i;
         }
     }
-    return -1;
+}
+
+void mapper_signal_clear_id_map(mapper_signal sig, int index)
+{
+    mapper_signal_id_map_t *maps = sig->local->id_maps;
+    if (!maps[index].map)
+        return;
+    int *i = &sig->local->id_maps_by_global[mapper_id_hash(maps[index].map->global)
+                                            & (sig->local->id_map_length - 1)];
+    while (*i >= 0) {
+        if (*i == index) {
+            *i = maps[index].next_by_global;
+            break;
+        }
+        i = &maps[*i].next_by_global;
+    }
+    maps[index].map = 0;
+    maps[index].next_by_global = sig->local->free_id_map;
+    sig->local->free_id_map = index;
+}
+
+int mapper_signal_find_instance_with_global_id(mapper_signal sig,
+                                               mapper_id global_id,
+                                               int flags)
+{
+    int i = find_id_map_with_global_id(sig, global_id, 0);
+    if (i < 0 || (sig->local->id_maps[i].status & ~flags))
+        return -1;
+    return i;
 }
 
 static mapper_signal_instance reserved_instance(mapper_signal sig)
@@ -502,16 +659,9 @@ int mapper_signal_instance_with_global_id(mapper_signal sig, mapper_id global_id
     mapper_instance_event_handler *event_h = sig->local->instance_event_handler;
 
     mapper_signal_instance si;
-    int i;
-    for (i = 0; i < sig->local->id_map_length; i++) {
-        if (maps[i].instance && maps[i].map->global == global_id) {
-            if (maps[i].status & ~flags)
-                return -1;
-            else {
-                return i;
-            }
-        }
-    }
+    int i = find_id_map_with_global_id(sig, global_id, 1);
+    if (i >= 0)
+        return (maps[i].status & ~flags) ? -1 : i;
 
     // check if the device already has a map for this global id
     mapper_id_map map = mapper_device_find_instance_id_map_by_global(sig->device,
@@ -632,7 +782,7 @@ int mapper_signal_instance_with_global_id(mapper_signal sig, mapper_id global_id
 static int reserve_instance_internal(mapper_signal sig, mapper_id *id,
                                      void *user_data)
 {
-    if (sig->num_instances >= MAX_INSTANCES)
+    if (sig->num_instances >= sig->local->max_instances)
         return -1;
 
     int i, lowest_index, cont;
@@ -745,11 +895,72 @@ void mapper_signal_instance_update(mapper_signal sig, mapper_id id,
         return;
     }
 
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_INSTANCE_UPDATE, id,
+                                   value, count, timetag);
+        return;
+    }
+
     int index = mapper_signal_instance_with_local_id(sig, id, 0, &timetag);
     if (index >= 0)
         mapper_signal_update_internal(sig, index, value, count, timetag);
 }
 
+void mapper_signal_update_instances(mapper_signal sig, int num,
+                                    const mapper_id *ids, const void *values,
+                                    mapper_timetag_t tt)
+{
+    int i, index, own_queue = 0;
+    if (!sig || !sig->local || num <= 0 || !ids)
+        return;
+
+    mapper_device dev = sig->device;
+    size_t n = mapper_signal_vector_bytes(sig);
+    const char *value = (const char*)values;
+
+    /* Queued updates are stamped when they are dequeued, so that producers
+     * do not read the clock. */
+    if (dev->local->update_queue) {
+        for (i = 0; i < num; i++) {
+            if (value)
+                mapper_device_queue_update(dev, sig, QUEUED_INSTANCE_UPDATE,
+                                           ids[i], value + n * i, 1, tt);
+            else
+                mapper_device_queue_update(dev, sig, QUEUED_INSTANCE_RELEASE,
+                                           ids[i], 0, 0, tt);
+        }
+        return;
+    }
+
+    // all updates share a single timetag
+    if (memcmp(&tt, &MAPPER_NOW, sizeof(mapper_timetag_t))==0)
+        mapper_timetag_now(&tt);
+
+    /* Collect the outgoing messages for each link into a single bundle,
+     * unless the caller has already started a queue for this timetag. */
+    if (!mapper_device_has_queue(dev, tt)) {
+        mapper_device_start_queue(dev, tt);
+        own_queue = 1;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (value) {
+            index = mapper_signal_instance_with_local_id(sig, ids[i], 0, &tt);
+            if (index >= 0)
+                mapper_signal_update_internal(sig, index, value + n * i, 1, tt);
+        }
+        else {
+            index = mapper_signal_find_instance_with_local_id(sig, ids[i],
+                                                              RELEASED_REMOTELY);
+            if (index >= 0)
+                mapper_signal_instance_release_internal(sig, index, tt);
+        }
+    }
+
+    if (own_queue)
+        mapper_device_send_queue(dev, tt);
+}
+
 int mapper_signal_instance_is_active(mapper_signal sig, mapper_id id)
 {
     if (!sig)
@@ -775,26 +986,8 @@ mapper_id mapper_signal_oldest_active_instance(mapper_signal sig)
 
 int mapper_signal_oldest_active_instance_internal(mapper_signal sig)
 {
-    int i;
-    mapper_signal_instance si;
-    for (i = 0; i < sig->local->id_map_length; i++) {
-        if (sig->local->id_maps[i].instance)
-            break;
-    }
-    if (i == sig->local->id_map_length) {
-        // no active instances to steal!
-        return -1;
-    }
-    int oldest = i;
-    for (i = oldest+1; i < sig->local->id_map_length; i++) {
-        if (!(si = sig->local->id_maps[i].instance))
-            continue;
-        if ((si->created.sec < sig->local->id_maps[oldest].instance->created.sec) ||
-            (si->created.sec == sig->local->id_maps[oldest].instance->created.sec &&
-             si->created.frac < sig->local->id_maps[oldest].instance->created.frac))
-            oldest = i;
-    }
-    return oldest;
+    // -1 if there are no active instances to steal
+    return sig->local->oldest_active;
 }
 
 mapper_id mapper_signal_newest_active_instance(mapper_signal sig)
@@ -812,26 +1005,8 @@ mapper_id mapper_signal_newest_active_instance(mapper_signal sig)
 
 int mapper_signal_newest_active_instance_internal(mapper_signal sig)
 {
-    int i;
-    mapper_signal_instance si;
-    for (i = 0; i < sig->local->id_map_length; i++) {
-        if (sig->local->id_maps[i].instance)
-            break;
-    }
-    if (i == sig->local->id_map_length) {
-        // no active instances to steal!
-        return -1;
-    }
-    int newest = i;
-    for (i = newest+1; i < sig->local->id_map_length; i++) {
-        if (!(si = sig->local->id_maps[i].instance))
-            continue;
-        if ((si->created.sec > sig->local->id_maps[newest].instance->created.sec) ||
-            (si->created.sec == sig->local->id_maps[newest].instance->created.sec &&
-             si->created.frac > sig->local->id_maps[newest].instance->created.frac))
-            newest = i;
-    }
-    return newest;
+    // -1 if there are no active instances to steal
+    return sig->local->newest_active;
 }
 
 static void mapper_signal_update_internal(mapper_signal sig, int instance_index,
@@ -858,6 +1033,9 @@ static void mapper_signal_update_internal(mapper_signal sig, int instance_index,
     else
         memcpy(&si->timetag, &tt, sizeof(mapper_timetag_t));
 
+    if (value)
+        mapper_signal_instance_store_sample(sig, si, si->timetag);
+
     mapper_device_route_signal(sig->device, sig, instance_index, value,
                                count, si->timetag);
 }
@@ -868,12 +1046,41 @@ void mapper_signal_instance_release(mapper_signal sig, mapper_id id,
     if (!sig || !sig->local)
         return;
 
+    if (sig->device->local->update_queue) {
+        mapper_device_queue_update(sig->device, sig, QUEUED_INSTANCE_RELEASE,
+                                   id, 0, 0, timetag);
+        return;
+    }
+
     int index = mapper_signal_find_instance_with_local_id(sig, id,
                                                           RELEASED_REMOTELY);
     if (index >= 0)
         mapper_signal_instance_release_internal(sig, index, timetag);
 }
 
+void mapper_signal_process_queued_update(mapper_signal sig, int type,
+                                         mapper_id id, const void *value,
+                                         int count, mapper_timetag_t tt)
+{
+    int index;
+    switch (type) {
+        case QUEUED_UPDATE:
+            update_signal(sig, value, count, tt);
+            break;
+        case QUEUED_INSTANCE_UPDATE:
+            index = mapper_signal_instance_with_local_id(sig, id, 0, &tt);
+            if (index >= 0)
+                mapper_signal_update_internal(sig, index, value, count, tt);
+            break;
+        case QUEUED_INSTANCE_RELEASE:
+            index = mapper_signal_find_instance_with_local_id(sig, id,
+                                                              RELEASED_REMOTELY);
+            if (index >= 0)
+                mapper_signal_instance_release_internal(sig, index, tt);
+            break;
+    }
+}
+
 void mapper_signal_instance_release_internal(mapper_signal sig,
                                              int instance_index,
                                              mapper_timetag_t tt)
@@ -896,12 +1103,12 @@ void mapper_signal_instance_release_internal(mapper_signal sig,
     if (smap->map->refcount_local <= 0 && smap->map->refcount_global <= 0) {
         mapper_device_remove_instance_id_map(sig->device, sig->local->group,
                                              smap->map);
-        smap->map = 0;
+        mapper_signal_clear_id_map(sig, instance_index);
     }
     else if ((sig->direction & MAPPER_DIR_OUTGOING)
              || smap->status & RELEASED_REMOTELY) {
         // TODO: consider multiple upstream source instances?
-        smap->map = 0;
+        mapper_signal_clear_id_map(sig, instance_index);
     }
     else {
         // mark map as locally-released but do not remove it
@@ -909,6 +1116,7 @@ void mapper_signal_instance_release_internal(mapper_signal sig,
     }
 
     // Put instance back in reserve list
+    unlink_active_instance(sig, instance_index);
     smap->instance->is_active = 0;
     smap->instance = 0;
 }
@@ -938,6 +1146,7 @@ void mapper_signal_remove_instance(mapper_signal sig, mapper_id id)
         free(sig->local->instances[i]->value);
     if (sig->local->instances[i]->has_value_flags)
         free(sig->local->instances[i]->has_value_flags);
+    free_interp_history(sig->local->instances[i]);
     free(sig->local->instances[i]);
     ++i;
     for (; i < sig->num_instances; i++) {
@@ -979,6 +1188,177 @@ const void *mapper_signal_instance_value(mapper_signal sig, mapper_id id,
     return mapper_signal_instance_value_internal(sig, index, timetag);
 }
 
+void mapper_signal_instance_store_sample(mapper_signal sig,
+                                         mapper_signal_instance si,
+                                         mapper_timetag_t tt)
+{
+    mapper_history h = &si->interp_history;
+    if (!sig->local->interpolation || !si->has_value)
+        return;
+
+    if (!h->value) {
+        h->type = sig->type;
+        h->length = sig->length;
+        h->size = INTERP_HISTORY_SIZE;
+        h->value = malloc(h->size * mapper_signal_vector_bytes(sig));
+        h->timetag = calloc(INTERP_HISTORY_SIZE, sizeof(mapper_timetag_t));
+        h->position = -1;
+    }
+    h->position = (h->position + 1) % h->size;
+    memcpy(mapper_history_value_ptr(*h), si->value,
+           mapper_signal_vector_bytes(sig));
+    memcpy(mapper_history_tt_ptr(*h), &tt, sizeof(mapper_timetag_t));
+}
+
+static double history_element(mapper_history h, int sample, int element)
+{
+    int index = sample * h->length + element;
+    switch (h->type) {
+        case 'i':   return ((int*)h->value)[index];
+        case 'f':   return ((float*)h->value)[index];
+        default:    return ((double*)h->value)[index];
+    }
+}
+
+static void set_element(void *value, char type, int element, double d)
+{
+    switch (type) {
+        case 'i':   ((int*)value)[element] = (int)floor(d + 0.5);   break;
+        case 'f':   ((float*)value)[element] = (float)d;            break;
+        default:    ((double*)value)[element] = d;                  break;
+    }
+}
+
+static int mapper_signal_instance_interpolate_internal(mapper_signal sig,
+                                                       int instance_index,
+                                                       mapper_timetag_t tt,
+                                                       void *value)
+{
+    mapper_signal_instance si = sig->local->id_maps[instance_index].instance;
+    if (!si || !si->has_value)
+        return 0;
+
+    mapper_history h = &si->interp_history;
+    size_t n = mapper_signal_vector_bytes(sig);
+    int i, j, idx, num = 0, order[INTERP_HISTORY_SIZE];
+    double t[INTERP_HISTORY_SIZE];
+
+    if (memcmp(&tt, &MAPPER_NOW, sizeof(mapper_timetag_t))==0)
+        mapper_timetag_now(&tt);
+
+    /* Sort the stored samples by time, measured relative to the requested
+     * time so that precision is not lost to the magnitude of NTP times. */
+    for (i = 0; h->value && i < h->size; i++) {
+        idx = (h->position + 1 + i) % h->size;
+        if (!h->timetag[idx].sec && !h->timetag[idx].frac)
+            continue;
+        double d = mapper_timetag_difference(h->timetag[idx], tt);
+        for (j = num; j > 0 && t[j-1] > d; j--) {
+            t[j] = t[j-1];
+            order[j] = order[j-1];
+        }
+        t[j] = d;
+        order[j] = idx;
+        ++num;
+    }
+
+    if (!num) {
+        memcpy(value, si->value, n);
+        return 1;
+    }
+    // no extrapolation outside of the stored samples
+    if (t[0] >= 0) {
+        memcpy(value, h->value + order[0] * n, n);
+        return 1;
+    }
+    if (t[num-1] <= 0) {
+        memcpy(value, h->value + order[num-1] * n, n);
+        return 1;
+    }
+
+    // find the segment containing the requested time
+    int k = 0;
+    while (t[k+1] <= 0)
+        ++k;
+    if (sig->local->interpolation == MAPPER_INTERP_HOLD) {
+        memcpy(value, h->value + order[k] * n, n);
+        return 1;
+    }
+
+    double span = t[k+1] - t[k], u = -t[k] / span;
+    for (i = 0; i < sig->length; i++) {
+        double p0 = history_element(h, order[k], i);
+        double p1 = history_element(h, order[k+1], i);
+        if (sig->local->interpolation == MAPPER_INTERP_LINEAR) {
+            set_element(value, sig->type, i, p0 + (p1 - p0) * u);
+            continue;
+        }
+        // cubic Hermite with finite-difference tangents for uneven spacing
+        double m0, m1, u2 = u * u, u3 = u2 * u;
+        if (k > 0)
+            m0 = ((p1 - history_element(h, order[k-1], i))
+                  / (t[k+1] - t[k-1]));
+        else
+            m0 = (p1 - p0) / span;
+        if (k + 2 < num)
+            m1 = ((history_element(h, order[k+2], i) - p0)
+                  / (t[k+2] - t[k]));
+        else
+            m1 = (p1 - p0) / span;
+        set_element(value, sig->type, i,
+                    (2 * u3 - 3 * u2 + 1) * p0 + (u3 - 2 * u2 + u) * span * m0
+                    + (-2 * u3 + 3 * u2) * p1 + (u3 - u2) * span * m1);
+    }
+    return 1;
+}
+
+int mapper_signal_interpolate(mapper_signal sig, mapper_timetag_t tt,
+                              void *value)
+{
+    if (!sig || !sig->local || !value)
+        return 0;
+    int index = 0;
+    if (!sig->local->id_maps[0].instance)
+        index = mapper_signal_find_instance_with_local_id(sig, 0, 0);
+    if (index < 0)
+        return 0;
+    return mapper_signal_instance_interpolate_internal(sig, index, tt, value);
+}
+
+int mapper_signal_instance_interpolate(mapper_signal sig, mapper_id id,
+                                       mapper_timetag_t tt, void *value)
+{
+    if (!sig || !sig->local || !value)
+        return 0;
+
+    int index = mapper_signal_find_instance_with_local_id(sig, id,
+                                                          RELEASED_REMOTELY);
+    if (index < 0)
+        return 0;
+    return mapper_signal_instance_interpolate_internal(sig, index, tt, value);
+}
+
+void mapper_signal_set_interpolation(mapper_signal sig,
+                                     mapper_interpolation_type type)
+{
+    int i;
+    if (!sig || !sig->local || type < MAPPER_INTERP_NONE
+        || type > MAPPER_INTERP_CUBIC)
+        return;
+    sig->local->interpolation = type;
+    if (type == MAPPER_INTERP_NONE) {
+        for (i = 0; i < sig->num_instances; i++)
+            free_interp_history(sig->local->instances[i]);
+    }
+}
+
+mapper_interpolation_type mapper_signal_interpolation(mapper_signal sig)
+{
+    if (sig && sig->local)
+        return sig->local->interpolation;
+    return MAPPER_INTERP_NONE;
+}
+
 int mapper_signal_num_instances(mapper_signal sig)
 {
     return sig ? sig->num_instances : -1;
@@ -1079,6 +1459,53 @@ void mapper_signal_set_instance_event_callback(mapper_signal sig,
     sig->local->instance_event_flags = flags;
 }
 
+int mapper_signal_set_jitter_buffer(mapper_signal sig, double latency,
+                                    int size)
+{
+    if (!sig || !sig->local || latency < 0)
+        return -1;
+
+    if (latency == 0) {
+        sig->local->jitter_latency = 0;
+        mapper_device_flush_jitter_buffer(sig->device, sig, 1);
+        return 0;
+    }
+    if (size <= 0)
+        return -1;
+
+    sig->local->jitter_latency = latency;
+    sig->local->jitter_size = size;
+    return 0;
+}
+
+int mapper_signal_jitter_buffer_stats(mapper_signal sig, unsigned int *late,
+                                      unsigned int *dropped)
+{
+    if (!sig || !sig->local)
+        return 0;
+    if (late)
+        *late = sig->local->jitter_late;
+    if (dropped)
+        *dropped = sig->local->jitter_dropped;
+    return sig->local->jitter_pending;
+}
+
+void mapper_signal_set_discard_out_of_order(mapper_signal sig, int discard)
+{
+    if (sig && sig->local)
+        sig->local->discard_out_of_order = discard != 0;
+}
+
+int mapper_signal_discard_out_of_order(mapper_signal sig)
+{
+    return (sig && sig->local) ? sig->local->discard_out_of_order : 0;
+}
+
+unsigned int mapper_signal_num_discarded(mapper_signal sig)
+{
+    return (sig && sig->local) ? sig->local->num_discarded : 0;
+}
+
 void mapper_signal_set_user_data(mapper_signal sig, const void *user_data)
 {
     if (sig)
@@ -1392,16 +1819,15 @@ static int mapper_signal_add_id_map(mapper_signal sig, mapper_signal_instance si
                                     mapper_id_map map)
 {
     // find unused signal map
-    int i;
+    int i = sig->local->free_id_map;
 
-    for (i = 0; i < sig->local->id_map_length; i++) {
-        if (!sig->local->id_maps[i].map)
-            break;
-    }
-    if (i == sig->local->id_map_length) {
+    if (i < 0) {
         // need more memory
-        if (sig->local->id_map_length >= MAX_INSTANCES) {
-            // Arbitrary limit to number of tracked id_maps
+        i = sig->local->id_map_length;
+        if (i >= sig->local->max_instances * 2) {
+            /* Limit the number of tracked id_maps.  Stolen or locally released
+             * instances keep their maps until the remote release arrives, so
+             * allow as many of those again as there are instances. */
             return -1;
         }
         sig->local->id_map_length *= 2;
@@ -1411,10 +1837,19 @@ static int mapper_signal_add_id_map(mapper_signal sig, mapper_signal_instance si
         memset(sig->local->id_maps + i, 0,
                (sig->local->id_map_length - i)
                * sizeof(struct _mapper_signal_id_map));
+        sig->local->id_maps_by_global = realloc(sig->local->id_maps_by_global,
+                                                sig->local->id_map_length
+                                                * sizeof(int));
+        mapper_signal_reindex_id_maps(sig);
     }
+    sig->local->free_id_map = sig->local->id_maps[i].next_by_global;
     sig->local->id_maps[i].map = map;
     sig->local->id_maps[i].instance = si;
     sig->local->id_maps[i].status = 0;
+    index_id_map(sig, i);
+
+    // instances are activated as they are created, so this one is the newest
+    link_active_instance(sig, i);
 
     return i;
 }
@@ -1571,6 +2006,7 @@ int mapper_signal_set_from_message(mapper_signal sig, mapper_message msg)
 {
     mapper_message_atom atom;
     int i, updated = 0, len_type_diff = 0;
+    mapper_id id = sig->id;
 
     if (!msg)
         return updated;
@@ -1615,6 +2051,7 @@ int mapper_signal_set_from_message(mapper_signal sig, mapper_message msg)
             maps = mapper_map_query_next(maps);
         }
     }
+    mapper_device_reindex_signal_id(sig->device, sig, id);
     return updated + len_type_diff;
 }
 
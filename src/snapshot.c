@@ -0,0 +1,573 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mapper_internal.h"
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#include <sched.h>
+#endif
+
+/* Snapshots are built by the thread that updates the database and are never
+ * modified once published, so readers can use them without locking.  The
+ * database keeps a reference to every snapshot it has published until no
+ * reader can still be acquiring it, and readers keep their own references
+ * for as long as they use a snapshot.  A new snapshot shares the copies of
+ * records that have not changed since the previous one, and each copy is
+ * freed with the last snapshot holding it. */
+
+#define SNAPSHOT_CHUNK_SIZE 512
+
+static const int snapshot_types[NUM_SNAPSHOT_TYPES] = {
+    MAPPER_OBJ_DEVICES, MAPPER_OBJ_SIGNALS, MAPPER_OBJ_LINKS, MAPPER_OBJ_MAPS
+};
+
+static int snapshot_type_index(mapper_object_type type)
+{
+    int i;
+    for (i = 0; i < NUM_SNAPSHOT_TYPES; i++) {
+        if (snapshot_types[i] == type)
+            return i;
+    }
+    return -1;
+}
+
+/*! Allocate memory from a list of chunks, adding a chunk if necessary. */
+static void *chunk_alloc(mapper_snapshot_chunk *chunks, size_t size)
+{
+    mapper_snapshot_chunk chunk = *chunks;
+    size = (size + 7) & ~7;
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > SNAPSHOT_CHUNK_SIZE ? size
+                                                       : SNAPSHOT_CHUNK_SIZE;
+        chunk = malloc(sizeof(mapper_snapshot_chunk_t) + chunk_size);
+        if (!chunk)
+            return 0;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        if (size > SNAPSHOT_CHUNK_SIZE && *chunks) {
+            // keep filling the current chunk after an oversized one
+            chunk->next = (*chunks)->next;
+            (*chunks)->next = chunk;
+        }
+        else {
+            chunk->next = *chunks;
+            *chunks = chunk;
+        }
+    }
+    void *mem = chunk->data + chunk->used;
+    chunk->used += size;
+    return mem;
+}
+
+/*! Allocate memory that lives as long as the record copy. */
+static void *record_alloc(mapper_snapshot_record rec, size_t size)
+{
+    return chunk_alloc(&rec->chunks, size);
+}
+
+static const char *record_strdup(mapper_snapshot_record rec, const char *str)
+{
+    char *copy = record_alloc(rec, strlen(str) + 1);
+    if (copy)
+        strcpy(copy, str);
+    return copy;
+}
+
+static mapper_snapshot_record new_record(mapper_id id)
+{
+    mapper_snapshot_chunk chunks = 0;
+    mapper_snapshot_record rec = chunk_alloc(&chunks,
+                                             sizeof(mapper_snapshot_record_t));
+    if (!rec)
+        return 0;
+    memset(rec, 0, sizeof(mapper_snapshot_record_t));
+    rec->id = id;
+    rec->refcount = 1;
+    rec->chunks = chunks;
+    return rec;
+}
+
+static void release_record(mapper_snapshot_record rec)
+{
+    mapper_snapshot_chunk chunk, next;
+    if (__atomic_sub_fetch(&rec->refcount, 1, __ATOMIC_SEQ_CST))
+        return;
+    // the record itself lives in one of its chunks
+    for (chunk = rec->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+}
+
+static void snapshot_free(mapper_snapshot snap)
+{
+    int i, j;
+    for (i = 0; i < NUM_SNAPSHOT_TYPES; i++) {
+        for (j = 0; j < snap->num_records[i]; j++)
+            release_record(snap->records[i][j]);
+        free(snap->records[i]);
+    }
+    free(snap);
+}
+
+/*! Get the value of a table record if it can be shared with readers. */
+static const void *shared_value(mapper_table_record_t *tab_rec)
+{
+    const void *value;
+    if (!tab_rec->value || tab_rec->length < 1
+        || (tab_rec->index & PROPERTY_REMOVE))
+        return 0;
+    switch (tab_rec->type) {
+        case 'i': case 'b': case 'T': case 'F': case 'f': case 'd':
+        case 's': case 'S': case 'h': case 't': case 'c':
+            break;
+        default:
+            // pointers such as user data are not shared with readers
+            return 0;
+    }
+    value = (tab_rec->flags & INDIRECT ? *tab_rec->value : tab_rec->value);
+    return value;
+}
+
+/*! Copy the properties of a record from its property table. */
+static void copy_properties(mapper_snapshot_record rec, mapper_table tab)
+{
+    int i, j, size;
+    mapper_table_record_t *tab_rec;
+    mapper_snapshot_property prop;
+    const void *value;
+
+    rec->stamp = tab->stamp;
+    rec->props = record_alloc(rec, sizeof(mapper_snapshot_property_t)
+                              * tab->num_records);
+    if (!rec->props)
+        return;
+    for (i = 0; i < tab->num_records; i++) {
+        tab_rec = &tab->records[i];
+        if (!(value = shared_value(tab_rec)))
+            continue;
+        prop = &rec->props[rec->num_props];
+        if (tab_rec->key)
+            prop->name = record_strdup(rec, tab_rec->key);
+        else
+            prop->name = mapper_property_string(tab_rec->index);
+        prop->length = tab_rec->length;
+        prop->type = tab_rec->type;
+        if (prop->type == 's' || prop->type == 'S') {
+            if (prop->length == 1)
+                prop->value = record_strdup(rec, (const char*)value);
+            else {
+                const char **strings = record_alloc(rec, sizeof(char*)
+                                                    * prop->length);
+                for (j = 0; strings && j < prop->length; j++) {
+                    const char *str = ((const char**)value)[j];
+                    strings[j] = str ? record_strdup(rec, str) : 0;
+                }
+                prop->value = strings;
+            }
+        }
+        else {
+            size = mapper_type_size(prop->type) * prop->length;
+            void *copy = record_alloc(rec, size);
+            if (copy)
+                memcpy(copy, value, size);
+            prop->value = copy;
+        }
+        if (prop->name && prop->value)
+            ++rec->num_props;
+    }
+}
+
+/*! Check whether a record copy still matches its table.  Changes made
+ *  through the table renew its stamp, but the few properties linked to
+ *  fields that are written directly must be compared. */
+static int record_is_current(mapper_snapshot_record rec, mapper_table tab)
+{
+    int i, j, size;
+    mapper_table_record_t *tab_rec;
+    mapper_snapshot_property prop;
+    const void *value;
+    const char *name;
+
+    if (rec->stamp != tab->stamp)
+        return 0;
+    for (i = 0; i < tab->num_records; i++) {
+        tab_rec = &tab->records[i];
+        if (tab_rec->key || !mapper_property_written_directly(tab_rec->index))
+            continue;
+        value = shared_value(tab_rec);
+        name = mapper_property_string(tab_rec->index);
+        for (j = 0, prop = 0; j < rec->num_props; j++) {
+            if (rec->props[j].name == name) {
+                prop = &rec->props[j];
+                break;
+            }
+        }
+        if (!prop || !value) {
+            if (prop || value)
+                return 0;
+            continue;
+        }
+        // directly written properties are never strings
+        size = mapper_type_size(prop->type) * prop->length;
+        if (prop->length != tab_rec->length || prop->type != tab_rec->type
+            || memcmp(prop->value, value, size))
+            return 0;
+    }
+    return 1;
+}
+
+/*! Get the id, related record ids and property table of a database record.
+ *  Returns the number of related ids, which are written if refs is set. */
+static int record_contents(int type, void *item, mapper_id *id,
+                           mapper_id *refs, mapper_table *tab)
+{
+    int i;
+    switch (type) {
+        case MAPPER_OBJ_DEVICES: {
+            mapper_device dev = (mapper_device)item;
+            *id = dev->id;
+            *tab = dev->props;
+            return 0;
+        }
+        case MAPPER_OBJ_SIGNALS: {
+            mapper_signal sig = (mapper_signal)item;
+            *id = sig->id;
+            *tab = sig->props;
+            if (refs)
+                refs[0] = sig->device->id;
+            return 1;
+        }
+        case MAPPER_OBJ_LINKS: {
+            mapper_link link = (mapper_link)item;
+            *id = link->id;
+            *tab = link->props;
+            if (refs) {
+                refs[0] = link->devices[0]->id;
+                refs[1] = link->devices[1]->id;
+            }
+            return 2;
+        }
+        case MAPPER_OBJ_MAPS: {
+            mapper_map map = (mapper_map)item;
+            *id = map->id;
+            *tab = map->props;
+            if (refs) {
+                refs[0] = map->destination.signal->id;
+                for (i = 0; i < map->num_sources; i++)
+                    refs[i + 1] = map->sources[i]->signal->id;
+            }
+            return map->num_sources + 1;
+        }
+    }
+    return 0;
+}
+
+/*! Order records by id, then by the ids of their related records, since
+ *  some records such as remote links and signals may share an id. */
+static int compare_record_key(mapper_id id, mapper_id *refs, int num_refs,
+                              mapper_snapshot_record rec)
+{
+    int i;
+    if (id != rec->id)
+        return id < rec->id ? -1 : 1;
+    if (num_refs != rec->num_refs)
+        return num_refs < rec->num_refs ? -1 : 1;
+    for (i = 0; i < num_refs; i++) {
+        if (refs[i] != rec->refs[i])
+            return refs[i] < rec->refs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compare_records(const void *l, const void *r)
+{
+    mapper_snapshot_record rec_l = *(mapper_snapshot_record*)l;
+    return compare_record_key(rec_l->id, rec_l->refs, rec_l->num_refs,
+                              *(mapper_snapshot_record*)r);
+}
+
+/*! Fill in the records of one type, sharing the copies held by the previous
+ *  snapshot where the records have not changed since.  Each property table
+ *  refers to its copy in the latest snapshot. */
+static void snapshot_records(mapper_snapshot snap, mapper_snapshot old,
+                             int type_index, void *list)
+{
+    int type = snapshot_types[type_index];
+    int i, count = 0, num_refs, shared = 0;
+    void *item;
+    mapper_id id;
+    mapper_table tab;
+    mapper_snapshot_record rec;
+
+    for (item = list; item; item = mapper_list_next(item))
+        ++count;
+    snap->records[type_index] = malloc(sizeof(mapper_snapshot_record)
+                                       * (count ?: 1));
+    if (!snap->records[type_index]) {
+        // the previous snapshot will be retired, so forget its copies
+        for (item = list; item; item = mapper_list_next(item)) {
+            record_contents(type, item, &id, 0, &tab);
+            tab->snapshot = 0;
+        }
+        return;
+    }
+
+    for (item = list, i = 0; item; item = mapper_list_next(item)) {
+        num_refs = record_contents(type, item, &id, 0, &tab);
+        mapper_id refs[num_refs ?: 1];
+        record_contents(type, item, &id, refs, &tab);
+
+        rec = old ? tab->snapshot : 0;
+        if (rec && !compare_record_key(id, refs, num_refs, rec)
+            && record_is_current(rec, tab)) {
+            __atomic_add_fetch(&rec->refcount, 1, __ATOMIC_SEQ_CST);
+            snap->records[type_index][i++] = rec;
+            ++shared;
+            continue;
+        }
+
+        tab->snapshot = rec = new_record(id);
+        if (!rec)
+            continue;
+        if (num_refs) {
+            rec->refs = record_alloc(rec, sizeof(mapper_id) * num_refs);
+            if (rec->refs) {
+                memcpy(rec->refs, refs, sizeof(mapper_id) * num_refs);
+                rec->num_refs = num_refs;
+            }
+        }
+        copy_properties(rec, tab);
+        snap->records[type_index][i++] = rec;
+    }
+    if (old && shared == i && i == old->num_records[type_index]) {
+        // each copy belongs to a single table, so the records are the same
+        memcpy(snap->records[type_index], old->records[type_index],
+               sizeof(mapper_snapshot_record) * i);
+    }
+    else
+        qsort(snap->records[type_index], i, sizeof(mapper_snapshot_record),
+              compare_records);
+    snap->num_records[type_index] = i;
+}
+
+/*! Free the retired snapshots that only the database still refers to. */
+static void reclaim_snapshots(mapper_database db)
+{
+    mapper_snapshot *snap = &db->retired_snapshots;
+    // a reader that loaded a retired snapshot may not have referenced it yet
+    if (__atomic_load_n(&db->snapshot_readers, __ATOMIC_SEQ_CST))
+        return;
+    while (*snap) {
+        if (__atomic_load_n(&(*snap)->refcount, __ATOMIC_SEQ_CST) == 1) {
+            mapper_snapshot temp = *snap;
+            *snap = temp->next;
+            snapshot_free(temp);
+        }
+        else
+            snap = &(*snap)->next;
+    }
+}
+
+void mapper_database_set_snapshots(mapper_database db, int enable)
+{
+    if (enable) {
+        db->snapshots_enabled = 1;
+        mapper_database_publish_snapshot(db);
+    }
+    else {
+        db->snapshots_enabled = 0;
+        mapper_database_free_snapshots(db);
+    }
+}
+
+void mapper_database_publish_snapshot(mapper_database db)
+{
+    mapper_snapshot snap, old;
+    int i;
+
+    if (!db->snapshots_enabled)
+        return;
+    reclaim_snapshots(db);
+    old = db->snapshot;
+    if (old && old->sequence == db->sequence
+        && old->devices_version == db->devices_version
+        && old->signals_version == db->signals_version)
+        return;
+
+    snap = calloc(1, sizeof(mapper_snapshot_t));
+    if (!snap)
+        return;
+    snap->refcount = 1;
+    snap->sequence = db->sequence;
+    snap->devices_version = db->devices_version;
+    snap->signals_version = db->signals_version;
+    for (i = 0; i < NUM_SNAPSHOT_TYPES; i++) {
+        switch (snapshot_types[i]) {
+            case MAPPER_OBJ_DEVICES:
+                snapshot_records(snap, old, i, db->devices);
+                break;
+            case MAPPER_OBJ_SIGNALS:
+                snapshot_records(snap, old, i, db->signals);
+                break;
+            case MAPPER_OBJ_LINKS:
+                snapshot_records(snap, old, i, db->links);
+                break;
+            case MAPPER_OBJ_MAPS:
+                snapshot_records(snap, old, i, db->maps);
+                break;
+        }
+    }
+
+    __atomic_store_n(&db->snapshot, snap, __ATOMIC_SEQ_CST);
+    if (old) {
+        old->next = db->retired_snapshots;
+        db->retired_snapshots = old;
+        reclaim_snapshots(db);
+    }
+}
+
+void mapper_database_free_snapshots(mapper_database db)
+{
+    mapper_snapshot snap;
+    if (db->snapshot) {
+        db->snapshot->next = db->retired_snapshots;
+        db->retired_snapshots = db->snapshot;
+        __atomic_store_n(&db->snapshot, 0, __ATOMIC_SEQ_CST);
+    }
+    /* A reader may have loaded the snapshot without referencing it yet.  This
+     * is the only place the updating thread waits for readers, and only for
+     * those inside mapper_database_snapshot(), which holds the reader count
+     * for a few instructions.  Yield in case such a reader was preempted. */
+    while (__atomic_load_n(&db->snapshot_readers, __ATOMIC_SEQ_CST)) {
+#ifdef HAVE_PTHREAD
+        sched_yield();
+#endif
+    }
+    // snapshots still in use are freed when their last reader releases them
+    while ((snap = db->retired_snapshots)) {
+        db->retired_snapshots = snap->next;
+        mapper_snapshot_release(snap);
+    }
+}
+
+mapper_snapshot mapper_database_snapshot(mapper_database db)
+{
+    mapper_snapshot snap;
+    __atomic_add_fetch(&db->snapshot_readers, 1, __ATOMIC_SEQ_CST);
+    snap = __atomic_load_n(&db->snapshot, __ATOMIC_SEQ_CST);
+    if (snap)
+        __atomic_add_fetch(&snap->refcount, 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&db->snapshot_readers, 1, __ATOMIC_SEQ_CST);
+    return snap;
+}
+
+void mapper_snapshot_release(mapper_snapshot snap)
+{
+    if (snap && !__atomic_sub_fetch(&snap->refcount, 1, __ATOMIC_SEQ_CST))
+        snapshot_free(snap);
+}
+
+uint32_t mapper_snapshot_sequence(mapper_snapshot snap)
+{
+    return snap->sequence;
+}
+
+int mapper_snapshot_num_records(mapper_snapshot snap, mapper_object_type type)
+{
+    int i = snapshot_type_index(type);
+    return i < 0 ? 0 : snap->num_records[i];
+}
+
+mapper_snapshot_record mapper_snapshot_record_by_index(mapper_snapshot snap,
+                                                       mapper_object_type type,
+                                                       int index)
+{
+    int i = snapshot_type_index(type);
+    if (i < 0 || index < 0 || index >= snap->num_records[i])
+        return 0;
+    return snap->records[i][index];
+}
+
+mapper_snapshot_record mapper_snapshot_record_by_id(mapper_snapshot snap,
+                                                    mapper_object_type type,
+                                                    mapper_id id)
+{
+    int i = snapshot_type_index(type);
+    if (i < 0)
+        return 0;
+    int beg = 0, end = snap->num_records[i] - 1, mid;
+    while (beg <= end) {
+        mid = beg + (end - beg) / 2;
+        if (snap->records[i][mid]->id < id)
+            beg = mid + 1;
+        else if (snap->records[i][mid]->id > id)
+            end = mid - 1;
+        else
+            return snap->records[i][mid];
+    }
+    return 0;
+}
+
+mapper_id mapper_snapshot_record_id(mapper_snapshot_record rec)
+{
+    return rec->id;
+}
+
+int mapper_snapshot_record_num_refs(mapper_snapshot_record rec)
+{
+    return rec->num_refs;
+}
+
+mapper_id mapper_snapshot_record_ref(mapper_snapshot_record rec, int index)
+{
+    if (index < 0 || index >= rec->num_refs)
+        return 0;
+    return rec->refs[index];
+}
+
+int mapper_snapshot_record_num_properties(mapper_snapshot_record rec)
+{
+    return rec->num_props;
+}
+
+int mapper_snapshot_record_property(mapper_snapshot_record rec,
+                                    const char *name, int *length, char *type,
+                                    const void **value)
+{
+    int i;
+    if (!name)
+        return -1;
+    if (name[0] == '@')
+        ++name;
+    for (i = 0; i < rec->num_props; i++) {
+        const char *prop_name = rec->props[i].name;
+        if (prop_name[0] == '@')
+            ++prop_name;
+        if (strcmp(prop_name, name) == 0)
+            return mapper_snapshot_record_property_index(rec, i, 0, length,
+                                                         type, value);
+    }
+    return -1;
+}
+
+int mapper_snapshot_record_property_index(mapper_snapshot_record rec,
+                                          unsigned int index,
+                                          const char **name, int *length,
+                                          char *type, const void **value)
+{
+    if (index >= rec->num_props)
+        return -1;
+    mapper_snapshot_property prop = &rec->props[index];
+    if (name)
+        *name = prop->name;
+    if (length)
+        *length = prop->length;
+    if (type)
+        *type = prop->type;
+    if (value)
+        *value = prop->value;
+    return 0;
+}
@@ -27,6 +27,15 @@ static int compare_records(const void *l, const void *r)
     return idx_l - idx_r;
 }
 
+/* Stamps are unique across tables, so that a copy of a table taken at one
+ * stamp can be recognised as current later on. */
+static unsigned int table_stamps = 0;
+
+static void stamp_table(mapper_table tab)
+{
+    tab->stamp = __atomic_add_fetch(&table_stamps, 1, __ATOMIC_RELAXED);
+}
+
 mapper_table mapper_table_new()
 {
     mapper_table tab = (mapper_table)malloc(sizeof(mapper_table_t));
@@ -34,9 +43,24 @@ mapper_table mapper_table_new()
     tab->num_records = 0;
     tab->alloced = 1;
     tab->records = (mapper_table_record_t*)malloc(sizeof(mapper_table_record_t));
+    tab->version = 0;
+    tab->changed = 0;
+    tab->snapshot = 0;
+    stamp_table(tab);
     return tab;
 }
 
+/*! Bump the version counter the table reports changes to, if any, and note
+ *  the changed property for the database journal. */
+static void table_changed(mapper_table tab, int index)
+{
+    index = MASK_PROP_BITFLAGS(index);
+    tab->changed |= 1ULL << (index < AT_EXTRA ? index : AT_EXTRA);
+    stamp_table(tab);
+    if (tab->version)
+        ++(*tab->version);
+}
+
 void mapper_table_clear(mapper_table tab)
 {
     int i, j, free_values = 1;
@@ -65,6 +89,7 @@ void mapper_table_clear(mapper_table tab)
     tab->num_records = 0;
     tab->records = realloc(tab->records, sizeof(mapper_table_record_t));
     tab->alloced = 1;
+    stamp_table(tab);
 }
 
 void mapper_table_free(mapper_table tab)
@@ -94,6 +119,7 @@ static mapper_table_record_t *mapper_table_add(mapper_table tab,
     rec->type = type;
     rec->value = value;
     rec->flags = flags;
+    stamp_table(tab);
     return rec;
 }
 
@@ -196,6 +222,7 @@ int mapper_table_remove_record(mapper_table tab, mapper_property_t index,
                 *rec->value = 0;
             }
             rec->index |= PROPERTY_REMOVE;
+            table_changed(tab, index);
             return 1;
         }
         else {
@@ -220,6 +247,7 @@ int mapper_table_remove_record(mapper_table tab, mapper_property_t index,
     }
 
     rec->index |= PROPERTY_REMOVE;
+    table_changed(tab, index);
     return 1;
 }
 
@@ -472,6 +500,7 @@ int set_record_internal(mapper_table tab, mapper_property_t index,
             return 0;
         update_value_elements(rec, length, type, value);
         tab->dirty = 1;
+        table_changed(tab, index);
         return 1;
     }
     else {
@@ -480,6 +509,7 @@ int set_record_internal(mapper_table tab, mapper_property_t index,
         update_value_elements(rec, length, type, value);
         table_sort(tab);
         tab->dirty = 1;
+        table_changed(tab, index);
         return 1;
     }
     return 0;
@@ -714,6 +744,7 @@ int mapper_table_set_record_from_atom(mapper_table tab,
         update_value_elements_osc(rec, atom->length, atom->types, atom->values,
                                   rec->flags & INDIRECT);
         tab->dirty = 1;
+        table_changed(tab, atom->index);
         return 1;
     }
     else {
@@ -725,6 +756,7 @@ int mapper_table_set_record_from_atom(mapper_table tab,
                                   atom->values, 0);
         table_sort(tab);
         tab->dirty = 1;
+        table_changed(tab, atom->index);
         return 1;
     }
     return 0;
@@ -16,6 +16,10 @@
 
 #include <mapper/mapper_constants.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
 #define PR_MAPPER_ID PRIu64
@@ -52,6 +56,13 @@ struct _mapper_map;
 struct _mapper_id_map;
 typedef int mapper_signal_group;
 
+/*! Aliased signal paths consist of ALIAS_PREFIX followed by the decimal
+ *  alias.  Data messages sent to them use shorter keys in place of the
+ *  "@instance" and "@slot" property names. */
+#define ALIAS_PREFIX            "/@"
+#define ALIAS_INSTANCE_KEY      "@i"
+#define ALIAS_SLOT_KEY          "@s"
+
 /*! Symbolic representation of recognized properties. */
 typedef enum {
     AT_BOUND_MAX,           /* 0x00 */
@@ -92,8 +103,9 @@ typedef enum {
     AT_USE_INSTANCES,       /* 0x23 */
     AT_USER_DATA,           /* 0x24 */
     AT_VERSION,             /* 0x25 */
-    AT_EXTRA,               /* 0x26 */
-    NUM_AT_PROPERTIES       /* 0x27 */
+    AT_ALIAS,               /* 0x26 */
+    AT_EXTRA,               /* 0x27 */
+    NUM_AT_PROPERTIES       /* 0x28 */
 } mapper_property_t;
 
 /**** String tables ****/
@@ -126,6 +138,10 @@ typedef struct _mapper_table {
     int num_records;
     int alloced;
     char dirty;
+    unsigned int *version;  //!< Counter bumped on any change to the records.
+    uint64_t changed;       //!< Properties changed since last journaled.
+    unsigned int stamp;     //!< Unique stamp, renewed on any change.
+    struct _mapper_snapshot_record *snapshot; //!< Copy in latest snapshot.
 } mapper_table_t, *mapper_table;
 
 /**** Database ****/
@@ -137,24 +153,202 @@ typedef struct _fptr_list {
     struct _fptr_list *next;
 } *fptr_list;
 
+/*! A deadline in a timer heap, embedded in the object it belongs to. */
+typedef struct _mapper_timer {
+    void *item;                         //!< The object owning this timer.
+    uint32_t deadline;                  //!< Time in seconds it expires at.
+    int slot;                           //!< Heap position + 1, or 0 if unset.
+} mapper_timer_t, *mapper_timer;
+
+/*! A binary min-heap of timers, ordered by deadline. */
+typedef struct _mapper_timer_heap {
+    mapper_timer *timers;
+    int size;
+    int alloced;
+} mapper_timer_heap_t, *mapper_timer_heap;
+
 typedef struct _mapper_subscription {
     struct _mapper_subscription *next;
     mapper_device device;
     int flags;
     uint32_t lease_expiration_sec;
+    mapper_timer_t renewal;
 } *mapper_subscription;
 
+/*! An entry of a hash index, associating a key with a database record. */
+typedef struct _mapper_hash_entry {
+    struct _mapper_hash_entry *next;    //!< The next entry in this bucket.
+    uint64_t key;
+    void *item;
+} *mapper_hash_entry;
+
+/*! A hash index over the records of a database list.  Several records may
+ *  share a key, so lookups must check each record returned. */
+typedef struct _mapper_hash_index {
+    mapper_hash_entry *buckets;
+    int size;                           //!< Number of buckets.
+    int count;                          //!< Number of entries.
+} mapper_hash_index_t, *mapper_hash_index;
+
+/*! A slab of memory blocks belonging to a pool. */
+typedef struct _mapper_slab {
+    struct _mapper_slab *next;
+} *mapper_slab;
+
+#define POOL_GRANULARITY    32      //!< Size step between block classes.
+#define POOL_NUM_CLASSES    32      //!< Blocks of up to 1024 bytes are pooled.
+#define POOL_SLAB_SIZE      16384
+
+/*! Pools of fixed-size memory blocks, one free list per size class, carved
+ *  out of larger slabs.  Released blocks are recycled, and the slabs are only
+ *  freed together with the pool. */
+typedef struct _mapper_pool {
+    void *free_blocks[POOL_NUM_CLASSES];
+    mapper_slab slabs;
+    unsigned int num_allocs;            //!< Number of blocks handed out.
+    unsigned int num_mallocs;           //!< Number of calls to malloc().
+} mapper_pool_t, *mapper_pool;
+
+/*! An entry of a sorted property index. */
+typedef struct {
+    void *item;
+    const void *value;
+    char type;
+} mapper_property_index_entry_t;
+
+/*! A secondary index holding the database devices or signals with a scalar
+ *  property of a given type, sorted by value.  It is rebuilt lazily once the
+ *  records it covers have changed. */
+typedef struct {
+    char *name;                         //!< Property name, or 0 if unused.
+    char record_type;                   //!< 'd' for devices, 's' for signals.
+    char type;
+    char built;
+    unsigned int version;               //!< Record version when built.
+    unsigned int requested;             //!< Record version when last needed.
+    int count;
+    mapper_property_index_entry_t *entries;
+} mapper_property_index_t;
+
+/*! A memoized query result, valid while the record version is unchanged. */
+typedef struct {
+    char *key;                          //!< Serialized query, or 0 if unused.
+    int key_len;
+    unsigned int version;
+    int num_items;
+    void **items;
+} mapper_query_memo_t;
+
+#define PROPERTY_INDEX_CACHE_SIZE 8
+#define QUERY_MEMO_CACHE_SIZE 32
+
+#define JOURNAL_SIZE 1024
+
+/*! A block of memory holding the contents of a snapshot record. */
+typedef struct _mapper_snapshot_chunk {
+    struct _mapper_snapshot_chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} mapper_snapshot_chunk_t, *mapper_snapshot_chunk;
+
+/*! A copy of a record property held by a snapshot. */
+typedef struct {
+    const char *name;
+    const void *value;
+    int length;
+    char type;
+} mapper_snapshot_property_t, *mapper_snapshot_property;
+
+/*! A copy of a database record held by a snapshot.  Copies of records that
+ *  have not changed are shared by consecutive snapshots. */
+typedef struct _mapper_snapshot_record {
+    mapper_id id;
+    mapper_id *refs;                    //!< Ids of related records.
+    int num_refs;
+    int num_props;
+    mapper_snapshot_property props;
+    int refcount;                       //!< Number of snapshots sharing it.
+    unsigned int stamp;                 //!< Stamp of the table copied.
+    mapper_snapshot_chunk chunks;       //!< Memory holding the copy.
+} mapper_snapshot_record_t, *mapper_snapshot_record;
+
+#define NUM_SNAPSHOT_TYPES 4
+
+/*! A read-only copy of the database records, shared between threads. */
+typedef struct _mapper_snapshot {
+    struct _mapper_snapshot *next;      //!< Next retired snapshot.
+    int refcount;
+    uint32_t sequence;                  //!< Database sequence when taken.
+    unsigned int devices_version;
+    unsigned int signals_version;
+    int num_records[NUM_SNAPSHOT_TYPES];
+    mapper_snapshot_record *records[NUM_SNAPSHOT_TYPES]; //!< Sorted by id.
+} mapper_snapshot_t, *mapper_snapshot;
+
+/*! A record change waiting to be delivered while database notifications are
+ *  batched, or a removed record waiting to be freed after delivery. */
+typedef struct _mapper_change {
+    struct _mapper_change *next;
+    void *record;
+    int type;                           //!< MAPPER_OBJ_DEVICES, _SIGNALS, etc.
+    int event;                          //!< Record event, or -1 if cancelled.
+} mapper_change_t, *mapper_change;
+
 typedef struct _mapper_database {
     struct _mapper_network *network;
     mapper_device devices;              //<! List of devices.
     mapper_signal signals;              //<! List of signals.
     mapper_map maps;                    //<! List of mappings.
     mapper_link links;                  //<! List of network links.
+
+    mapper_hash_index_t devices_by_id;      //<! Devices keyed by id.
+    mapper_hash_index_t devices_by_name;    //<! Devices keyed by name hash.
+    mapper_hash_index_t signals_by_id;      //<! Signals keyed by id.
+    mapper_hash_index_t links_by_id;        //<! Links keyed by id.
+    mapper_hash_index_t maps_by_id;         //<! Maps keyed by id.
+
+    mapper_timer_heap_t device_expiries;    //<! Remote device sync timeouts.
+    mapper_timer_heap_t renewals;           //<! Subscription lease renewals.
+
+    mapper_pool_t pool;                 //<! Memory for records and queries.
+
+    /*! Bumped whenever device or signal records are added, removed or have
+     *  their properties changed, invalidating cached query results. */
+    unsigned int devices_version;
+    unsigned int signals_version;
+
+    mapper_property_index_t property_indexes[PROPERTY_INDEX_CACHE_SIZE];
+    int next_property_index;
+    mapper_query_memo_t query_memos[QUERY_MEMO_CACHE_SIZE];
+    int next_query_memo;
+
     fptr_list device_callbacks;         //<! List of device record callbacks.
     fptr_list signal_callbacks;         //<! List of signal record callbacks.
     fptr_list link_callbacks;           //<! List of link record callbacks.
     fptr_list map_callbacks;            //<! List of mapping record callbacks.
 
+    /*! Pending record changes, coalesced per record and kept in the order of
+     *  their first change until they are delivered as a batch. */
+    int batch_notifications;
+    mapper_change changes;
+    mapper_change last_change;
+    mapper_hash_index_t changes_by_record;
+    mapper_change removed;              //<! Records to free after delivery.
+    mapper_change last_removed;
+
+    /*! Ring buffer of the last JOURNAL_SIZE record changes, allocated when
+     *  the first change is recorded, and the sequence number of the last. */
+    mapper_database_change_t *journal;
+    uint32_t sequence;
+
+    /*! The last published snapshot, older snapshots that may still be in
+     *  use, and the number of readers currently acquiring a snapshot. */
+    int snapshots_enabled;
+    mapper_snapshot snapshot;
+    mapper_snapshot retired_snapshots;
+    int snapshot_readers;
+
     /*! Linked-list of autorenewing device subscriptions. */
     mapper_subscription subscriptions;
 
@@ -204,6 +398,14 @@ typedef void mapper_resource_on_lock(struct _mapper_allocated_t *resource);
 /*! Function to call when an allocated resource encounters a collision. */
 typedef void mapper_resource_on_collision(struct _mapper_allocated_t *resource);
 
+/*! A peer seen probing for, or holding, the same kind of resource. */
+typedef struct _mapper_allocation_peer_t {
+    double time;                  //!< When the peer was last heard from.
+    unsigned int value;           //!< The value probed or registered.
+    int id;                       //!< The peer's random allocation id.
+    int registered;               //!< Non-zero if the value is locked.
+} mapper_allocation_peer_t, *mapper_allocation_peer;
+
 /*! Allocated resources */
 typedef struct _mapper_allocated_t {
     double count_time;            /*!< The last time at which the
@@ -222,6 +424,17 @@ typedef struct _mapper_allocated_t {
                                    *   detected for this resource. */
     int locked;                   /*!< Whether or not the value has
                                    *   been locked in (allocated). */
+    int fast;                     /*!< Non-zero to use short, adaptive
+                                   *   probe windows. */
+    int pinned;                   /*!< Non-zero while the value was
+                                   *   chosen by the caller. */
+    int rounds;                   /*!< Number of fast probes that ended
+                                   *   in a collision. */
+
+    mapper_allocation_peer peers; /*!< Peers probing or holding values
+                                   *   while this one is unlocked. */
+    int num_peers;
+    int peers_alloced;
 } mapper_allocated_t, *mapper_allocated;
 
 /*! Clock and timing information. */
@@ -276,6 +489,12 @@ typedef struct _mapper_network {
                                      *  and should be freed by
                                      *  mapper_network_free(). */
     uint8_t database_methods_added;
+
+#ifdef HAVE_PTHREAD
+    /*! Recursive lock serializing access to the network and its database
+     *  while devices are serviced by background I/O threads. */
+    pthread_mutex_t lock;
+#endif
 } mapper_network_t;
 
 /*! The handle to this device is a pointer. */
@@ -295,6 +514,10 @@ typedef struct _mapper_history
     void *value;                /*!< Value of the signal for each sample of
                                  *   stored history. */
     mapper_timetag_t *timetag;  //!< Timetag for each sample of stored history.
+    unsigned int *sample_generation; /*!< Reset generation in which each
+                                      *   sample was last written. */
+    unsigned int generation;    /*!< Current reset generation, samples from
+                                 *   older generations read as zero. */
     int length;                 //!< Vector length.
     int position;               //!< Current position in the circular buffer.
     char size;                  //!< History size of the buffer.
@@ -318,6 +541,8 @@ typedef struct _mapper_signal_instance
     mapper_timetag_t timetag;   //!< The timetag for the current value.
 
     int index;                  //!< Index for accessing value history.
+    mapper_history_t interp_history;    /*!< Recent samples kept for
+                                         *   interpolation, if enabled. */
     uint8_t has_value;          //!< Indicates whether this instance has a value.
     uint8_t is_active;          //!< Status of this instance.
 } mapper_signal_instance_t, *mapper_signal_instance;
@@ -329,8 +554,30 @@ typedef struct _mapper_signal_id_map
     int status;                                 /*!< Either 0 or a combination of
                                                  *  MAPPER_RELEASED_LOCALLY and
                                                  MAPPER_RELEASED_REMOTELY. */
+    int next_by_global;                         /*!< Index of next id map in the
+                                                 *   same global id bucket. */
+    int prev_active;                            /*!< Index of the next older
+                                                 *   active instance, or -1. */
+    int next_active;                            /*!< Index of the next newer
+                                                 *   active instance, or -1. */
 } mapper_signal_id_map_t;
 
+/*! Argument layout of a data message, cached per signal by typetag so that
+ *  messages of a known shape need not be parsed again. */
+typedef struct _mapper_message_shape {
+    char *types;                    //!< Typetag string, or 0 if unused.
+    int value_len;                  //!< Number of value arguments.
+    int nulls;                      //!< Number of null values.
+    int instance_arg;               //!< Index of the instance id, or -1.
+    int slot_arg;                   //!< Index of the slot number, or -1.
+    int count;                      //!< Number of samples, or 0 if unknown.
+    int slot_index;                 //!< Slot number of the cached slot.
+    struct _mapper_slot *slot;      //!< Slot last found for slot_index.
+    unsigned int router_version;    //!< Router version when slot was found.
+} mapper_message_shape_t, *mapper_message_shape;
+
+#define MESSAGE_SHAPE_CACHE_SIZE 4
+
 typedef struct _mapper_local_signal
 {
     /*! The device associated with this signal. */
@@ -340,6 +587,22 @@ typedef struct _mapper_local_signal
     struct _mapper_signal_id_map *id_maps;
     int id_map_length;
 
+    /*! Hash buckets of id_maps indexes keyed by global id, or -1 if empty. */
+    int *id_maps_by_global;
+
+    /*! Index of an unused entry of id_maps, or -1 if all are in use.
+     *  Unused entries are linked through their next_by_global index. */
+    int free_id_map;
+
+    /*! Limit on the number of instances and id maps, set when the signal is
+     *  created from the number of instances it reserves. */
+    int max_instances;
+
+    /*! Indexes of the oldest and newest active instances in id_maps, or -1.
+     *  Active instances are linked in order of activation. */
+    int oldest_active;
+    int newest_active;
+
     /*! Array of pointers to the signal instances. */
     struct _mapper_signal_instance **instances;
 
@@ -359,6 +622,31 @@ typedef struct _mapper_local_signal
     /*! Flags for deciding when to call the instance event handler. */
     int instance_event_flags;
 
+    /*! Jitter buffer latency in seconds, or 0 to apply updates on receipt. */
+    double jitter_latency;
+    int jitter_size;                //!< Maximum number of held messages.
+    int jitter_pending;             //!< Number of messages currently held.
+    unsigned int jitter_late;       //!< Messages received after release time.
+    unsigned int jitter_dropped;    //!< Messages dropped when buffer was full.
+
+    /*! Interpolation applied when values are requested between samples. */
+    mapper_interpolation_type interpolation;
+
+    /*! Non-zero to discard messages older than the last applied update. */
+    int discard_out_of_order;
+    unsigned int num_discarded;     //!< Out-of-order messages discarded.
+
+    /*! Short OSC path alias offered to the sources of incoming maps, or 0 if
+     *  none has been assigned. */
+    int alias;
+
+    /*! Non-zero if messages addressed to this signal are dispatched to it. */
+    int has_methods;
+
+    /*! Recently seen data message layouts, replaced round-robin. */
+    mapper_message_shape_t shapes[MESSAGE_SHAPE_CACHE_SIZE];
+    int next_shape;
+
     mapper_signal_group group;
 } mapper_local_signal_t, *mapper_local_signal;
 
@@ -389,8 +677,19 @@ struct _mapper_signal {
     int version;
     char type;          /*! The type of this signal, specified as an OSC type
                          *  character. */
+
+    struct _mapper_signal *next_by_name;    //!< Next signal in name bucket.
+    struct _mapper_signal *next_by_id;      //!< Next signal in id bucket.
 };
 
+/*! Hash indexes over the signals of a device. */
+typedef struct _mapper_signal_index {
+    struct _mapper_signal **by_name;    //!< Buckets keyed by signal name.
+    struct _mapper_signal **by_id;      //!< Buckets keyed by signal id.
+    int size;                           //!< Number of buckets.
+    int count;                          //!< Number of indexed signals.
+} mapper_signal_index_t;
+
 /**** Router ****/
 
 typedef struct _mapper_queue {
@@ -409,6 +708,10 @@ typedef struct _mapper_local_link {
     mapper_queue queues;                /*!< Linked-list of message queues
                                          *   waiting to be sent. */
     mapper_sync_clock_t clock;
+    void *udp_sockaddr;                 /*!< Resolved socket address of
+                                         *   udp_data_addr, used for sending
+                                         *   batched bundles. */
+    int udp_sockaddr_len;
 } *mapper_local_link;
 
 typedef struct _mapper_link {
@@ -487,6 +790,11 @@ typedef struct _mapper_local_map {
 
     uint8_t is_local_only;
     uint8_t one_source;
+
+    /*! Alias of the destination signal offered by a remote destination, or 0
+     *  to send updates to the full signal path. */
+    int alias;
+    char alias_path[16];
 } mapper_local_map_t, *mapper_local_map;
 
 /*! A record that describes the properties of a mapping.
@@ -537,12 +845,16 @@ typedef struct _mapper_router_signal {
 typedef struct _mapper_router {
     struct _mapper_device *device;  //!< The device associated with this link.
     mapper_router_signal signals;   //!< The list of mappings for each signal.
+    unsigned int version;           /*!< Incremented whenever maps or slots are
+                                     *   added or removed. */
 } mapper_router_t, *mapper_router;
 
 /*! The instance ID map is a linked list of int32 instance ids for coordinating
  *  remote and local instances. */
 typedef struct _mapper_id_map {
     struct _mapper_id_map *next;    //!< The next id map in the list.
+    struct _mapper_id_map *next_by_local;   //!< Next map in local id bucket.
+    struct _mapper_id_map *next_by_global;  //!< Next map in global id bucket.
 
     mapper_id global;               //!< Hash for originating device.
     mapper_id local;                //!< Local instance id to map.
@@ -550,8 +862,81 @@ typedef struct _mapper_id_map {
     int refcount_global;
 } mapper_id_map_t, *mapper_id_map;
 
+/*! Hash indexes over the active instance id maps of a signal group. */
+typedef struct _mapper_id_map_index {
+    struct _mapper_id_map **by_local;   //!< Buckets keyed by local id.
+    struct _mapper_id_map **by_global;  //!< Buckets keyed by global id.
+    int size;                           //!< Number of buckets.
+    int count;                          //!< Number of indexed id maps.
+} mapper_id_map_index_t, *mapper_id_map_index;
+
 /**** Device ****/
 
+/* Kinds of signal updates that can be handed off through a device update
+ * queue. */
+#define QUEUED_UPDATE           0
+#define QUEUED_INSTANCE_UPDATE  1
+#define QUEUED_INSTANCE_RELEASE 2
+
+/*! One entry of a device update queue.  The sequence number is used to pass
+ *  ownership of the entry between producers and the consumer. */
+typedef struct _mapper_queued_update {
+    unsigned int sequence;
+    int type;                       //!< One of the QUEUED_* values above.
+    struct _mapper_signal *signal;
+    mapper_id id;                   //!< Local instance id.
+    mapper_timetag_t timetag;
+    int count;                      //!< Number of samples, or 0 for no value.
+    void *value;                    //!< Preallocated sample storage.
+} mapper_queued_update_t, *mapper_queued_update;
+
+/* Keep the producer and consumer positions of the update queue on separate
+ * cache lines. */
+#define QUEUE_PADDING 64
+
+/*! A bounded lock-free ring of signal updates, filled by any thread updating
+ *  signals and drained by the thread polling the device. */
+typedef struct _mapper_update_queue {
+    mapper_queued_update_t *entries;
+    char *values;                   //!< Sample storage for all entries.
+    unsigned int mask;              //!< Number of entries minus one.
+    mapper_overflow_policy policy;
+    char pad0[QUEUE_PADDING];
+    unsigned int enqueue_pos;
+    char pad1[QUEUE_PADDING];
+    unsigned int dequeue_pos;
+    char pad2[QUEUE_PADDING];
+    unsigned int overflows;
+    unsigned int wake_pending;      //!< Set once the consumer has been woken.
+} mapper_update_queue_t, *mapper_update_queue;
+
+/*! An incoming signal message held back until its scheduled release time. */
+typedef struct _mapper_scheduled_message {
+    uint64_t release;               //!< Local NTP time as (sec << 32 | frac).
+    struct _mapper_signal *signal;
+    lo_message msg;
+} mapper_scheduled_message_t, *mapper_scheduled_message;
+
+/*! Binary min-heap of scheduled signal messages ordered by release time. */
+typedef struct _mapper_jitter_buffer {
+    mapper_scheduled_message_t *entries;
+    int size;
+    int capacity;
+    lo_message releasing;           //!< Message currently being delivered.
+} mapper_jitter_buffer_t, *mapper_jitter_buffer;
+
+/*! Receive budget and statistics of mapper_device_poll(). */
+typedef struct _mapper_poll_stats {
+    int budget_us;                  /*!< Time allowed for handling waiting
+                                     *   messages at the end of a poll, or 0
+                                     *   for no limit. */
+    int budget;                     /*!< Adaptive limit on the number of
+                                     *   waiting messages handled. */
+    double msgs;                    //!< Moving average of messages per poll.
+    double usec;                    //!< Moving average of draining time.
+    int backlog;                    //!< Estimated messages left waiting.
+} mapper_poll_stats_t;
+
 typedef struct _mapper_local_device {
     mapper_allocated_t ordinal;     /*!< A unique ordinal for this device
                                      *   instance. */
@@ -572,6 +957,9 @@ typedef struct _mapper_local_device {
     /*! The list of active instance id maps. */
     struct _mapper_id_map **active_id_maps;
 
+    /*! Hash indexes over active_id_maps, one per signal group. */
+    mapper_id_map_index_t *active_id_map_index;
+
     /*! The list of reserve instance id maps. */
     struct _mapper_id_map *reserve_id_maps;
 
@@ -585,6 +973,37 @@ typedef struct _mapper_local_device {
 
     int own_network;
     int num_signal_groups;
+
+    /*! Optional queue of updates handed off by other threads. */
+    mapper_update_queue update_queue;
+
+    /*! Incoming signal messages waiting for their release time. */
+    mapper_jitter_buffer_t jitter_buffer;
+
+    int epoll_fd;                   /*!< Event descriptor covering the servers,
+                                     *   or -1 if not created. */
+    int wake_fd;                    /*!< Signalled by threads queuing updates,
+                                     *   or -1 if not created. */
+
+    mapper_poll_stats_t poll_stats;
+
+    /*! Signals indexed by their path alias minus one. */
+    mapper_signal *aliases;
+    int num_aliases;
+
+    /*! Buffers for exchanging several datagrams per system call on the UDP
+     *  server, or 0 if not yet used. */
+    struct _mapper_udp_batch *udp_batch;
+
+    /*! Incoming TCP connections, if accepted by the device rather than by
+     *  liblo, or 0. */
+    struct _mapper_tcp_server *tcp;
+
+#ifdef HAVE_PTHREAD
+    pthread_t thread;               //!< Background I/O thread, if running.
+#endif
+    int thread_running;             /*!< Non-zero while a background I/O
+                                     *   thread services this device. */
 } mapper_local_device_t, *mapper_local_device;
 
 
@@ -605,6 +1024,9 @@ struct _mapper_device {
 
     mapper_timetag_t synced;    //!< Timestamp of last sync.
 
+    /*! Hash indexes over the signals belonging to this device. */
+    mapper_signal_index_t signal_index;
+
     int ordinal;
     int num_inputs;             //!< Number of associated input signals.
     int num_outputs;            //!< Number of associated output signals.
@@ -613,6 +1035,8 @@ struct _mapper_device {
     int num_outgoing_maps;      //!< Number of associated outgoing maps.
     int version;                //!< Reported device state version.
     int status;
+    uint32_t expiry_journaled;  //!< Sync time of last journaled expiry.
+    mapper_timer_t expiry;      //!< Deadline for the next sync.
 
     uint8_t subscribed;
 };
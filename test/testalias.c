@@ -0,0 +1,234 @@
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <lo/lo.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+mapper_map srcmap = 0;
+
+int sent = 0;
+int received = 0;
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        eprintf("handler: Got %d\n", (*(int*)value));
+    }
+    received++;
+}
+
+int setup_devices()
+{
+    int mn = 0, mx = 100;
+
+    source = mapper_device_new("testalias-send", 0, 0);
+    destination = mapper_device_new("testalias-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'i', 0,
+                                              &mn, &mx);
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'i', 0,
+                                             &mn, &mx, insig_handler, 0);
+    return !sendsig || !recvsig;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 25);
+        mapper_device_poll(destination, 25);
+    }
+}
+
+int setup_map()
+{
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // Wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+    return done;
+}
+
+/*! Send a number of updates and return how many of them arrived. */
+int send_updates(int num)
+{
+    int i, before = received;
+    for (i = 0; i < num && !done; i++) {
+        mapper_signal_update_int(sendsig, sent);
+        sent++;
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 50);
+    }
+    // collect any updates still in flight
+    mapper_device_poll(destination, 50);
+    return received - before;
+}
+
+/*! Send the source a "/mapped" message for the map, as the destination does,
+ *  offering a different alias. Returns 0 once the source has adopted it. */
+int offer_alias(int alias)
+{
+    char src_name[256], dest_name[256], port[16];
+    int i;
+
+    snprintf(src_name, 256, "%s%s", mapper_device_name(source),
+             sendsig->path);
+    snprintf(dest_name, 256, "%s%s", mapper_device_name(destination),
+             recvsig->path);
+    snprintf(port, 16, "%d",
+             lo_server_get_port(source->database->network->mesh_server));
+
+    lo_address addr = lo_address_new("localhost", port);
+    lo_message msg = lo_message_new();
+    lo_message_add_string(msg, dest_name);
+    lo_message_add_string(msg, "<-");
+    lo_message_add_string(msg, src_name);
+    lo_message_add_string(msg, "@id");
+    lo_message_add_int64(msg, srcmap->id);
+    lo_message_add_string(msg, "@alias");
+    lo_message_add_int32(msg, alias);
+    lo_send_message(addr, "/mapped", msg);
+    lo_message_free(msg);
+    lo_address_free(addr);
+
+    for (i = 0; i < 40 && !done && srcmap->local->alias != alias; i++)
+        mapper_device_poll(source, 25);
+    return srcmap->local->alias != alias;
+}
+
+int test_alias()
+{
+    int alias;
+
+    // the alias is held by the source's own record of the map
+    mapper_map *maps = mapper_signal_maps(sendsig, MAPPER_DIR_OUTGOING);
+    srcmap = maps ? *maps : 0;
+    mapper_map_query_done(maps);
+    alias = srcmap && srcmap->local ? srcmap->local->alias : 0;
+    if (alias < 1) {
+        eprintf("Source was not offered an alias for '%s'.\n",
+                recvsig->path);
+        return 1;
+    }
+    eprintf("Sending to alias '%s' for '%s'.\n", srcmap->local->alias_path,
+            recvsig->path);
+    if (send_updates(10) != 10) {
+        eprintf("Updates sent to the alias were lost.\n");
+        return 1;
+    }
+
+    // the destination does not know this alias, so aliased updates are dropped
+    if (offer_alias(alias + 100)) {
+        eprintf("Source did not adopt the new alias.\n");
+        return 1;
+    }
+    if (send_updates(5) != 0) {
+        eprintf("Updates did not use the alias path.\n");
+        return 1;
+    }
+
+    // an alias of 0 withdraws it, and only the full path delivers updates
+    if (offer_alias(0)) {
+        eprintf("Alias was not withdrawn.\n");
+        return 1;
+    }
+    eprintf("Alias withdrawn, sending to '%s'.\n", recvsig->path);
+    if (send_updates(10) != 10) {
+        eprintf("Updates sent to the full path were lost.\n");
+        return 1;
+    }
+    return 0;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -q quiet, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testalias.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_map()) {
+        eprintf("Error initializing map.\n");
+        result = 1;
+        goto done;
+    }
+
+    result = test_alias();
+
+  done:
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
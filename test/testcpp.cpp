@@ -188,6 +188,13 @@ int main(int argc, char ** argv)
         sig.update(v);
     }
 
+    // update and release several instances at once
+    std::vector <mapper_id> ids = {1, 2};
+    std::vector <double> vals = {1., 2., 3., 4., 5., 6.};
+    sig.update_instances(ids, vals);
+    dev.poll(10);
+    sig.release_instances(ids);
+
     // try combining queries
     mapper::Device::Query qdev = db.devices("my*");
     qdev += db.devices(mapper::Property("num_inputs", 4),
@@ -1,6 +1,8 @@
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <lo/lo_lowlevel.h>
 #include "../src/mapper_internal.h"
 
@@ -35,6 +37,926 @@ void printmap(mapper_map map)
         mapper_map_print(map);
 }
 
+/* Parse a property message holding only an id.  The returned message refers
+ * to the arguments of lom, which must be freed after it. */
+mapper_message parse_id_message(lo_message *lom, uint64_t id)
+{
+    if (!(*lom = lo_message_new()))
+        return 0;
+    lo_message_add_string(*lom, "@id");
+    lo_message_add_int64(*lom, id);
+    return mapper_message_parse_properties(lo_message_get_argc(*lom),
+                                           lo_message_get_types(*lom),
+                                           lo_message_get_argv(*lom));
+}
+
+int batched_events[4];
+int batched_bad_records;
+
+void on_batched_device(mapper_database db, mapper_device dev,
+                       mapper_record_event event, const void *user)
+{
+    ++batched_events[event];
+    // removed records must still be readable when the batch is delivered
+    if (!dev->name || strncmp(dev->name, "batch.", 6))
+        ++batched_bad_records;
+}
+
+void on_batched_signal(mapper_database db, mapper_signal sig,
+                       mapper_record_event event, const void *user)
+{
+    ++batched_events[event];
+    if (!sig->name || !sig->device || !sig->device->name)
+        ++batched_bad_records;
+}
+
+/* Update a device record with a new host property. */
+void set_device_host(mapper_database db, const char *name, const char *host)
+{
+    lo_message lom = lo_message_new();
+    mapper_message msg;
+    lo_message_add_string(lom, "@host");
+    lo_message_add_string(lom, host);
+    msg = mapper_message_parse_properties(lo_message_get_argc(lom),
+                                          lo_message_get_types(lom),
+                                          lo_message_get_argv(lom));
+    mapper_database_add_or_update_device(db, name, msg);
+    mapper_message_free(msg);
+    lo_message_free(lom);
+}
+
+/* Check that batched record changes are coalesced and delivered together. */
+int check_batch(mapper_database db, int expected, int added, int modified,
+                int removed)
+{
+    int count;
+    if (batched_events[MAPPER_ADDED] || batched_events[MAPPER_MODIFIED]
+        || batched_events[MAPPER_REMOVED]) {
+        eprintf("Record callbacks were called before delivery.\n");
+        return 1;
+    }
+    count = mapper_database_deliver_notifications(db);
+    eprintf("  delivered %d changes: %d added, %d modified, %d removed\n",
+            count, batched_events[MAPPER_ADDED],
+            batched_events[MAPPER_MODIFIED], batched_events[MAPPER_REMOVED]);
+    if (count != expected || batched_events[MAPPER_ADDED] != added
+        || batched_events[MAPPER_MODIFIED] != modified
+        || batched_events[MAPPER_REMOVED] != removed || batched_bad_records)
+        return 1;
+    memset(batched_events, 0, sizeof(batched_events));
+    return 0;
+}
+
+int test_batch_notifications(mapper_database db)
+{
+    int i, result = 0, num_signals = 20;
+    char name[64];
+    mapper_device dev;
+
+    mapper_database_add_device_callback(db, on_batched_device, 0);
+    mapper_database_add_signal_callback(db, on_batched_signal, 0);
+    mapper_database_set_batch_notifications(db, 1);
+    memset(batched_events, 0, sizeof(batched_events));
+    batched_bad_records = 0;
+
+    // added and modified records are reported once as added
+    for (i = 0; i < num_signals; i++) {
+        snprintf(name, 64, "out%d", i);
+        mapper_database_add_or_update_signal(db, name, "batch.1", 0);
+    }
+    set_device_host(db, "batch.1", "host1");
+
+    // added and removed records are not reported
+    for (i = 0; i < 5; i++) {
+        snprintf(name, 64, "in%d", i);
+        mapper_database_add_or_update_signal(db, name, "batch.2", 0);
+    }
+    dev = mapper_database_device_by_name(db, "batch.2");
+    mapper_database_remove_device(db, dev, MAPPER_REMOVED, 0);
+
+    if (check_batch(db, num_signals + 1, num_signals + 1, 0, 0)) {
+        result = 1;
+        goto done;
+    }
+
+    // modified records are reported once, and as removed if they are removed
+    set_device_host(db, "batch.1", "host2");
+    set_device_host(db, "batch.1", "host3");
+    if (check_batch(db, 1, 0, 1, 0)) {
+        result = 1;
+        goto done;
+    }
+    set_device_host(db, "batch.1", "host4");
+    dev = mapper_database_device_by_name(db, "batch.1");
+    mapper_database_remove_device(db, dev, MAPPER_REMOVED, 0);
+    if (check_batch(db, num_signals + 1, 0, 0, num_signals + 1))
+        result = 1;
+
+  done:
+    mapper_database_set_batch_notifications(db, 0);
+    mapper_database_remove_device_callback(db, on_batched_device, 0);
+    mapper_database_remove_signal_callback(db, on_batched_signal, 0);
+    return result;
+}
+
+/* Remove a local signal with active instances while notifications are
+ * batched, then free its device before the batch is delivered.  The signal
+ * must let go of its instances and of the device straight away. */
+int test_batched_signal_removal()
+{
+    int i, value = 1, num_inst = 4;
+    mapper_device dev = mapper_device_new("batchremove", 0, 0);
+    if (!dev)
+        return 1;
+    mapper_database_set_batch_notifications(mapper_device_database(dev), 1);
+
+    mapper_signal sig = mapper_device_add_output_signal(dev, "out", 1, 'i', 0,
+                                                        0, 0);
+    mapper_signal_reserve_instances(sig, num_inst, 0, 0);
+    for (i = 0; i < num_inst; i++)
+        mapper_signal_instance_update(sig, i, &value, 1, MAPPER_NOW);
+    if (mapper_signal_num_active_instances(sig) != num_inst) {
+        eprintf("Expected %d active instances.\n", num_inst);
+        mapper_device_free(dev);
+        return 1;
+    }
+
+    mapper_device_remove_signal(dev, sig);
+    mapper_device_free(dev);
+    return 0;
+}
+
+/* Check that record changes are journaled in order, and that readers who
+ * have fallen behind the journal are told to resynchronise. */
+int test_change_journal(mapper_database db)
+{
+    int i, count;
+    char host[16];
+    mapper_database_change_t changes[8];
+    uint32_t start = mapper_database_sequence(db);
+    mapper_device dev;
+
+    for (i = 0; i < 3; i++) {
+        snprintf(host, 16, "out%d", i);
+        mapper_database_add_or_update_signal(db, host, "journal.1", 0);
+    }
+    set_device_host(db, "journal.1", "host1");
+    dev = mapper_database_device_by_name(db, "journal.1");
+
+    count = mapper_database_changes_since(db, start, changes, 8);
+    if (count != 5 || mapper_database_sequence(db) != start + 5) {
+        eprintf("Expected 5 journaled changes, found %d.\n", count);
+        return 1;
+    }
+    for (i = 0; i < count; i++) {
+        if (changes[i].sequence != start + i + 1) {
+            eprintf("Journaled changes are out of sequence.\n");
+            return 1;
+        }
+    }
+    if (changes[0].type != MAPPER_OBJ_DEVICES || changes[0].id != dev->id
+        || changes[0].event != MAPPER_ADDED
+        || changes[1].type != MAPPER_OBJ_SIGNALS
+        || changes[4].event != MAPPER_MODIFIED
+        || changes[4].properties != mapper_database_property_mask("host")) {
+        eprintf("Journaled changes do not match the records.\n");
+        return 1;
+    }
+
+    // reading can continue from any point in the journal
+    count = mapper_database_changes_since(db, start + 3, changes, 1);
+    if (count != 1 || changes[0].sequence != start + 4) {
+        eprintf("Partial journal read failed.\n");
+        return 1;
+    }
+
+    // fall behind the journal
+    for (i = 0; i < 1100; i++) {
+        snprintf(host, 16, "host%d", i + 2);
+        set_device_host(db, "journal.1", host);
+    }
+    mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    if (mapper_database_changes_since(db, start, changes, 8) != -1) {
+        eprintf("Reader behind the journal was not told to resync.\n");
+        return 1;
+    }
+    count = mapper_database_changes_since(db, mapper_database_sequence(db) - 4,
+                                          changes, 8);
+    if (count != 4 || changes[3].type != MAPPER_OBJ_DEVICES
+        || changes[3].event != MAPPER_REMOVED) {
+        eprintf("Expected removal of the device to be journaled last.\n");
+        return 1;
+    }
+    if (mapper_database_changes_since(db, mapper_database_sequence(db) + 1,
+                                      changes, 8) != -1) {
+        eprintf("Reader ahead of the journal was not told to resync.\n");
+        return 1;
+    }
+    eprintf("  journaled %u changes\n", mapper_database_sequence(db) - start);
+    return 0;
+}
+
+int expired_devices;
+
+void on_expired_device(mapper_database db, mapper_device dev,
+                       mapper_record_event event, const void *user)
+{
+    if (event == MAPPER_EXPIRED && strncmp(dev->name, "expiry.", 7) == 0)
+        ++expired_devices;
+}
+
+/* Check that timers leave the heap in order of their deadlines, and that
+ * devices expire once when their sync deadline has passed. */
+int test_timer_heap(mapper_database db)
+{
+    int i, count = 0, num_timers = 1000, num_devices = 100;
+    char name[64];
+    uint32_t last = 0, base;
+    mapper_timer_heap_t heap = {0, 0, 0};
+    mapper_timer_t *timers = calloc(num_timers, sizeof(mapper_timer_t));
+    mapper_timer timer;
+    mapper_device dev;
+    mapper_timetag_t tt;
+
+    for (i = 0; i < num_timers; i++)
+        mapper_timer_heap_set(&heap, &timers[i], &timers[i], rand() % 10000);
+    for (i = 0; i < num_timers; i += 2)
+        mapper_timer_heap_set(&heap, &timers[i], &timers[i], rand() % 10000);
+    for (i = 0; i < num_timers; i += 5)
+        mapper_timer_heap_remove(&heap, &timers[i]);
+    while ((timer = mapper_timer_heap_expired(&heap, 10000))) {
+        if (timer->deadline < last || timer->slot) {
+            eprintf("Timer heap returned timers out of order.\n");
+            return 1;
+        }
+        last = timer->deadline;
+        ++count;
+    }
+    mapper_timer_heap_free(&heap);
+    free(timers);
+    if (count != num_timers - num_timers / 5) {
+        eprintf("Expected %d timers, found %d.\n",
+                num_timers - num_timers / 5, count);
+        return 1;
+    }
+
+    // devices synced in the future, one second apart
+    mapper_timetag_now(&tt);
+    base = tt.sec + 1000;
+    for (i = 0; i < num_devices; i++) {
+        snprintf(name, 64, "expiry.%d", i + 1);
+        dev = mapper_database_add_or_update_device(db, name, 0);
+        dev->synced.sec = base + i;
+        mapper_database_device_synced(db, dev);
+    }
+
+    expired_devices = 0;
+    mapper_database_add_device_callback(db, on_expired_device, 0);
+    base += db->timeout_sec;
+    mapper_database_check_device_status(db, base + num_devices / 2);
+    count = expired_devices;
+    mapper_database_check_device_status(db, base + num_devices / 2);
+    if (count != num_devices / 2 || expired_devices != count) {
+        eprintf("Expected %d devices to expire once, found %d then %d.\n",
+                num_devices / 2, count, expired_devices - count);
+        return 1;
+    }
+    mapper_database_check_device_status(db, base + num_devices);
+    mapper_database_remove_device_callback(db, on_expired_device, 0);
+    if (expired_devices != num_devices) {
+        eprintf("Expected %d devices to expire, found %d.\n", num_devices,
+                expired_devices);
+        return 1;
+    }
+
+    for (i = 0; i < num_devices; i++) {
+        snprintf(name, 64, "expiry.%d", i + 1);
+        dev = mapper_database_device_by_name(db, name);
+        mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    }
+    return 0;
+}
+
+int reading_snapshots;
+int snapshots_read;
+int inconsistent_snapshots;
+
+/* Check that every signal in a snapshot belongs to a device in it, and that
+ * the devices added by test_snapshots() have as many signals as their
+ * num_outputs property says. */
+int check_snapshot(mapper_snapshot snap)
+{
+    int i, j, length, count, *num_outputs;
+    char type;
+    const char *name;
+    mapper_snapshot_record dev, sig;
+    int num_devs = mapper_snapshot_num_records(snap, MAPPER_OBJ_DEVICES);
+    int num_sigs = mapper_snapshot_num_records(snap, MAPPER_OBJ_SIGNALS);
+
+    for (i = 0; i < num_sigs; i++) {
+        sig = mapper_snapshot_record_by_index(snap, MAPPER_OBJ_SIGNALS, i);
+        if (!mapper_snapshot_record_by_id(snap, MAPPER_OBJ_DEVICES,
+                                          mapper_snapshot_record_ref(sig, 0)))
+            return 1;
+    }
+    for (i = 0; i < num_devs; i++) {
+        dev = mapper_snapshot_record_by_index(snap, MAPPER_OBJ_DEVICES, i);
+        if (mapper_snapshot_record_property(dev, "name", &length, &type,
+                                            (const void**)&name))
+            return 1;
+        if (strncmp(name, "snapshot.", 9))
+            continue;
+        if (mapper_snapshot_record_property(dev, "num_outputs", &length,
+                                            &type, (const void**)&num_outputs)
+            || type != 'i')
+            return 1;
+        count = 0;
+        for (j = 0; j < num_sigs; j++) {
+            sig = mapper_snapshot_record_by_index(snap, MAPPER_OBJ_SIGNALS, j);
+            if (mapper_snapshot_record_ref(sig, 0)
+                == mapper_snapshot_record_id(dev))
+                ++count;
+        }
+        if (count != *num_outputs)
+            return 1;
+    }
+    return 0;
+}
+
+void *snapshot_reader(void *arg)
+{
+    mapper_database db = (mapper_database)arg;
+    mapper_snapshot snap;
+    uint32_t last = 0;
+    while (__atomic_load_n(&reading_snapshots, __ATOMIC_ACQUIRE)) {
+        if (!(snap = mapper_database_snapshot(db)))
+            continue;
+        if (mapper_snapshot_sequence(snap) != last) {
+            last = mapper_snapshot_sequence(snap);
+            if (check_snapshot(snap))
+                ++inconsistent_snapshots;
+            ++snapshots_read;
+        }
+        mapper_snapshot_release(snap);
+    }
+    return 0;
+}
+
+/* Change one device and check that the next snapshot copies only its record,
+ * sharing the others with the previous snapshot. */
+int check_shared_records(mapper_database db, mapper_snapshot snap,
+                         mapper_device dev)
+{
+    int i, j, k, length, shared = 0, num_records = 0;
+    char type;
+    const char *host;
+    mapper_snapshot next;
+    mapper_snapshot_record rec;
+    mapper_object_type types[] = {MAPPER_OBJ_DEVICES, MAPPER_OBJ_SIGNALS,
+                                  MAPPER_OBJ_LINKS, MAPPER_OBJ_MAPS};
+
+    set_device_host(db, mapper_device_name(dev), "snapshot.host");
+    mapper_database_publish_snapshot(db);
+    if (!(next = mapper_database_snapshot(db)) || next == snap) {
+        eprintf("No snapshot was published for a changed device.\n");
+        mapper_snapshot_release(next);
+        return 1;
+    }
+    // records such as links may share an id, so compare with all of them
+    for (i = 0; i < 4; i++) {
+        num_records += mapper_snapshot_num_records(next, types[i]);
+        for (j = 0; j < mapper_snapshot_num_records(next, types[i]); j++) {
+            rec = mapper_snapshot_record_by_index(next, types[i], j);
+            for (k = 0; k < mapper_snapshot_num_records(snap, types[i]); k++) {
+                if (rec == mapper_snapshot_record_by_index(snap, types[i], k))
+                    ++shared;
+            }
+        }
+    }
+    rec = mapper_snapshot_record_by_id(next, MAPPER_OBJ_DEVICES, dev->id);
+    if (!rec || mapper_snapshot_record_property(rec, "host", &length, &type,
+                                                (const void**)&host)
+        || strcmp(host, "snapshot.host")) {
+        eprintf("Snapshot does not hold the changed device.\n");
+        mapper_snapshot_release(next);
+        return 1;
+    }
+    mapper_snapshot_release(next);
+    eprintf("  snapshot shared %d of %d records\n", shared, num_records);
+    if (shared != num_records - 1) {
+        eprintf("Expected all records but the changed device to be shared.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Add and remove devices with output signals while another thread reads
+ * the published snapshots. */
+int test_snapshots(mapper_database db)
+{
+    int i, j, result = 0, rounds = 200, signals_per_device = 10;
+    char name[64];
+    const char *dev_name;
+    int length;
+    char type;
+    pthread_t thread;
+    mapper_device dev;
+    mapper_snapshot snap;
+    mapper_snapshot_record rec;
+
+    mapper_database_set_snapshots(db, 1);
+    snap = mapper_database_snapshot(db);
+    dev = mapper_database_device_by_name(db, "testdatabase.1");
+    rec = snap ? mapper_snapshot_record_by_id(snap, MAPPER_OBJ_DEVICES,
+                                              dev->id) : 0;
+    if (!rec || mapper_snapshot_num_records(snap, MAPPER_OBJ_DEVICES)
+                != mapper_database_num_devices(db)
+        || mapper_snapshot_record_property(rec, "name", &length, &type,
+                                           (const void**)&dev_name)
+        || type != 's' || strcmp(dev_name, "testdatabase.1")) {
+        eprintf("Snapshot does not match the database.\n");
+        mapper_snapshot_release(snap);
+        mapper_database_set_snapshots(db, 0);
+        return 1;
+    }
+
+    if (check_shared_records(db, snap, dev)) {
+        mapper_snapshot_release(snap);
+        mapper_database_set_snapshots(db, 0);
+        return 1;
+    }
+
+    reading_snapshots = 1;
+    if (pthread_create(&thread, 0, snapshot_reader, db)) {
+        eprintf("Error creating snapshot reader thread.\n");
+        mapper_snapshot_release(snap);
+        mapper_database_set_snapshots(db, 0);
+        return 1;
+    }
+    for (i = 0; i < rounds; i++) {
+        for (j = 0; j < signals_per_device; j++) {
+            snprintf(name, 64, "out%d", j);
+            mapper_database_add_or_update_signal(db, name, "snapshot.1", 0);
+        }
+        dev = mapper_database_device_by_name(db, "snapshot.1");
+        dev->num_outputs = signals_per_device;
+        mapper_database_publish_snapshot(db);
+        mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+        mapper_database_publish_snapshot(db);
+    }
+    __atomic_store_n(&reading_snapshots, 0, __ATOMIC_RELEASE);
+    pthread_join(thread, 0);
+
+    // the first snapshot is unchanged, and outlives the database snapshots
+    mapper_database_set_snapshots(db, 0);
+    if (mapper_snapshot_record_property(rec, "name", &length, &type,
+                                        (const void**)&dev_name)
+        || strcmp(dev_name, "testdatabase.1")) {
+        eprintf("Released snapshot was modified.\n");
+        result = 1;
+    }
+    mapper_snapshot_release(snap);
+
+    eprintf("  reader checked %d snapshots, %d inconsistent\n",
+            snapshots_read, inconsistent_snapshots);
+    return result || inconsistent_snapshots;
+}
+
+/* Add and remove devices with signals repeatedly, querying them each time,
+ * and report how many of the allocations involved reached malloc(). */
+int test_allocation_churn(mapper_database db)
+{
+    int i, j, count, rounds = 1000, signals_per_device = 10;
+    char name[64];
+    mapper_device dev;
+    mapper_signal *psig;
+    unsigned int allocs = db->pool.num_allocs, mallocs = db->pool.num_mallocs;
+
+    for (i = 0; i < rounds; i++) {
+        snprintf(name, 64, "churn.%d", i + 1);
+        dev = mapper_database_add_or_update_device(db, name, 0);
+        for (j = 0; j < signals_per_device; j++) {
+            snprintf(name, 64, "out%d", j);
+            mapper_database_add_or_update_signal(db, name, dev->name, 0);
+        }
+        count = 0;
+        psig = mapper_device_signals(dev, MAPPER_DIR_ANY);
+        while (psig) {
+            ++count;
+            psig = mapper_signal_query_next(psig);
+        }
+        if (count != signals_per_device) {
+            eprintf("Expected %d signals for device '%s', found %d.\n",
+                    signals_per_device, dev->name, count);
+            return 1;
+        }
+        mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    }
+
+    allocs = db->pool.num_allocs - allocs;
+    mallocs = db->pool.num_mallocs - mallocs;
+    eprintf("  %u records and queries allocated, %u calls to malloc()\n",
+            allocs, mallocs);
+    return mallocs * 100 > allocs;
+}
+
+/* Fill the database on the scale of a large installation and report the
+ * latency of looking up records by name and id. */
+int test_lookup_latency(mapper_database db)
+{
+    int i, j, num_devices = 800, signals_per_device = 75, num_maps = 1000;
+    int num_signals = num_devices * signals_per_device;
+    char name[64], dst_name[64];
+    const char *src_name = name;
+    lo_message lom;
+    mapper_message msg;
+    mapper_device dev;
+    mapper_signal sig;
+    double start;
+
+    for (i = 0; i < num_devices; i++) {
+        snprintf(name, 64, "scale.%d", i + 1);
+        dev = mapper_database_add_or_update_device(db, name, 0);
+        for (j = 0; j < signals_per_device; j++) {
+            snprintf(name, 64, "sig%d", j);
+            if (!(msg = parse_id_message(&lom, dev->id | (j + 1))))
+                return 1;
+            mapper_database_add_or_update_signal(db, name, dev->name, msg);
+            mapper_message_free(msg);
+            lo_message_free(lom);
+        }
+    }
+    for (i = 0; i < num_maps; i++) {
+        snprintf(name, 64, "scale.%d/sig%d", i % num_devices + 1, i % 50);
+        snprintf(dst_name, 64, "scale.%d/sig%d", (i + 1) % num_devices + 1,
+                 i % 25 + 50);
+        if (!(msg = parse_id_message(&lom, 0x100000 + i)))
+            return 1;
+        mapper_database_add_or_update_map(db, 1, &src_name, dst_name, msg);
+        mapper_message_free(msg);
+        lo_message_free(lom);
+    }
+    eprintf("Added %d devices, %d signals and %d maps.\n", num_devices,
+            num_signals, num_maps);
+
+    start = mapper_get_current_time();
+    for (i = 0; i < num_devices; i++) {
+        snprintf(name, 64, "scale.%d", i + 1);
+        dev = mapper_database_device_by_name(db, name);
+        if (!dev || mapper_database_device_by_id(db, dev->id) != dev) {
+            eprintf("Device lookup failed for '%s'.\n", name);
+            return 1;
+        }
+    }
+    eprintf("  device by name and id: %.3f us\n",
+            (mapper_get_current_time() - start) * 1000000. / num_devices);
+
+    start = mapper_get_current_time();
+    for (i = 0; i < num_signals; i++) {
+        snprintf(name, 64, "scale.%d", i / signals_per_device + 1);
+        dev = mapper_database_device_by_name(db, name);
+        snprintf(name, 64, "sig%d", i % signals_per_device);
+        sig = mapper_device_signal_by_name(dev, name);
+        if (!sig || mapper_database_signal_by_id(db, sig->id) != sig) {
+            eprintf("Signal lookup failed for '%s'.\n", name);
+            return 1;
+        }
+    }
+    eprintf("  signal by name and id: %.3f us\n",
+            (mapper_get_current_time() - start) * 1000000. / num_signals);
+
+    start = mapper_get_current_time();
+    for (i = 0; i < num_maps; i++) {
+        if (!mapper_database_map_by_id(db, 0x100000 + i)) {
+            eprintf("Map lookup failed for id %d.\n", 0x100000 + i);
+            return 1;
+        }
+    }
+    eprintf("  map by id: %.3f us\n",
+            (mapper_get_current_time() - start) * 1000000. / num_maps);
+
+    // removed records must no longer be found
+    dev = mapper_database_device_by_name(db, "scale.1");
+    mapper_id dev_id = dev->id;
+    mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    if (mapper_database_device_by_name(db, "scale.1")
+        || mapper_database_device_by_id(db, dev_id)
+        || mapper_database_signal_by_id(db, dev_id | 1)
+        || mapper_database_map_by_id(db, 0x100000)) {
+        eprintf("Found records of a removed device.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Count the results of a signal query, freeing it. */
+int count_signals(mapper_signal *psig)
+{
+    int count = 0;
+    while (psig) {
+        ++count;
+        psig = mapper_signal_query_next(psig);
+    }
+    return count;
+}
+
+/* Apply the properties in a message to a signal record as a remote
+ * announcement would, which changes the version of the signal records. The
+ * message is freed. */
+int update_signal(mapper_database db, mapper_signal sig, lo_message lom)
+{
+    mapper_message msg;
+    msg = mapper_message_parse_properties(lo_message_get_argc(lom),
+                                          lo_message_get_types(lom),
+                                          lo_message_get_argv(lom));
+    mapper_database_add_or_update_signal(db, sig->name, sig->device->name, msg);
+    mapper_message_free(msg);
+    lo_message_free(lom);
+    return 0;
+}
+
+int set_signal_unit(mapper_database db, mapper_signal sig, const char *unit)
+{
+    lo_message lom = lo_message_new();
+    if (!lom)
+        return 1;
+    lo_message_add_string(lom, "@unit");
+    lo_message_add_string(lom, unit);
+    return update_signal(db, sig, lom);
+}
+
+/* Set the extra property "gain" of a signal record as an int or a float. */
+int set_signal_gain(mapper_database db, mapper_signal sig, char type,
+                    int gain)
+{
+    lo_message lom = lo_message_new();
+    if (!lom)
+        return 1;
+    lo_message_add_string(lom, "@gain");
+    if (type == 'f')
+        lo_message_add_float(lom, gain);
+    else
+        lo_message_add_int32(lom, gain);
+    return update_signal(db, sig, lom);
+}
+
+/* Check name pattern queries against the large database built by
+ * test_lookup_latency(), in which scale.1 has already been removed. */
+int test_pattern_queries(mapper_database db, int num_devices)
+{
+    int i, count;
+    double start;
+    const char *patterns[] = {"sig1*", "s*4", "*g7*", "sig*1*", "sig", "sig*",
+                              "ig1*", "g*1", "sig7"};
+    int expected[] = {11, 7, 6, 17, 0, 75, 11, 7, 1};
+    const char *dev_patterns[] = {"scale.1*", "*.8", "scale.*0*", "*scale",
+                                  "cale.8*", "scale.8"};
+    int dev_expected[] = {110, 1, 143, 0, 12, 1};
+    mapper_device *pdev;
+
+    for (i = 0; i < sizeof(patterns) / sizeof(char*); i++) {
+        start = mapper_get_current_time();
+        count = count_signals(mapper_database_signals_by_name(db,
+                                                              patterns[i]));
+        eprintf("  signals matching '%s': %d in %.3f us\n", patterns[i], count,
+                (mapper_get_current_time() - start) * 1000000.);
+        if (count != expected[i] * num_devices) {
+            eprintf("Expected %d signals matching '%s'.\n",
+                    expected[i] * num_devices, patterns[i]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(dev_patterns) / sizeof(char*); i++) {
+        count = 0;
+        pdev = mapper_database_devices_by_name(db, dev_patterns[i]);
+        while (pdev) {
+            ++count;
+            pdev = mapper_device_query_next(pdev);
+        }
+        if (count != dev_expected[i]) {
+            eprintf("Expected %d devices matching '%s', found %d.\n",
+                    dev_expected[i], dev_patterns[i], count);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Check the results of repeated property queries against the large database
+ * built by test_lookup_latency(), and that changes invalidate them. */
+int test_query_latency(mapper_database db, int num_devices)
+{
+    int i, count, length = 1, repeats = 100;
+    const char *unit = "m/s";
+    mapper_signal sig, *psig;
+    char name[64];
+    double start, times[3];
+
+    // the first query scans, the next builds an index, the rest are memoized
+    for (i = 0; i < 3; i++) {
+        snprintf(name, 64, "sig%d", i + 2);
+        start = mapper_get_current_time();
+        psig = mapper_database_signals_by_property(db, "name", 1, 's', name,
+                                                   MAPPER_OP_EQUAL);
+        times[i] = mapper_get_current_time() - start;
+        if ((count = count_signals(psig)) != num_devices) {
+            eprintf("Expected %d signals named '%s', found %d.\n",
+                    num_devices, name, count);
+            return 1;
+        }
+    }
+
+    start = mapper_get_current_time();
+    for (i = 0; i < repeats; i++) {
+        psig = mapper_database_signals_by_property(db, "name", 1, 's', "sig3",
+                                                   MAPPER_OP_EQUAL);
+        mapper_signal_query_done(psig);
+    }
+    eprintf("  signals by name: %.3f us scanned, %.3f us indexing, "
+            "%.3f us indexed, %.3f us repeated\n", times[0] * 1000000.,
+            times[1] * 1000000., times[2] * 1000000.,
+            (mapper_get_current_time() - start) * 1000000. / repeats);
+
+    count = 0;
+    psig = mapper_database_signals(db, MAPPER_DIR_ANY);
+    while (psig) {
+        count += mapper_signal_length(*psig) > 1;
+        psig = mapper_signal_query_next(psig);
+    }
+    for (i = 0; i < 2; i++) {
+        // build the length index
+        psig = mapper_database_signals_by_property(db, "length", 1, 'i',
+                                                   &i, MAPPER_OP_EQUAL);
+        mapper_signal_query_done(psig);
+    }
+    start = mapper_get_current_time();
+    for (i = 0; i < repeats; i++) {
+        psig = mapper_database_signals_by_property(db, "length", 1, 'i',
+                                                   &length,
+                                                   MAPPER_OP_GREATER_THAN);
+        if (count_signals(psig) != count) {
+            eprintf("Expected %d signals with length greater than 1.\n",
+                    count);
+            return 1;
+        }
+    }
+    eprintf("  signals by length range: %.3f us\n",
+            (mapper_get_current_time() - start) * 1000000. / repeats);
+
+    // combining indexed queries must give the same results as before
+    psig = mapper_signal_query_union(
+        mapper_database_signals_by_name(db, "sig3"),
+        mapper_database_signals_by_name(db, "sig4"));
+    if ((count = count_signals(psig)) != num_devices * 2) {
+        eprintf("Expected %d signals in union, found %d.\n", num_devices * 2,
+                count);
+        return 1;
+    }
+
+    // modifying a signal must invalidate the cached results
+    psig = mapper_database_signals_by_name(db, "sig3");
+    sig = *psig;
+    mapper_signal_query_done(psig);
+    if (set_signal_unit(db, sig, unit))
+        return 1;
+
+    psig = mapper_database_signals_by_property(db, "unit", 1, 's', unit,
+                                               MAPPER_OP_EQUAL);
+    if (count_signals(psig) != 1) {
+        eprintf("Modified signal was not found by its new unit.\n");
+        return 1;
+    }
+    psig = mapper_database_signals_by_property(db, "unit", 1, 's', unit,
+                                               MAPPER_OP_NOT_EQUAL);
+    if (count_signals(psig) != mapper_database_num_signals(db, MAPPER_DIR_ANY)
+        - 1) {
+        eprintf("Unexpected number of signals with other units.\n");
+        return 1;
+    }
+
+    // removing a device must remove its signals from the results
+    mapper_database_remove_device(db, sig->device, MAPPER_REMOVED, 1);
+    psig = mapper_database_signals_by_name(db, "sig3");
+    if ((count = count_signals(psig)) != num_devices - 1) {
+        eprintf("Expected %d signals after removal, found %d.\n",
+                num_devices - 1, count);
+        return 1;
+    }
+    return 0;
+}
+
+#define NUM_GAINS 8
+
+/* Count the gains of the given type that compare to a value as an operator
+ * would, to check the results of property queries against. */
+int expected_gains(const int *gains, const char *types, char type, int value,
+                   mapper_op op)
+{
+    int i, count = 0;
+    for (i = 0; i < NUM_GAINS; i++) {
+        if (types[i] != type)
+            continue;
+        switch (op) {
+            case MAPPER_OP_EQUAL:       count += gains[i] == value;  break;
+            case MAPPER_OP_NOT_EQUAL:   count += gains[i] != value;  break;
+            case MAPPER_OP_LESS_THAN:   count += gains[i] < value;   break;
+            case MAPPER_OP_LESS_THAN_OR_EQUAL:
+                count += gains[i] <= value;
+                break;
+            case MAPPER_OP_GREATER_THAN:
+                count += gains[i] > value;
+                break;
+            case MAPPER_OP_GREATER_THAN_OR_EQUAL:
+                count += gains[i] >= value;
+                break;
+            default:
+                break;
+        }
+    }
+    return count;
+}
+
+/* Query the "gain" property with each operator and two values.  After the
+ * records change, the first query scans them and the next builds an index
+ * that answers the others. */
+int check_gain_queries(mapper_database db, const int *gains,
+                       const char *types, char type)
+{
+    int i, j, count, expected, value;
+    float fvalue;
+    mapper_op ops[] = {MAPPER_OP_EQUAL, MAPPER_OP_NOT_EQUAL,
+        MAPPER_OP_LESS_THAN, MAPPER_OP_LESS_THAN_OR_EQUAL,
+        MAPPER_OP_GREATER_THAN, MAPPER_OP_GREATER_THAN_OR_EQUAL};
+    mapper_signal *psig;
+
+    for (i = 0; i < 2; i++) {
+        value = 3 + i;
+        fvalue = value;
+        for (j = 0; j < 6; j++) {
+            psig = mapper_database_signals_by_property(db, "gain", 1, type,
+                                                       type == 'f'
+                                                       ? (void*)&fvalue
+                                                       : (void*)&value,
+                                                       ops[j]);
+            count = count_signals(psig);
+            expected = expected_gains(gains, types, type, value, ops[j]);
+            if (count != expected) {
+                eprintf("Query %d for gain '%c' %d found %d signals, "
+                        "expected %d.\n", j, type, value, count, expected);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Check that indexed queries give the same results as scans, including
+ * after the type of the queried property changes on one of the records. */
+int test_index_query(mapper_database db)
+{
+    int i, gains[NUM_GAINS];
+    char types[NUM_GAINS];
+    mapper_signal sigs[NUM_GAINS], *psig;
+
+    psig = mapper_database_signals(db, MAPPER_DIR_ANY);
+    for (i = 0; i < NUM_GAINS && psig; i++) {
+        sigs[i] = *psig;
+        gains[i] = (i * 5) % NUM_GAINS;
+        types[i] = 'i';
+        if (set_signal_gain(db, sigs[i], 'i', gains[i]))
+            return 1;
+        psig = mapper_signal_query_next(psig);
+    }
+    mapper_signal_query_done(psig);
+    if (i < NUM_GAINS)
+        return 1;
+
+    if (check_gain_queries(db, gains, types, 'i'))
+        return 1;
+
+    // a record whose gain becomes a float leaves the integer index
+    for (i = 0; i < NUM_GAINS; i++) {
+        if (gains[i] != 3)
+            continue;
+        types[i] = 'f';
+        if (set_signal_gain(db, sigs[i], 'f', gains[i]))
+            return 1;
+    }
+    if (check_gain_queries(db, gains, types, 'i'))
+        return 1;
+    if (check_gain_queries(db, gains, types, 'f'))
+        return 1;
+
+    // and rejoins it when it changes back
+    for (i = 0; i < NUM_GAINS; i++) {
+        types[i] = 'i';
+        if (set_signal_gain(db, sigs[i], 'i', gains[i]))
+            return 1;
+    }
+    return check_gain_queries(db, gains, types, 'i');
+}
+
 int main(int argc, char **argv)
 {
     int i, j, result = 0;
@@ -1120,6 +2042,68 @@ int main(int argc, char **argv)
     }
 
     /*********/
+
+    if (test_batch_notifications(db)) {
+        eprintf("Batched notification test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_batched_signal_removal()) {
+        eprintf("Batched signal removal test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_change_journal(db)) {
+        eprintf("Change journal test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_timer_heap(db)) {
+        eprintf("Timer heap test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_snapshots(db)) {
+        eprintf("Snapshot test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_allocation_churn(db)) {
+        eprintf("Allocation churn test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_lookup_latency(db)) {
+        eprintf("Lookup latency test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_pattern_queries(db, 799)) {
+        eprintf("Pattern query test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_query_latency(db, 799)) {
+        eprintf("Query latency test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (test_index_query(db)) {
+        eprintf("Indexed query test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    /*********/
 done:
     mapper_network_free(net);
     if (!verbose)
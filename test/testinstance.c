@@ -224,6 +224,227 @@ void loop()
     }
 }
 
+void stress_handler(mapper_signal sig, mapper_id instance, const void *value,
+                    int count, mapper_timetag_t *timetag)
+{
+    if (value)
+        received++;
+    else
+        mapper_signal_instance_release(sig, instance, MAPPER_NOW);
+}
+
+/*! Update and release many concurrent instances to exercise id map lookups,
+ *  either one instance at a time or using the bulk update function. */
+int stress_instances(int bulk)
+{
+    int i, j, num_inst = 500, rounds = 20;
+    mapper_id ids[500];
+    float values[500];
+
+    mapper_signal src = mapper_device_add_signal(source, MAPPER_DIR_OUTGOING,
+                                                 num_inst,
+                                                 bulk ? "bulk_out" : "stress_out",
+                                                 1, 'f', 0, 0, 0, 0, 0);
+    mapper_signal dst = mapper_device_add_signal(destination,
+                                                 MAPPER_DIR_INCOMING, num_inst,
+                                                 bulk ? "bulk_in" : "stress_in",
+                                                 1, 'f', 0, 0, 0,
+                                                 stress_handler, 0);
+    if (!src || !dst)
+        return 1;
+
+    // keep the instance id maps apart from those left by earlier tests
+    mapper_signal_set_group(src, mapper_device_add_signal_group(source));
+    mapper_signal_set_group(dst, mapper_device_add_signal_group(destination));
+
+    for (j = 0; j < num_inst; j++)
+        ids[j] = j;
+
+    // a burst of updates for every instance would overflow a UDP socket
+    mapper_map map = mapper_map_new(1, &src, 1, &dst);
+    mapper_map_set_protocol(map, MAPPER_PROTO_TCP);
+    mapper_map_push(map);
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    // the source may not be sending yet, so also wait for its own record
+    mapper_map *maps = 0;
+    while (!done && !(maps && mapper_map_ready(*maps)
+                      && mapper_map_protocol(*maps) == MAPPER_PROTO_TCP)) {
+        mapper_map_query_done(maps);
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        maps = mapper_signal_maps(src, MAPPER_DIR_OUTGOING);
+    }
+    mapper_map_query_done(maps);
+
+    eprintf("\n**********************************************\n");
+    eprintf("******** STRESS %3i CONCURRENT INSTANCES ******\n", num_inst);
+    eprintf("********      (%s updates)      ******\n",
+            bulk ? "   bulk   " : "individual");
+    sent = received = 0;
+    double then = mapper_get_current_time();
+    for (i = 0; i < rounds && !done; i++) {
+        for (j = 0; j < num_inst; j++)
+            values[j] = i;
+        if (bulk)
+            mapper_signal_update_instances(src, num_inst, ids, values,
+                                           MAPPER_NOW);
+        else {
+            for (j = 0; j < num_inst; j++)
+                mapper_signal_instance_update(src, j, &values[j], 0,
+                                              MAPPER_NOW);
+        }
+        sent += num_inst;
+        while (received < sent && !done) {
+            mapper_device_poll(source, 0);
+            mapper_device_poll(destination, 10);
+        }
+        if (mapper_signal_num_active_instances(dst) != num_inst) {
+            eprintf("expected %i active instances, found %i\n", num_inst,
+                    mapper_signal_num_active_instances(dst));
+            return 1;
+        }
+        // release half of the instances so that id maps are recycled
+        if (bulk) {
+            for (j = 0; j < num_inst / 2; j++)
+                ids[j] = j * 2 + i % 2;
+            mapper_signal_update_instances(src, num_inst / 2, ids, 0,
+                                           MAPPER_NOW);
+            for (j = 0; j < num_inst; j++)
+                ids[j] = j;
+        }
+        else {
+            for (j = i % 2; j < num_inst; j += 2)
+                mapper_signal_instance_release(src, j, MAPPER_NOW);
+        }
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 10);
+    }
+    eprintf("STRESS: sent %i updates, received %i updates in %f seconds.\n",
+            sent, received, mapper_get_current_time() - then);
+    return sent != received;
+}
+
+/*! Return the value held by an instance of a float signal, or -1. */
+float instance_value(mapper_signal sig, mapper_id instance)
+{
+    const float *value = mapper_signal_instance_value(sig, instance, 0);
+    return value ? *value : -1;
+}
+
+/*! Check that the oldest and newest active instances of a signal hold the
+ *  given note values. */
+int check_age_order(mapper_signal sig, float oldest, float newest)
+{
+    mapper_id oldest_id = mapper_signal_oldest_active_instance(sig);
+    mapper_id newest_id = mapper_signal_newest_active_instance(sig);
+    float first = instance_value(sig, oldest_id);
+    float last = instance_value(sig, newest_id);
+    if (first == oldest && last == newest)
+        return 0;
+    eprintf("POLYPHONY: oldest/newest are %g/%g, expected %g/%g\n", first,
+            last, oldest, newest);
+    return 1;
+}
+
+/*! Benchmark instance stealing: the source keeps more voices sounding than
+ *  the destination has instances, so that nearly every new voice steals the
+ *  oldest active destination instance. */
+int polyphony()
+{
+    int i, num_voices = 1024, num_inst = 512, sounding = 600,
+        notes = 10000, released = 100, active;
+    float value;
+
+    mapper_signal src = mapper_device_add_signal(source, MAPPER_DIR_OUTGOING,
+                                                 num_voices, "poly_out", 1, 'f',
+                                                 0, 0, 0, 0, 0);
+    mapper_signal dst = mapper_device_add_signal(destination,
+                                                 MAPPER_DIR_INCOMING, num_inst,
+                                                 "poly_in", 1, 'f', 0, 0, 0,
+                                                 stress_handler, 0);
+    if (!src || !dst)
+        return 1;
+    mapper_signal_set_instance_stealing_mode(dst, MAPPER_STEAL_OLDEST);
+
+    // keep the instance id maps apart from those left by earlier tests
+    mapper_signal_set_group(src, mapper_device_add_signal_group(source));
+    mapper_signal_set_group(dst, mapper_device_add_signal_group(destination));
+
+    // every update and release must arrive for the counts below to be exact
+    mapper_map map = mapper_map_new(1, &src, 1, &dst);
+    mapper_map_set_protocol(map, MAPPER_PROTO_TCP);
+    mapper_map_push(map);
+
+    // wait for the source's own record, since the source does the sending
+    mapper_map *maps = 0;
+    while (!done && !(maps && mapper_map_ready(*maps)
+                      && mapper_map_protocol(*maps) == MAPPER_PROTO_TCP)) {
+        mapper_map_query_done(maps);
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        maps = mapper_signal_maps(src, MAPPER_DIR_OUTGOING);
+    }
+    mapper_map_query_done(maps);
+
+    eprintf("\n**********************************************\n");
+    eprintf("******** POLYPHONY %4i VOICES, %3i INSTANCES ***\n", sounding,
+            num_inst);
+    sent = received = 0;
+    double then = mapper_get_current_time();
+    for (i = 0; i < notes && !done; i++) {
+        value = i;
+        mapper_signal_instance_update(src, i % num_voices, &value, 0,
+                                      MAPPER_NOW);
+        ++sent;
+        if (i >= sounding)
+            mapper_signal_instance_release(src, (i - sounding) % num_voices,
+                                           MAPPER_NOW);
+        if (i % 32 == 0) {
+            mapper_device_poll(source, 0);
+            mapper_device_poll(destination, 0);
+        }
+    }
+    mapper_device_poll(source, 0);
+    while (received < sent && !done) {
+        if (!mapper_device_poll(destination, 10))
+            break;
+    }
+    eprintf("POLYPHONY: sent %i notes, received %i updates in %f seconds.\n",
+            sent, received, mapper_get_current_time() - then);
+    if (received != sent)
+        return 1;
+
+    // the destination keeps the newest notes, stolen in order of age
+    active = mapper_signal_num_active_instances(dst);
+    if (active != num_inst) {
+        eprintf("POLYPHONY: %i active instances, expected %i\n", active,
+                num_inst);
+        return 1;
+    }
+    if (check_age_order(dst, notes - num_inst, notes - 1))
+        return 1;
+
+    /* Release the oldest sounding voices. Releases of voices that were
+     * stolen at the destination have nothing left to release there. */
+    for (i = notes - sounding; i < notes - num_inst + released; i++)
+        mapper_signal_instance_release(src, i % num_voices, MAPPER_NOW);
+    for (i = 0; i < 10 && !done; i++) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 10);
+    }
+    active = mapper_signal_num_active_instances(dst);
+    if (active != num_inst - released) {
+        eprintf("POLYPHONY: %i active instances after release, expected %i\n",
+                active, num_inst - released);
+        return 1;
+    }
+    return check_age_order(dst, notes - num_inst + released, notes - 1);
+}
+
 void ctrlc(int sig)
 {
     done = 1;
@@ -321,6 +542,21 @@ int main(int argc, char **argv)
 
     result = (stats[4] != stats[5]);
 
+    if (stress_instances(0)) {
+        eprintf("Instance stress test FAILED.\n");
+        result = 1;
+    }
+
+    if (stress_instances(1)) {
+        eprintf("Bulk instance stress test FAILED.\n");
+        result = 1;
+    }
+
+    if (polyphony()) {
+        eprintf("Polyphony test FAILED.\n");
+        result = 1;
+    }
+
   done:
     cleanup_destination();
     cleanup_source();
@@ -0,0 +1,237 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+int port = 9000;
+
+int sent = 0;
+int received = 0;
+
+int setup_source()
+{
+    source = mapper_device_new("testinterp-send", port, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    float mn=0, mx=1000;
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0,
+                                              &mn, &mx);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        eprintf("handler: Got %f\n", (*(float*)value));
+    }
+    received++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testinterp-recv", port, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    float mn=0, mx=1000;
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             &mn, &mx, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int create_map()
+{
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 25);
+        mapper_device_poll(destination, 25);
+    }
+}
+
+/* Update the source at 30 Hz with a ramp while reading the destination at
+ * 1 kHz, a short delay behind the updates.  With linear interpolation the
+ * values read should rise smoothly instead of in steps. */
+int loop()
+{
+    int i = 0, reads = 0, steps = 0;
+    float value, last = -1;
+    mapper_timetag_t now, tt, next;
+
+    eprintf("Interpolating a 30 Hz ramp at 1 kHz..\n");
+    mapper_signal_set_interpolation(recvsig, MAPPER_INTERP_LINEAR);
+    mapper_timetag_now(&next);
+    while ((!terminate || i < 30) && !done) {
+        mapper_timetag_now(&now);
+        if (mapper_timetag_difference(now, next) >= 0) {
+            value = i++;
+            mapper_signal_update(sendsig, &value, 1, now);
+            mapper_device_poll(source, 0);
+            sent++;
+            mapper_timetag_add_double(&next, 1.0 / 30);
+        }
+        mapper_device_poll(destination, 0);
+
+        // read one source period behind so that the samples bracket the time
+        mapper_timetag_copy(&tt, now);
+        mapper_timetag_add_double(&tt, -0.05);
+        if (received >= 3 && mapper_signal_interpolate(recvsig, tt, &value)) {
+            if (value < last) {
+                eprintf("Interpolated value went backwards: %f < %f\n",
+                        value, last);
+                return 1;
+            }
+            if (value == last)
+                ++steps;
+            last = value;
+            ++reads;
+        }
+        usleep(1000);
+
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+    eprintf("Read %d interpolated values, %d repeated.\n", reads, steps);
+
+    // most consecutive reads should differ, unlike a sample-and-hold
+    return reads == 0 || steps > reads / 4;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testinterp.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-t terminate automatically, "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source()) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (create_map()) {
+        eprintf("Error creating map.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (loop()) {
+        eprintf("Interpolated values were not smooth.\n");
+        result = 1;
+        goto done;
+    }
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
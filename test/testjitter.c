@@ -0,0 +1,308 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+int port = 9000;
+
+int sent = 0;
+int received = 0;
+int out_of_order = 0;
+int early = 0;
+
+double latency = 0.05;
+mapper_timetag_t last_timetag = {0, 0};
+
+int setup_source()
+{
+    source = mapper_device_new("testjitter-send", port, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    int mn=0, mx=1000;
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'i', 0,
+                                              &mn, &mx);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+
+    if (value) {
+        eprintf("handler: Got %i, %f seconds after its timetag\n",
+                (*(int*)value), mapper_timetag_difference(now, *timetag));
+    }
+    if (mapper_timetag_difference(*timetag, last_timetag) < 0)
+        ++out_of_order;
+    // allow some slack for the estimated clock offset between the devices
+    if (mapper_timetag_difference(now, *timetag) < latency - 0.005)
+        ++early;
+    mapper_timetag_copy(&last_timetag, *timetag);
+    received++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testjitter-recv", port, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    int mn=0, mx=1000;
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'i', 0,
+                                             &mn, &mx, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int create_map()
+{
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 25);
+        mapper_device_poll(destination, 25);
+    }
+}
+
+// Send an update carrying the given timetag in its bundle.
+void send_update(int value, mapper_timetag_t tt)
+{
+    mapper_device_start_queue(source, tt);
+    mapper_signal_update(sendsig, &value, 1, tt);
+    mapper_device_send_queue(source, tt);
+    sent++;
+}
+
+void loop()
+{
+    int i = 0;
+    mapper_timetag_t tt;
+
+    eprintf("Sending updates with jittered timetags..\n");
+    mapper_signal_set_jitter_buffer(recvsig, latency, 256);
+    while ((!terminate || i < 100) && !done) {
+        /* Timetags advance steadily but the messages leave in a shuffled
+         * order, so they must be reordered by the destination. */
+        mapper_timetag_now(&tt);
+        mapper_timetag_add_double(&tt, (i % 4) * 0.005 - (i % 3) * 0.005);
+        send_update(i, tt);
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 10);
+        i++;
+
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+
+    // wait for the held updates to be released
+    mapper_device_poll(destination, latency * 2000 + 100);
+}
+
+int late_updates()
+{
+    unsigned int late_before, late, dropped;
+    mapper_timetag_t tt;
+
+    eprintf("Sending an update timetagged in the past..\n");
+    mapper_signal_jitter_buffer_stats(recvsig, &late_before, &dropped);
+    mapper_timetag_now(&tt);
+    mapper_timetag_add_double(&tt, -1.0);
+    mapper_timetag_copy(&last_timetag, tt);
+    received = 0;
+    send_update(1, tt);
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 100);
+
+    mapper_signal_jitter_buffer_stats(recvsig, &late, &dropped);
+    late -= late_before;
+    eprintf("Received %d update, %u late.\n", received, late);
+    return received != 1 || late != 1;
+}
+
+int discard_out_of_order()
+{
+    int i;
+    double offsets[] = {0.1, 0.3, 0.2, 0.4};
+    mapper_timetag_t now, tt;
+
+    eprintf("Discarding out-of-order updates..\n");
+    mapper_signal_set_jitter_buffer(recvsig, 0, 0);
+    mapper_signal_set_discard_out_of_order(recvsig, 1);
+    mapper_timetag_now(&now);
+    received = 0;
+    for (i = 0; i < 4; i++) {
+        mapper_timetag_copy(&tt, now);
+        mapper_timetag_add_double(&tt, offsets[i]);
+        send_update(i, tt);
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 50);
+    }
+
+    eprintf("Received %d updates, %u discarded.\n", received,
+            mapper_signal_num_discarded(recvsig));
+    mapper_signal_set_discard_out_of_order(recvsig, 0);
+    return received != 3 || mapper_signal_num_discarded(recvsig) != 1;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    unsigned int late, dropped;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testjitter.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-t terminate automatically, "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source()) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (create_map()) {
+        eprintf("Error creating map.\n");
+        result = 1;
+        goto done;
+    }
+
+    loop();
+
+    mapper_signal_jitter_buffer_stats(recvsig, &late, &dropped);
+    eprintf("Sent %d updates, received %d, %u late, %u dropped.\n", sent,
+            received, late, dropped);
+    if (sent != received + dropped) {
+        eprintf("Not all sent messages were received.\n");
+        result = 1;
+        goto done;
+    }
+    if (out_of_order || early) {
+        eprintf("%d updates were delivered out of order, %d too early.\n",
+                out_of_order, early);
+        result = 1;
+        goto done;
+    }
+
+    if (late_updates()) {
+        eprintf("Late update was not delivered immediately.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (discard_out_of_order()) {
+        eprintf("Out-of-order update was not discarded.\n");
+        result = 1;
+        goto done;
+    }
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,146 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+
+int sizes[] = {10000, 50000, 100000};
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*! Register num_signals signals on a new device, then look each of them up by
+ *  name and by id. */
+int register_signals(int num_signals)
+{
+    int i, result = 0;
+    char name[32];
+    double start, added, found;
+    mapper_signal *sigs = malloc(sizeof(mapper_signal) * num_signals);
+
+    mapper_device dev = mapper_device_new("testregister", 0, 0);
+    if (!dev || !sigs) {
+        eprintf("Error creating device.\n");
+        result = 1;
+        goto done;
+    }
+
+    start = current_time();
+    for (i = 0; i < num_signals; i++) {
+        snprintf(name, 32, "sensor/%d", i);
+        if (i % 2)
+            sigs[i] = mapper_device_add_output_signal(dev, name, 1, 'f', 0, 0,
+                                                      0);
+        else
+            sigs[i] = mapper_device_add_input_signal(dev, name, 1, 'f', 0, 0, 0,
+                                                     0, 0);
+        if (!sigs[i]) {
+            eprintf("Error adding signal '%s'.\n", name);
+            result = 1;
+            goto done;
+        }
+    }
+    added = current_time();
+
+    for (i = 0; i < num_signals; i++) {
+        snprintf(name, 32, "sensor/%d", i);
+        if (mapper_device_signal_by_name(dev, name) != sigs[i]
+            || mapper_device_signal_by_id(dev, mapper_signal_id(sigs[i]))
+               != sigs[i]) {
+            eprintf("Lookup of signal '%s' failed.\n", name);
+            result = 1;
+            goto done;
+        }
+    }
+    found = current_time();
+
+    if (mapper_device_num_signals(dev, MAPPER_DIR_ANY) != num_signals) {
+        eprintf("Expected %d signals, found %d.\n", num_signals,
+                mapper_device_num_signals(dev, MAPPER_DIR_ANY));
+        result = 1;
+        goto done;
+    }
+
+    // adding an existing name must return the same signal
+    if (mapper_device_add_input_signal(dev, "sensor/0", 1, 'f', 0, 0, 0, 0, 0)
+        != sigs[0]) {
+        eprintf("Duplicate signal name was registered again.\n");
+        result = 1;
+        goto done;
+    }
+
+    // removed signals must disappear from both indexes
+    mapper_id id = mapper_signal_id(sigs[1]);
+    mapper_device_remove_signal(dev, sigs[1]);
+    if (mapper_device_signal_by_name(dev, "sensor/1")
+        || mapper_device_signal_by_id(dev, id)) {
+        eprintf("Removed signal is still found.\n");
+        result = 1;
+        goto done;
+    }
+
+    eprintf("%6d signals: added in %.3f s (%.2f us each), "
+            "looked up in %.3f s\n", num_signals, added - start,
+            (added - start) * 1000000.0 / num_signals, found - added);
+
+  done:
+    if (dev) {
+        start = current_time();
+        mapper_device_free(dev);
+        eprintf("              freed in %.3f s\n", current_time() - start);
+    }
+    if (sigs)
+        free(sigs);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testregister.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(int); i++) {
+        if (register_signals(sizes[i])) {
+            eprintf("Registering %d signals failed.\n", sizes[i]);
+            result = 1;
+            break;
+        }
+    }
+
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <poll.h>
 
 #ifdef WIN32
 void timersub(struct timeval *a, struct timeval *b, struct timeval *res)
@@ -209,6 +210,32 @@ void select_on_both_devices(int block_ms)
     mapper_device_poll(destination, 0);
 }
 
+/* Wait on the single event descriptor of each device instead, using the
+ * next timeout reported by the devices to bound the wait. */
+int poll_event_fds(int block_ms)
+{
+    struct pollfd pfd[2];
+    int timeout;
+
+    pfd[0].fd = mapper_device_event_fd(source);
+    pfd[1].fd = mapper_device_event_fd(destination);
+    if (pfd[0].fd < 0 || pfd[1].fd < 0)
+        return 1;
+    pfd[0].events = pfd[1].events = POLLIN;
+
+    timeout = mapper_device_next_timeout(source);
+    if (mapper_device_next_timeout(destination) < timeout)
+        timeout = mapper_device_next_timeout(destination);
+    if (timeout > block_ms)
+        timeout = block_ms;
+
+    if (poll(pfd, 2, timeout) < 0)
+        return 1;
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 0);
+    return 0;
+}
+
 void loop()
 {
     eprintf("-------------------- GO ! --------------------\n");
@@ -227,6 +254,138 @@ void loop()
     }
 }
 
+void event_fd_loop()
+{
+    int i = 0, j;
+
+    if (mapper_device_event_fd(source) < 0) {
+        eprintf("Event descriptors not supported, skipping.\n");
+        return;
+    }
+    eprintf("-------------- Using event descriptors --------------\n");
+    while ((!terminate || i < 50) && !done) {
+        mapper_signal_update_float(sendsig, ((i % 10) * 1.0f));
+        eprintf("\nsource value updated to %d -->\n", i % 10);
+        i++;
+        sent++;
+        // the update may take more than one wakeup to arrive
+        for (j = 0; j < 10 && received < sent && !done; j++) {
+            if (poll_event_fds(100))
+                return;
+        }
+    }
+}
+
+/* Move the map to TCP, and check that updates arriving on the connection
+ * accepted by the destination wake its event descriptor rather than waiting
+ * for its next timeout. */
+int tcp_event_fd()
+{
+    int i, j, count = 0;
+    double then, elapsed;
+    struct pollfd pfd;
+    mapper_map *maps;
+
+    pfd.fd = mapper_device_event_fd(destination);
+    if (pfd.fd < 0)
+        return 0;
+    pfd.events = POLLIN;
+
+    maps = mapper_signal_maps(sendsig, MAPPER_DIR_OUTGOING);
+    if (!maps)
+        return 1;
+    mapper_map_set_protocol(*maps, MAPPER_PROTO_TCP);
+    mapper_map_push(*maps);
+    mapper_map_query_done(maps);
+
+    // wait until the source sends using TCP
+    maps = 0;
+    while (!done && !(maps && mapper_map_protocol(*maps) == MAPPER_PROTO_TCP)) {
+        mapper_map_query_done(maps);
+        if (count++ > 100)
+            return 1;
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        maps = mapper_signal_maps(sendsig, MAPPER_DIR_OUTGOING);
+    }
+    mapper_map_query_done(maps);
+
+    eprintf("-------------- Using event descriptors with TCP --------------\n");
+    then = mapper_get_current_time();
+    for (i = 0; i < 20 && !done; i++) {
+        mapper_signal_update_float(sendsig, ((i % 10) * 1.0f));
+        sent++;
+        mapper_device_poll(source, 0);
+        for (j = 0; j < 10 && received < sent && !done; j++) {
+            poll(&pfd, 1, mapper_device_next_timeout(destination));
+            mapper_device_poll(destination, 0);
+        }
+    }
+    elapsed = mapper_get_current_time() - then;
+    eprintf("Received %i of %i updates over TCP in %f seconds.\n", received,
+            sent, elapsed);
+    return received != sent || elapsed > 1;
+}
+
+/* Queue an update, and check that the source's event descriptor becomes
+ * readable for it straight away. */
+int queued_event_fd()
+{
+    int i, ready, count = 0;
+    double then, elapsed;
+    struct pollfd pfd;
+
+    pfd.fd = mapper_device_event_fd(source);
+    if (pfd.fd < 0)
+        return 0;
+    pfd.events = POLLIN;
+    if (mapper_device_set_update_queue(source, 16,
+                                       MAPPER_OVERFLOW_DROP_NEWEST))
+        return 1;
+
+    // start from an idle descriptor if possible
+    for (i = 0; i < 10 && poll(&pfd, 1, 0) > 0; i++)
+        mapper_device_poll(source, 0);
+
+    eprintf("Queuing an update..\n");
+    mapper_signal_update_float(sendsig, 1.0f);
+    sent++;
+    then = mapper_get_current_time();
+    ready = poll(&pfd, 1, 1000);
+    elapsed = mapper_get_current_time() - then;
+    mapper_device_poll(source, 0);
+    while (received < sent && count++ < 100 && !done)
+        mapper_device_poll(destination, 10);
+    mapper_device_set_update_queue(source, 0, 0);
+
+    eprintf("Woke after %f seconds.\n", elapsed);
+    return ready != 1 || elapsed > 0.1 || received != sent;
+}
+
+/* Send a burst of updates at once, and check that the destination catches
+ * up and reports it in its poll statistics. */
+int burst()
+{
+    int i, count = 0, backlog;
+    double msgs_per_poll;
+
+    eprintf("Sending a burst of updates..\n");
+    for (i = 0; i < 100; i++) {
+        mapper_signal_update_float(sendsig, ((i % 10) * 1.0f));
+        sent++;
+    }
+    mapper_device_poll(source, 0);
+    while (received < sent && count++ < 100 && !done)
+        mapper_device_poll(destination, 10);
+
+    // one more poll should find nothing left waiting
+    mapper_device_poll(destination, 0);
+    mapper_device_poll_stats(destination, &msgs_per_poll, 0, &backlog);
+    eprintf("Averaging %f messages per poll, backlog %d.\n", msgs_per_poll,
+            backlog);
+    return msgs_per_poll <= 0 || backlog;
+}
+
 void ctrlc(int sig)
 {
     done = 1;
@@ -285,6 +444,24 @@ int main(int argc, char **argv)
     }
 
     loop();
+    event_fd_loop();
+
+    if (queued_event_fd()) {
+        result = 1;
+        eprintf("Error: queued update did not wake the event descriptor.\n");
+        goto done;
+    }
+
+    if (tcp_event_fd()) {
+        result = 1;
+        eprintf("Error: TCP updates did not wake the event descriptor.\n");
+        goto done;
+    }
+
+    if (burst()) {
+        result = 1;
+        eprintf("Error: unexpected poll statistics after burst.\n");
+    }
 
     if (sent != received) {
         result = 1;
@@ -0,0 +1,148 @@
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <lo/lo.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int done = 0;
+
+mapper_device destination = 0;
+mapper_signal recvsig = 0;
+lo_address addr = 0;
+
+int received = 0;
+float last_value = 0;
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        last_value = *(float*)value;
+        eprintf("handler: Got %f\n", last_value);
+    }
+    received++;
+}
+
+int setup_destination()
+{
+    char port[16];
+
+    destination = mapper_device_new("testshape-recv", 0, 0);
+    if (!destination)
+        return 1;
+
+    recvsig = mapper_device_add_signal(destination, MAPPER_DIR_INCOMING, 4,
+                                       "insig", 1, 'f', 0, 0, 0,
+                                       insig_handler, 0);
+    if (!recvsig)
+        return 1;
+
+    while (!done && !mapper_device_ready(destination))
+        mapper_device_poll(destination, 25);
+
+    snprintf(port, 16, "%d", mapper_device_port(destination));
+    addr = lo_address_new("localhost", port);
+    return !addr;
+}
+
+void cleanup_destination()
+{
+    if (addr)
+        lo_address_free(addr);
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+/*! Send a data message with one instanced value and return whether the
+ *  signal handler was called for it. */
+int send_instance_update(float value, const char *key, int64_t id)
+{
+    int i, before = received;
+    lo_send(addr, "/insig", "fsh", value, key, id);
+    for (i = 0; i < 10 && received == before && !done; i++)
+        mapper_device_poll(destination, 10);
+    return received != before;
+}
+
+int test_shape()
+{
+    // the first message records the layout of an instanced update
+    if (!send_instance_update(1, "@instance", 1)) {
+        eprintf("Update with key '@instance' was not delivered.\n");
+        return 1;
+    }
+    // the same typetag and position, but a key that is not a property
+    if (send_instance_update(2, "@ignored", 2)) {
+        eprintf("Update with key '@ignored' was taken as an instance id.\n");
+        return 1;
+    }
+    // the short key used with aliases shares the cached layout
+    if (!send_instance_update(3, "@i", 1) || last_value != 3) {
+        eprintf("Update with key '@i' was not delivered.\n");
+        return 1;
+    }
+    if (mapper_signal_num_active_instances(recvsig) != 1) {
+        eprintf("Expected 1 active instance, found %d.\n",
+                mapper_signal_num_active_instances(recvsig));
+        return 1;
+    }
+    return 0;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -q quiet, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testshape.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    result = test_shape();
+
+  done:
+    cleanup_destination();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,166 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+
+int num_devices = 50;
+int compare = 0;
+mapper_device *devices = 0;
+
+typedef enum {
+    MODE_DEFAULT,
+    MODE_FAST,
+    MODE_PINNED
+} startup_mode;
+
+const char *mode_names[] = { "default", "fast", "pinned" };
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void free_devices()
+{
+    int i;
+    for (i = 0; i < num_devices; i++) {
+        if (devices[i]) {
+            mapper_device_free(devices[i]);
+            devices[i] = 0;
+        }
+    }
+}
+
+/*! Bring up num_devices devices sharing one name at once, and wait until all
+ *  of them have registered a unique ordinal. */
+int start_devices(startup_mode mode, double *elapsed)
+{
+    int i, j, ready, result = 0;
+    double start = current_time(), deadline = start + 30.0;
+    unsigned int ordinal;
+
+    for (i = 0; i < num_devices; i++) {
+        devices[i] = mapper_device_new("teststartup", 0, 0);
+        if (!devices[i]) {
+            eprintf("Error creating device %d.\n", i);
+            return 1;
+        }
+        if (mode == MODE_FAST)
+            mapper_device_set_fast_allocation(devices[i], 1);
+        else if (mode == MODE_PINNED)
+            mapper_device_set_ordinal(devices[i], i + 1);
+    }
+
+    while (1) {
+        ready = 0;
+        for (i = 0; i < num_devices; i++) {
+            mapper_device_poll(devices[i], 0);
+            if (mapper_device_ready(devices[i]))
+                ++ready;
+        }
+        if (ready == num_devices || current_time() > deadline)
+            break;
+        mapper_device_poll(devices[0], 1);
+    }
+    *elapsed = current_time() - start;
+
+    if (ready < num_devices) {
+        eprintf("Only %d of %d devices registered.\n", ready, num_devices);
+        return 1;
+    }
+
+    for (i = 0; i < num_devices; i++) {
+        ordinal = mapper_device_ordinal(devices[i]);
+        for (j = 0; j < i; j++) {
+            if (mapper_device_ordinal(devices[j]) == ordinal) {
+                eprintf("Devices %d and %d both registered ordinal %d.\n",
+                        j, i, ordinal);
+                result = 1;
+            }
+        }
+        if (mode == MODE_PINNED && ordinal != i + 1) {
+            eprintf("Device %d registered ordinal %d instead of %d.\n", i,
+                    ordinal, i + 1);
+            result = 1;
+        }
+    }
+    return result;
+}
+
+int run_mode(startup_mode mode)
+{
+    double elapsed = 0;
+    int result = start_devices(mode, &elapsed);
+
+    eprintf("%-8s %d devices registered in %.3f s\n", mode_names[mode],
+            num_devices, elapsed);
+    free_devices();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -q quiet, -c compare, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("teststartup.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-c compare with default allocation, "
+                               "-h help, "
+                               "--devices number of devices\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 'c':
+                        compare = 1;
+                        break;
+                    case '-':
+                        if (strcmp(argv[i], "--devices")==0 && argc>i+1) {
+                            i++;
+                            num_devices = atoi(argv[i]);
+                            j = 1;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    if (num_devices < 1)
+        num_devices = 1;
+    devices = (mapper_device*)calloc(num_devices, sizeof(mapper_device));
+
+    // the default scheme takes several seconds, so only run it on request
+    if (compare && run_mode(MODE_DEFAULT))
+        result = 1;
+    if (!result && run_mode(MODE_FAST))
+        result = 1;
+    if (!result && run_mode(MODE_PINNED))
+        result = 1;
+
+    free(devices);
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
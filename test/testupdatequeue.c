@@ -0,0 +1,362 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+int port = 9000;
+
+int sent = 0;
+int received = 0;
+int producing = 0;
+
+int setup_source()
+{
+    source = mapper_device_new("testupdatequeue-send", port, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    int mn=0, mx=1000;
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'i', 0,
+                                              &mn, &mx);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        eprintf("handler: Got %i\n", (*(int*)value));
+    }
+    received++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testupdatequeue-recv", port, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    int mn=0, mx=1000;
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'i', 0,
+                                             &mn, &mx, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int create_map()
+{
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 25);
+        mapper_device_poll(destination, 25);
+    }
+}
+
+// Stands in for a real-time thread: it never polls the source device.
+void *producer(void *arg)
+{
+    int i;
+    for (i = 0; i < 100 && !done; i++) {
+        mapper_signal_update_int(sendsig, i);
+        __atomic_add_fetch(&sent, 1, __ATOMIC_RELAXED);
+        usleep(5000);
+    }
+    __atomic_store_n(&producing, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int threaded_updates()
+{
+    pthread_t thread;
+
+    eprintf("Updating signal from a separate thread..\n");
+    mapper_device_set_update_queue(source, 64, MAPPER_OVERFLOW_DROP_NEWEST);
+    producing = 1;
+    if (pthread_create(&thread, 0, producer, 0)) {
+        eprintf("Error creating producer thread.\n");
+        return 1;
+    }
+
+    while (__atomic_load_n(&producing, __ATOMIC_ACQUIRE) && !done) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 10);
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+    pthread_join(thread, 0);
+
+    // flush the remaining updates
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 100);
+
+    unsigned int overflows = mapper_device_update_queue_overflows(source);
+    eprintf("Sent %d updates, %d overflowed, received %d.\n", sent, overflows,
+            received);
+    mapper_device_set_update_queue(source, 0, MAPPER_OVERFLOW_DROP_NEWEST);
+    return sent - overflows != received;
+}
+
+int overflow_policies()
+{
+    int i;
+
+    eprintf("Checking overflow policies..\n");
+    mapper_device_set_update_queue(source, 4, MAPPER_OVERFLOW_DROP_NEWEST);
+    for (i = 0; i < 10; i++)
+        mapper_signal_update_int(sendsig, i);
+    if (mapper_device_update_queue_overflows(source) != 6) {
+        eprintf("Expected 6 overflows, got %d.\n",
+                mapper_device_update_queue_overflows(source));
+        return 1;
+    }
+    received = 0;
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 100);
+    if (received != 4 || *(int*)mapper_signal_value(sendsig, 0) != 3) {
+        eprintf("DROP_NEWEST: received %d updates, last value %d.\n", received,
+                *(int*)mapper_signal_value(sendsig, 0));
+        return 1;
+    }
+
+    mapper_device_set_update_queue(source, 4, MAPPER_OVERFLOW_DROP_OLDEST);
+    for (i = 0; i < 10; i++)
+        mapper_signal_update_int(sendsig, i);
+    if (mapper_device_update_queue_overflows(source) != 6) {
+        eprintf("Expected 6 overflows, got %d.\n",
+                mapper_device_update_queue_overflows(source));
+        return 1;
+    }
+    received = 0;
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 100);
+    if (received != 4 || *(int*)mapper_signal_value(sendsig, 0) != 9) {
+        eprintf("DROP_OLDEST: received %d updates, last value %d.\n", received,
+                *(int*)mapper_signal_value(sendsig, 0));
+        return 1;
+    }
+
+    mapper_device_set_update_queue(source, 0, MAPPER_OVERFLOW_DROP_NEWEST);
+    return 0;
+}
+
+// Updates queued with MAPPER_NOW are stamped when they are performed.
+int queued_timetags()
+{
+    int values[2] = {1, 2};
+    mapper_id ids[2] = {0, 0};
+    mapper_timetag_t queued, performed;
+
+    eprintf("Checking timetags of queued updates..\n");
+    mapper_device_set_update_queue(source, 4, MAPPER_OVERFLOW_DROP_NEWEST);
+    mapper_timetag_now(&queued);
+    mapper_signal_update_instances(sendsig, 2, ids, values, MAPPER_NOW);
+    usleep(50000);
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 100);
+    mapper_device_set_update_queue(source, 0, MAPPER_OVERFLOW_DROP_NEWEST);
+
+    if (!mapper_signal_value(sendsig, &performed)
+        || *(int*)mapper_signal_value(sendsig, 0) != 2) {
+        eprintf("Queued updates were not performed.\n");
+        return 1;
+    }
+    if (mapper_timetag_difference(performed, queued) < 0.04) {
+        eprintf("Queued updates were stamped when they were queued.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Let background threads service both devices while updates are queued.
+int threaded_io()
+{
+    pthread_t thread;
+    unsigned int overflows;
+
+    eprintf("Servicing devices from background threads..\n");
+    if (mapper_device_start_thread(source)
+        || mapper_device_start_thread(destination)) {
+        eprintf("Error starting I/O threads.\n");
+        return 1;
+    }
+    // the I/O thread may be handling the queue, so hold the device lock
+    mapper_device_lock(source);
+    mapper_device_set_update_queue(source, 64, MAPPER_OVERFLOW_DROP_NEWEST);
+    mapper_device_unlock(source);
+
+    sent = received = 0;
+    producing = 1;
+    if (pthread_create(&thread, 0, producer, 0)) {
+        eprintf("Error creating producer thread.\n");
+        return 1;
+    }
+    pthread_join(thread, 0);
+
+    // calling poll is harmless, it only waits while the threads work
+    mapper_device_poll(source, 100);
+
+    mapper_device_stop_thread(source);
+    mapper_device_stop_thread(destination);
+    mapper_device_poll(destination, 100);
+
+    overflows = mapper_device_update_queue_overflows(source);
+    eprintf("Sent %d updates, %d overflowed, received %d.\n", sent, overflows,
+            received);
+    mapper_device_set_update_queue(source, 0, MAPPER_OVERFLOW_DROP_NEWEST);
+    return sent - overflows != received;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testupdatequeue.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-t terminate automatically, "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source()) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (create_map()) {
+        eprintf("Error creating map.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (threaded_updates()) {
+        eprintf("Not all queued updates were received.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (overflow_policies()) {
+        eprintf("Overflow policy test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (queued_timetags()) {
+        eprintf("Queued timetag test failed.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (threaded_io()) {
+        eprintf("Not all updates were received by the I/O threads.\n");
+        result = 1;
+        goto done;
+    }
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
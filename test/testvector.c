@@ -146,6 +146,74 @@ void loop()
     }
 }
 
+/* Benchmark long vectors: each update carries 8 samples of a 128-element
+ * vector, i.e. 1024 floats per message. */
+#define BENCH_LENGTH 128
+#define BENCH_COUNT 8
+#define BENCH_UPDATES 1000
+
+int bench_received = 0;
+float bench_last = -1;
+
+void bench_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value && count == BENCH_COUNT)
+        bench_last = ((float*)value)[BENCH_LENGTH * BENCH_COUNT - 1];
+    bench_received++;
+}
+
+int benchmark()
+{
+    int i, j;
+    float v[BENCH_LENGTH * BENCH_COUNT];
+
+    mapper_signal out = mapper_device_add_output_signal(source, "benchout",
+                                                        BENCH_LENGTH, 'f', 0,
+                                                        0, 0);
+    mapper_signal in = mapper_device_add_input_signal(destination, "benchin",
+                                                      BENCH_LENGTH, 'f', 0, 0,
+                                                      0, bench_handler, 0);
+    mapper_map map = mapper_map_new(1, &out, 1, &in);
+    mapper_map_push(map);
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    // the source may not be sending yet, so also wait for its own record
+    mapper_map *maps = 0;
+    while (!done && !(maps && mapper_map_ready(*maps))) {
+        mapper_map_query_done(maps);
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        maps = mapper_signal_maps(out, MAPPER_DIR_OUTGOING);
+    }
+    mapper_map_query_done(maps);
+
+    eprintf("Sending %d updates of %d floats..\n", BENCH_UPDATES,
+            BENCH_LENGTH * BENCH_COUNT);
+    double then = mapper_get_current_time();
+    for (i = 0; i < BENCH_UPDATES && !done; i++) {
+        for (j = 0; j < BENCH_LENGTH * BENCH_COUNT; j++)
+            v[j] = i + j;
+        mapper_signal_update(out, v, BENCH_COUNT, MAPPER_NOW);
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+    }
+    while (!done && bench_received < BENCH_UPDATES) {
+        if (!mapper_device_poll(destination, 10))
+            break;
+    }
+    double elapsed = mapper_get_current_time() - then;
+    eprintf("Received %d of %d updates in %f seconds (%f floats/s).\n",
+            bench_received, BENCH_UPDATES, elapsed,
+            bench_received * BENCH_LENGTH * BENCH_COUNT / elapsed);
+
+    return (bench_received != BENCH_UPDATES
+            || bench_last != BENCH_UPDATES - 1 + BENCH_LENGTH * BENCH_COUNT - 1);
+}
+
 void ctrlc(int sig)
 {
     done = 1;
@@ -212,6 +280,11 @@ int main(int argc, char **argv)
         result = 1;
     }
 
+    if (autoconnect && benchmark()) {
+        eprintf("Long vector benchmark failed.\n");
+        result = 1;
+    }
+
   done:
     cleanup_destination();
     cleanup_source();